@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "../objects/objects.hpp"
+#include "../protocol/protocol.hpp"
+#include "../transport/transport.hpp"
+#include "../utils/crypto/crypto.hpp"
+
+// Microbenchmarks for the serialization, database and codec hot paths, results are written as CSV
+
+#define BENCH_CSV_HEADER "benchmark,parameter,iterations,ns_per_op,ops_per_sec"
+
+struct BenchOptions {
+    uint32_t max_rows = 100000;
+    uint32_t min_time_ms = 200;
+    const char* filter = nullptr;
+    const char* output_path = nullptr;
+    const char* baseline_path = nullptr;
+    double threshold = 10.0;
+    const char* database_path = "swiftcom-bench.db";
+    bool verbose = false;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string parameter;
+    uint64_t iterations;
+    double ns_per_op;
+};
+
+// State the database benchmarks share for one seeded size
+struct BenchDatabase {
+    objects::Database* database;
+    uint32_t rows;
+    uint32_t hosted_servers;
+    std::mt19937 random;
+
+    uint32_t next_hosted_server_id;
+    uint32_t next_ip_address;
+    uint32_t next_cached_message_id;
+};
+
+struct DatabaseBenchmark {
+    const char* name;
+    std::function<void(BenchDatabase*, uint64_t)> body;
+    uint64_t max_iterations;
+};
+
+static BenchOptions options;
+static std::vector<BenchResult> results;
+
+static void PrintUsage(const char* program) {
+    fprintf(stderr, "Usage: %s [--max-rows N] [--min-time MS] [--filter SUBSTRING] [--output CSV_PATH]\n", program);
+    fprintf(stderr, "          [--baseline CSV_PATH] [--threshold PERCENT] [--database PATH] [--verbose]\n");
+}
+
+static bool ParseOptions(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--verbose") == 0) {
+            options.verbose = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        const char* value = argv[++i];
+
+        if (strcmp(arg, "--max-rows") == 0) {
+            options.max_rows = atoi(value);
+        } else if (strcmp(arg, "--min-time") == 0) {
+            options.min_time_ms = atoi(value);
+        } else if (strcmp(arg, "--filter") == 0) {
+            options.filter = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            options.output_path = value;
+        } else if (strcmp(arg, "--baseline") == 0) {
+            options.baseline_path = value;
+        } else if (strcmp(arg, "--threshold") == 0) {
+            options.threshold = atof(value);
+        } else if (strcmp(arg, "--database") == 0) {
+            options.database_path = value;
+        } else {
+            return false;
+        }
+    }
+
+    return options.max_rows >= 1000 && options.min_time_ms > 0 && options.threshold >= 0;
+}
+
+static bool IsSelected(const char* name) {
+    return options.filter == nullptr || strstr(name, options.filter) != nullptr;
+}
+
+// Doubles the batch until one batch runs for at least min_time, max_iterations caps benchmarks that use up ids
+static void RunBenchmark(const char* name, const std::string& parameter, const std::function<void(uint64_t)>& body, const uint64_t max_iterations = UINT64_MAX) {
+    if (!IsSelected(name)) {
+        return;
+    }
+
+    const auto min_time = std::chrono::milliseconds(options.min_time_ms);
+
+    uint64_t iterations = 1;
+
+    while (true) {
+        const auto start = std::chrono::steady_clock::now();
+
+        body(iterations);
+
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (elapsed >= min_time || iterations >= max_iterations) {
+            const double ns_per_op = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+
+            results.push_back((BenchResult){.name = name, .parameter = parameter, .iterations = iterations, .ns_per_op = ns_per_op});
+
+            fprintf(stderr, "%-48s %-22s %12.1f ns/op\n", name, parameter.c_str(), ns_per_op);
+
+            return;
+        }
+
+        iterations = std::min(iterations * 2, max_iterations);
+    }
+}
+
+static void CreateMessages(const uint32_t count, const uint32_t message_size, objects::ChannelMessageBatch* messages) {
+    const std::string body(message_size, 'x');
+
+    messages->rows.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        messages->Add((objects::Database::ChannelMessageRow){
+            .id = i + 1,
+            .message = body,
+            .sender_id = i % 16 + 1,
+            .channel_id = 1
+        });
+    }
+}
+
+static void RunSerializationBenchmarks() {
+    const uint32_t message_counts[] = {1, CHANNEL_PAGE_SIZE, 500};
+    const uint32_t message_sizes[] = {16, 256};
+
+    for (const uint32_t count : message_counts) {
+        for (const uint32_t size : message_sizes) {
+            const std::string parameter = "messages=" + std::to_string(count) + "/bytes=" + std::to_string(size);
+
+            objects::ChannelMessageBatch messages;
+            CreateMessages(count, size, &messages);
+
+            transport::PacketBuffer buffer(0);
+
+            RunBenchmark("serialize_channel_messages", parameter, [&](const uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    buffer.Clear();
+                    objects::SerializeChannelMessages(&buffer, messages.rows.data(), messages.rows.size());
+                }
+            });
+
+            buffer.Clear();
+            objects::SerializeChannelMessages(&buffer, messages.rows.data(), messages.rows.size());
+
+            objects::ChannelMessageBatch received;
+
+            // Includes the copy every received loopback packet makes of its buffer
+            RunBenchmark("deserialize_channel_messages", parameter, [&](const uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    transport::LoopbackPacket packet(&buffer, (in_addr){.s_addr = htonl(INADDR_LOOPBACK)}, 0);
+
+                    if (!objects::DeserializeChannelMessages(&packet, count, &received)) {
+                        abort();
+                    }
+
+                    received.Clear();
+                }
+            });
+        }
+    }
+}
+
+static void RunUserLookupBenchmarks() {
+    const uint32_t member_counts[] = {10, 100, 1000, 10000, 100000};
+
+    for (const uint32_t members : member_counts) {
+        objects::HostedServer server(1, nullptr);
+
+        for (uint32_t i = 0; i < members; i++) {
+            objects::Database::HostedServerUserRow row = {};
+            row.id = i + 1;
+            row.ip_address.s_addr = htonl(0x7F000000 | (i + 2));
+
+            server.GetServerUsers()->Add(row, objects::ServerUserStatus::OFFLINE, (transport::ClientAddrData){});
+        }
+
+        std::mt19937 random(members);
+        std::uniform_int_distribution<uint32_t> member_index(0, members - 1);
+
+        RunBenchmark("get_user_by_addr_data", "members=" + std::to_string(members), [&](const uint64_t iterations) {
+            transport::ClientAddrData addr_data = {};
+
+            for (uint64_t i = 0; i < iterations; i++) {
+                addr_data.sender_address.s_addr = htonl(0x7F000000 | (member_index(random) + 2));
+
+                if (server.GetUserByAddrData(addr_data) == INVALID_SERVER_USER_HANDLE) {
+                    abort();
+                }
+            }
+        });
+    }
+}
+
+// One op is a full pass over the member table, the way each fan-out tick scans it
+static void RunUserScanBenchmarks() {
+    const uint32_t member_counts[] = {1000, 10000, 100000};
+
+    // A tenth of the members are online, each with up to the maximum of subscriptions over 100 channels
+    const uint32_t channels_len = 100;
+
+    for (const uint32_t members : member_counts) {
+        const std::string parameter = "members=" + std::to_string(members);
+
+        objects::ServerUserTable users;
+
+        std::mt19937 random(members);
+        std::uniform_int_distribution<uint32_t> channel(1, channels_len);
+
+        const auto now = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < members; i++) {
+            objects::Database::HostedServerUserRow row = {};
+            row.id = i + 1;
+            row.ip_address.s_addr = htonl(0x7F000000 | (i + 2));
+
+            const objects::ServerUserHandle handle = users.Add(row, objects::ServerUserStatus::OFFLINE, (transport::ClientAddrData){.sender_address = row.ip_address});
+
+            if (i % 10 != 0) {
+                continue;
+            }
+
+            users.MarkOnline(handle);
+
+            // Every hundredth online member went quiet a while ago
+            users.last_request_times[handle] = i % 1000 == 0 ? now - std::chrono::minutes(5) : now;
+
+            for (uint32_t j = 0; j <= i % MAX_CHANNEL_SUBSCRIPTIONS; j++) {
+                users.Subscribe(handle, channel(random), users.addr_data[handle]);
+            }
+        }
+
+        RunBenchmark("server_users.count_online", parameter, [&](const uint64_t iterations) {
+            uint64_t online = 0;
+
+            for (uint64_t i = 0; i < iterations; i++) {
+                online += users.CountOnline();
+            }
+
+            if (online != iterations * ((members + 9) / 10)) {
+                abort();
+            }
+        });
+
+        std::vector<objects::ServerUserHandle> stale;
+
+        RunBenchmark("server_users.collect_stale", parameter, [&](const uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                stale.clear();
+                users.CollectStale(now - std::chrono::seconds(60), &stale);
+            }
+
+            if (stale.size() != (members + 999) / 1000) {
+                abort();
+            }
+        });
+
+        // A fifth of the channels got messages this tick
+        std::vector<uint32_t> active_channels;
+
+        for (uint32_t channel_id = 1; channel_id <= channels_len; channel_id += 5) {
+            active_channels.push_back(channel_id);
+        }
+
+        RunBenchmark("server_users.match_subscriptions", parameter, [&](const uint64_t iterations) {
+            uint64_t matched = 0;
+
+            for (uint64_t i = 0; i < iterations; i++) {
+                users.ForEachSubscription([&](const objects::ServerUserHandle handle, const uint32_t subscription, const uint32_t channel_id) {
+                    if (std::binary_search(active_channels.begin(), active_channels.end(), channel_id)) {
+                        matched += users.subscription_addr_data[handle].addr_data[subscription].sender_address.s_addr != 0;
+                    }
+                });
+            }
+
+            if (matched == 0 && iterations > 0) {
+                abort();
+            }
+        });
+    }
+}
+
+static void RunCodecBenchmarks() {
+    // Invitation codes encode an address and a port, the bigger inputs show how the codec scales
+    const uint32_t input_sizes[] = {6, 64, 1024};
+
+    for (const uint32_t size : input_sizes) {
+        const std::string parameter = "bytes=" + std::to_string(size);
+
+        std::vector<uint8_t> data(size);
+
+        for (uint32_t i = 0; i < size; i++) {
+            data[i] = static_cast<uint8_t>(i * 31 + 7);
+        }
+
+        const std::string encoded = utils::crypto::base32_encode(data);
+
+        size_t checksum = 0;
+
+        RunBenchmark("base32_encode", parameter, [&](const uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                checksum += utils::crypto::base32_encode(data).size();
+            }
+        });
+
+        RunBenchmark("base32_decode", parameter, [&](const uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                checksum += utils::crypto::base32_decode(encoded).size();
+            }
+        });
+
+        // Both may be filtered out, then nothing ran
+        if (checksum == 0 && (IsSelected("base32_encode") || IsSelected("base32_decode"))) {
+            abort();
+        }
+    }
+}
+
+static void ExecuteSeedQuery(objects::Database* database, const std::string& query) {
+    char* error = nullptr;
+
+    if (sqlite3_exec(database->GetDatabaseConnection(), query.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+        fprintf(stderr, "Failed to seed database: %s\n", error);
+        sqlite3_free(error);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Fills every table with generated rows, messages are spread over 10 channels and the cache over 100
+static void SeedDatabase(BenchDatabase* bench_database) {
+    const std::string rows = std::to_string(bench_database->rows);
+    const std::string hosted_servers = std::to_string(bench_database->hosted_servers);
+    const std::string sequence = "WITH RECURSIVE sequence(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM sequence WHERE x < " + rows + ") ";
+
+    ExecuteSeedQuery(bench_database->database, "BEGIN;");
+
+    ExecuteSeedQuery(bench_database->database, "WITH RECURSIVE sequence(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM sequence WHERE x < " + hosted_servers + ") INSERT INTO hosted_servers (id) SELECT x FROM sequence;");
+    ExecuteSeedQuery(bench_database->database, sequence + "INSERT INTO hosted_server_users (ip_address, server_id, username) SELECT x, 1 + x % " + hosted_servers + ", 'user-' || x FROM sequence;");
+    ExecuteSeedQuery(bench_database->database, sequence + "INSERT INTO joined_servers (ip_address, server_id) SELECT 1 + x % 1000, 1 + x % " + hosted_servers + " FROM sequence;");
+    ExecuteSeedQuery(bench_database->database, sequence + "INSERT INTO server_chat_channels (name, hosted_server_id) SELECT 'channel-' || x, 1 + x % " + hosted_servers + " FROM sequence;");
+    ExecuteSeedQuery(bench_database->database, sequence + "INSERT INTO channel_messages (message, channel_id, sender_id) SELECT 'message ' || x || ' ' || hex(randomblob(16)), 1 + x % 10, 1 + x % " + rows + " FROM sequence;");
+    ExecuteSeedQuery(bench_database->database, sequence + "INSERT INTO cached_channel_messages (server_ip_address, server_id, channel_id, id, message, sender_id, sender_username) SELECT 1, 1, 1 + x % 100, x, 'message ' || x || ' ' || hex(randomblob(16)), 1 + x % " + rows + ", 'user-' || x FROM sequence;");
+
+    ExecuteSeedQuery(bench_database->database, "COMMIT;");
+}
+
+static uint32_t RandomBetween(BenchDatabase* bench_database, const uint32_t min, const uint32_t max) {
+    return std::uniform_int_distribution<uint32_t>(min, max)(bench_database->random);
+}
+
+static void RemoveDatabaseFiles() {
+    if (strcmp(options.database_path, ":memory:") == 0) {
+        return;
+    }
+
+    const std::string journal_path = std::string(options.database_path) + "-journal";
+
+    unlink(options.database_path);
+    unlink(journal_path.c_str());
+}
+
+static const in_addr cached_server_ip_address = {.s_addr = 1};
+
+static const DatabaseBenchmark database_benchmarks[] = {
+    {"database.select_hosted_servers", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            delete db->database->SelectHostedServers(RandomBetween(db, 1, db->hosted_servers));
+        }
+    }, UINT64_MAX},
+    {"database.select_joined_servers", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            delete db->database->SelectJoinedServers(std::nullopt, RandomBetween(db, 1, 1000), RandomBetween(db, 1, db->hosted_servers));
+        }
+    }, UINT64_MAX},
+    {"database.select_server_chat_channels", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            delete db->database->SelectServerChatChannels(std::nullopt, nullptr, RandomBetween(db, 1, db->hosted_servers));
+        }
+    }, UINT64_MAX},
+    {"database.select_channel_messages_page", [](BenchDatabase* db, const uint64_t iterations) {
+        objects::ChannelMessageBatch messages;
+
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->SelectChannelMessages(std::nullopt, nullptr, std::nullopt, RandomBetween(db, 1, 10), RandomBetween(db, 0, db->rows), CHANNEL_PAGE_SIZE, &messages);
+
+            messages.Clear();
+        }
+    }, UINT64_MAX},
+    {"database.select_channel_messages_by_id", [](BenchDatabase* db, const uint64_t iterations) {
+        objects::ChannelMessageBatch messages;
+
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->SelectChannelMessages(RandomBetween(db, 1, db->rows), nullptr, std::nullopt, std::nullopt, std::nullopt, 1, &messages);
+
+            messages.Clear();
+        }
+    }, UINT64_MAX},
+    {"database.select_cached_channel_messages", [](BenchDatabase* db, const uint64_t iterations) {
+        objects::ChannelMessageBatch messages;
+        objects::UserDirectory users;
+
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->SelectCachedChannelMessages(cached_server_ip_address, 1, RandomBetween(db, 1, 100), &messages, &users);
+
+            messages.Clear();
+        }
+    }, UINT64_MAX},
+    {"database.select_cached_channel_last_message_id", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->SelectCachedChannelLastMessageId(cached_server_ip_address, 1, RandomBetween(db, 1, 100));
+        }
+    }, UINT64_MAX},
+    {"database.select_hosted_server_users", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            delete db->database->SelectHostedServerUsers(std::nullopt, std::nullopt, nullptr, RandomBetween(db, 1, db->rows));
+        }
+    }, UINT64_MAX},
+    // Server ids are 16 bit, so the batch is capped well below the free range
+    {"database.insert_hosted_server", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->InsertHostedServer(db->next_hosted_server_id++);
+        }
+    }, 16384},
+    {"database.insert_hosted_server_user", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->InsertHostedServerUser(1, (in_addr){.s_addr = db->next_ip_address++}, "bench-user");
+        }
+    }, UINT64_MAX},
+    {"database.insert_joined_server", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->InsertJoinedServer(1, (in_addr){.s_addr = db->next_ip_address++});
+        }
+    }, UINT64_MAX},
+    {"database.insert_server_chat_channel", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->InsertServerChatChannel("bench-channel", 1);
+        }
+    }, UINT64_MAX},
+    {"database.insert_channel_message", [](BenchDatabase* db, const uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            db->database->InsertChannelMessage("benchmark message body", RandomBetween(db, 1, 10), RandomBetween(db, 1, db->rows));
+        }
+    }, UINT64_MAX},
+    // One call stores a whole page, the way a client caches a loaded page
+    {"database.insert_cached_channel_messages", [](BenchDatabase* db, const uint64_t iterations) {
+        objects::ChannelMessageBatch messages;
+        CreateMessages(CHANNEL_PAGE_SIZE, 64, &messages);
+
+        objects::UserDirectory users;
+
+        for (uint32_t user_id = 1; user_id <= 16; user_id++) {
+            users.SetUsername(user_id, "user-" + std::to_string(user_id));
+        }
+
+        for (uint64_t i = 0; i < iterations; i++) {
+            for (auto& message : messages.rows) {
+                message.id = db->next_cached_message_id++;
+            }
+
+            db->database->InsertCachedChannelMessages(cached_server_ip_address, 1, RandomBetween(db, 1, 100), messages.rows.data(), messages.rows.size(), &users);
+        }
+    }, UINT64_MAX},
+};
+
+static void RunDatabaseBenchmarks() {
+    bool any_selected = false;
+
+    for (const auto& benchmark : database_benchmarks) {
+        any_selected = any_selected || IsSelected(benchmark.name);
+    }
+
+    if (!any_selected) {
+        return;
+    }
+
+    for (uint64_t rows = 1000; rows <= options.max_rows; rows *= 10) {
+        RemoveDatabaseFiles();
+
+        BenchDatabase bench_database = {
+            .database = new objects::Database(options.database_path),
+            .rows = static_cast<uint32_t>(rows),
+            .hosted_servers = static_cast<uint32_t>(std::min<uint64_t>(rows, 1000)),
+            .random = std::mt19937(rows)
+        };
+
+        bench_database.next_hosted_server_id = bench_database.hosted_servers + 1;
+        bench_database.next_ip_address = bench_database.rows + 1;
+        bench_database.next_cached_message_id = bench_database.rows + 1;
+
+        const auto seed_start = std::chrono::steady_clock::now();
+
+        SeedDatabase(&bench_database);
+
+        fprintf(stderr, "seeded %" PRIu64 " rows per table in %.2f s\n", rows, std::chrono::duration<double>(std::chrono::steady_clock::now() - seed_start).count());
+
+        const std::string parameter = "rows=" + std::to_string(rows);
+
+        for (const auto& benchmark : database_benchmarks) {
+            RunBenchmark(benchmark.name, parameter, [&](const uint64_t iterations) {
+                benchmark.body(&bench_database, iterations);
+            }, benchmark.max_iterations);
+        }
+
+        delete bench_database.database;
+
+        RemoveDatabaseFiles();
+    }
+}
+
+static void WriteResults(FILE* output) {
+    fprintf(output, "%s\n", BENCH_CSV_HEADER);
+
+    for (const auto& result : results) {
+        fprintf(output, "%s,%s,%" PRIu64 ",%.2f,%.1f\n", result.name.c_str(), result.parameter.c_str(), result.iterations, result.ns_per_op, 1e9 / result.ns_per_op);
+    }
+}
+
+// Returns the number of benchmarks slower than the baseline by more than the threshold, or -1 when it can't be read
+static int CompareWithBaseline(const char* baseline_path) {
+    FILE* baseline = fopen(baseline_path, "r");
+    if (baseline == nullptr) {
+        fprintf(stderr, "Failed to open baseline %s\n", baseline_path);
+        return -1;
+    }
+
+    std::unordered_map<std::string, double> baseline_ns_per_op;
+
+    char line[512];
+
+    while (fgets(line, sizeof(line), baseline) != nullptr) {
+        char name[128];
+        char parameter[128];
+        uint64_t iterations;
+        double ns_per_op;
+
+        if (sscanf(line, "%127[^,],%127[^,],%" SCNu64 ",%lf", name, parameter, &iterations, &ns_per_op) != 4) {
+            continue;
+        }
+
+        baseline_ns_per_op[std::string(name) + "," + parameter] = ns_per_op;
+    }
+
+    fclose(baseline);
+
+    int regressions = 0;
+
+    fprintf(stderr, "\n%-48s %-22s %12s %12s %9s\n", "benchmark", "parameter", "baseline ns", "current ns", "change");
+
+    for (const auto& result : results) {
+        auto it = baseline_ns_per_op.find(result.name + "," + result.parameter);
+        if (it == baseline_ns_per_op.end()) {
+            continue;
+        }
+
+        const double change = (result.ns_per_op - it->second) / it->second * 100;
+        const bool regressed = change > options.threshold;
+
+        if (regressed) {
+            regressions++;
+        }
+
+        fprintf(stderr, "%-48s %-22s %12.1f %12.1f %+8.1f%%%s\n", result.name.c_str(), result.parameter.c_str(), it->second, result.ns_per_op, change, regressed ? "  REGRESSION" : "");
+    }
+
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    if (!ParseOptions(argc, argv)) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Stray prints of the shared code stay out of the CSV
+    FILE* report = fdopen(dup(STDOUT_FILENO), "w");
+
+    if (!options.verbose) {
+        freopen("/dev/null", "w", stdout);
+    }
+
+    RunSerializationBenchmarks();
+    RunUserLookupBenchmarks();
+    RunUserScanBenchmarks();
+    RunCodecBenchmarks();
+    RunDatabaseBenchmarks();
+
+    FILE* output = report;
+
+    if (options.output_path != nullptr) {
+        output = fopen(options.output_path, "w");
+        if (output == nullptr) {
+            fprintf(stderr, "Failed to open %s\n", options.output_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    WriteResults(output);
+
+    if (output != report) {
+        fclose(output);
+    }
+
+    fclose(report);
+
+    if (options.baseline_path != nullptr) {
+        const int regressions = CompareWithBaseline(options.baseline_path);
+        if (regressions < 0) {
+            return EXIT_FAILURE;
+        }
+
+        if (regressions > 0) {
+            fprintf(stderr, "\n%d benchmark(s) regressed by more than %.1f%%\n", regressions, options.threshold);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
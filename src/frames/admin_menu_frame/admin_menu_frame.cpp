@@ -2,7 +2,6 @@
 #include <wx/event.h>
 #include <wx/utils.h>
 #include "../../main.hpp"
-#include "swift_net.h"
 
 using AdminMenuFrame = frames::AdminMenuFrame;
 
@@ -17,7 +16,7 @@ AdminMenuFrame::AdminMenuFrame(const char* ip_address, uint16_t server_id) : wxF
     });
     menu_bar->SetMinSize(wxSize(90, -1));
 
-    client_connection = swiftnet_create_client(ip_address, server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
+    client_connection = transport::CreateClient(ip_address, server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
     if (!client_connection) {
         wxMessageBox("Failed to connect to server.", "Connection Error", wxOK | wxICON_ERROR);
         return;
@@ -10,14 +10,13 @@
 #include <wx/sizer.h>
 
 #include "../../widgets/widgets.hpp"
-#include "swift_net.h"
 
 using Channels = frames::AdminMenuFrame::Channels;
 
 BEGIN_EVENT_TABLE(Channels, wxPanel)
 END_EVENT_TABLE()
 
-Channels::Channels(wxWindow* parent, SwiftNetClientConnection* client_connection) : wxPanel(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxNO_BORDER) {
+Channels::Channels(wxWindow* parent, transport::ClientTransport* client_connection) : wxPanel(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxNO_BORDER) {
     if (client_connection == nullptr) {
         return;
     }
@@ -77,29 +76,27 @@ void Channels::LoadChannels()  {
     const requests::LoadAdminMenuDataRequest request = {
     };
 
-    auto buffer = swiftnet_client_create_packet_buffer(sizeof(request_info) + sizeof(request));
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request));
 
-    swiftnet_client_append_to_packet(&request_info, sizeof(request_info), &buffer);
-    swiftnet_client_append_to_packet(&request, sizeof(request), &buffer);
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request, sizeof(request));
 
-    auto response_packet_data = swiftnet_client_make_request(client_connection, &buffer, DEFAULT_TIMEOUT_REQUEST);
-
-    swiftnet_client_destroy_packet_buffer(&buffer);
+    auto response_packet_data = client_connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
 
     if (response_packet_data == nullptr) {
         return;
     }
 
-    auto response_info = (ResponseInfo*)swiftnet_client_read_packet(response_packet_data, sizeof(ResponseInfo));
-    auto response = (responses::LoadAdminMenuDataResponse*)swiftnet_client_read_packet(response_packet_data, sizeof(responses::LoadAdminMenuDataResponse));
+    auto response_info = (ResponseInfo*)response_packet_data->Read(sizeof(ResponseInfo));
+    auto response = (responses::LoadAdminMenuDataResponse*)response_packet_data->Read(sizeof(responses::LoadAdminMenuDataResponse));
 
     for (uint32_t i = 0; i < response->channels_size; i++) {
-        auto row_ptr = (objects::Database::ServerChatChannelRow*)swiftnet_client_read_packet(response_packet_data, sizeof(objects::Database::ServerChatChannelRow));
+        auto row_ptr = (objects::Database::ServerChatChannelRow*)response_packet_data->Read(sizeof(objects::Database::ServerChatChannelRow));
 
         chat_channels.push_back(*row_ptr);
     }
 
-    swiftnet_client_destroy_packet_data(response_packet_data, client_connection);
+    delete response_packet_data;
 }
 
 void Channels::DrawChannelList()
@@ -136,29 +133,27 @@ int Channels::CreateNewTextChannel(const char* name) {
 
     strncpy((char*)request.name, name, sizeof(request.name));
 
-    auto buffer = swiftnet_client_create_packet_buffer(sizeof(request) + sizeof(request_info));
+    transport::PooledPacketBuffer buffer(sizeof(request) + sizeof(request_info));
 
-    swiftnet_client_append_to_packet(&request_info, sizeof(request_info), &buffer);
-    swiftnet_client_append_to_packet(&request, sizeof(request), &buffer);
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request, sizeof(request));
 
-    auto response_packet_data = swiftnet_client_make_request(client_connection, &buffer, DEFAULT_TIMEOUT_REQUEST);
+    auto response_packet_data = client_connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
 
-    swiftnet_client_destroy_packet_buffer(&buffer);
-    
     if (response_packet_data == nullptr) {
         return -1; 
     }
 
-    auto response_info = (ResponseInfo*)swiftnet_client_read_packet(response_packet_data, sizeof(ResponseInfo));
-    auto response = (responses::CreateNewChannelResponse*)swiftnet_client_read_packet(response_packet_data, sizeof(responses::CreateNewChannelResponse));
+    auto response_info = (ResponseInfo*)response_packet_data->Read(sizeof(ResponseInfo));
+    auto response = (responses::CreateNewChannelResponse*)response_packet_data->Read(sizeof(responses::CreateNewChannelResponse));
 
     if (response_info->request_status != Status::SUCCESS) {
-        swiftnet_client_destroy_packet_data(response_packet_data, client_connection);
+        delete response_packet_data;
         
         return -1;
     }
 
-    swiftnet_client_destroy_packet_data(response_packet_data, client_connection);
+    delete response_packet_data;
 
     return 0;
 }
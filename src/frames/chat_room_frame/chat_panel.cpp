@@ -1,9 +1,11 @@
 #include "../frames.hpp"
-#include <swift_net.h>
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <wx/event.h>
 #include <wx/osx/stattext.h>
@@ -15,75 +17,58 @@
 #include <wx/timer.h>
 #include <wx/wx.h>
 #include "../../main.hpp"
+#include "../../utils/alloc/alloc.hpp"
+#include "../../utils/log/log.hpp"
+#include "../../utils/trace/trace.hpp"
 
 using ChatPanel = frames::ChatRoomFrame::ChatPanel;
 
-static std::vector<objects::Database::ChannelMessageRow>* DeserializeChannelMessages(SwiftNetClientPacketData* packet_data, const uint32_t channel_messages_len) {
-    auto result = new std::vector<objects::Database::ChannelMessageRow>();
+static void packet_handler(transport::Packet* const packet_data, void* const chat_panel_void) {
+    ALLOC_SCOPE(CLIENT);
 
-    for (uint32_t i = 0; i < channel_messages_len; i++) {
-        const uint32_t* const message_id = (uint32_t*)swiftnet_client_read_packet(packet_data, sizeof(uint32_t));
-        const uint32_t* const sender_id = (uint32_t*)swiftnet_client_read_packet(packet_data, sizeof(uint32_t));
-        const uint32_t* const message_length = (uint32_t*)swiftnet_client_read_packet(packet_data, sizeof(uint32_t));
-        const char* const message = (const char*)swiftnet_client_read_packet(packet_data, *message_length);
-
-        char* const message_copy = (char*)malloc(*message_length);
-        strncpy(message_copy, message, *message_length);
-
-        printf("Received message: %s\n", message_copy);
-
-        auto message_row = (objects::Database::ChannelMessageRow){
-            .message_length = *message_length,
-            .sender_id = *sender_id,
-            .id = *message_id,
-            .message = message_copy
-        };
-
-        const char* const sender_username = (const char*)swiftnet_client_read_packet(packet_data, sizeof(message_row.sender_username));
-
-        memcpy(message_row.sender_username, sender_username, sizeof(message_row.sender_username));
-
-        result->push_back(message_row);
-    }
-
-    return result;
-}
-
-static void packet_handler(struct SwiftNetClientPacketData* const packet_data, void* const chat_panel_void) {
     ChatPanel* const chat_panel = static_cast<ChatPanel*>(chat_panel_void);
 
-    auto const response_info = (ResponseInfo*)swiftnet_client_read_packet(packet_data, sizeof(ResponseInfo));
+    auto const response_info = (ResponseInfo*)packet_data->Read(sizeof(ResponseInfo));
 
     switch (response_info->request_type) {
-        case RequestType::PERIODIC_CHAT_UPDATE: chat_panel->HandlePeriodicChatUpdate(packet_data); break;
-        default: break;
+        case RequestType::PERIODIC_CHAT_UPDATE:
+            if (response_info->request_status == Status::SUCCESS) {
+                chat_panel->HandlePeriodicChatUpdate(packet_data);
+            } else {
+                chat_panel->HandleChatResync(packet_data);
+            }
+            break;
+        case RequestType::SEND_MESSAGE: chat_panel->HandleSendMessageRejected(packet_data); break;
+        default: delete packet_data; break;
     }
 };
 
-ChatPanel::ChatPanel(const uint32_t channel_id, const uint16_t server_id, wxWindow* parent_window, const in_addr ip_address) : channel_id(channel_id), server_id(server_id), wxPanel(parent_window) {
+ChatPanel::ChatPanel(const uint32_t channel_id, const uint16_t server_id, wxWindow* parent_window, const in_addr ip_address, ChatRoomFrame* const chat_room_frame) : channel_id(channel_id), server_id(server_id), server_ip_address(ip_address), chat_room_frame(chat_room_frame), wxPanel(parent_window) {
     this->InitializeConnection(ip_address);
 
-    swiftnet_client_set_message_handler(this->GetClientConnection(), packet_handler, this);
+    this->GetClientConnection()->SetMessageHandler(packet_handler, this);
 
     // wxWidgets
     wxBoxSizer* main_sizer = new wxBoxSizer(wxVERTICAL);
 
-    this->messages_panel = new wxScrolled<wxPanel>(this);
-    this->messages_panel->SetScrollRate(0, 20);
-    this->messages_panel->Bind(wxEVT_SCROLLWIN_LINEUP, [this](wxScrollWinEvent& evt) {
+    this->messages_list = new widgets::MessageList(this, [this](const size_t row, wxString& username, wxString& message) {
+        const auto& msg = this->GetChannelMessages()->rows.at(row);
+
+        const std::string_view sender_username = this->chat_room_frame->GetUserDirectory()->GetUsername(msg.sender_id);
+
+        username = sender_username.empty() ? wxString("unknown: ") : wxString::Format("%s: ", sender_username.data());
+        message = msg.message.data();
+    });
+    this->messages_list->Bind(wxEVT_SCROLLWIN_LINEUP, [this](wxScrollWinEvent& evt) {
         this->OnScrollChange(evt);
     });
-    this->messages_panel->Bind(wxEVT_SCROLLWIN_LINEDOWN, [this](wxScrollWinEvent& evt) {
+    this->messages_list->Bind(wxEVT_SCROLLWIN_LINEDOWN, [this](wxScrollWinEvent& evt) {
         this->OnScrollChange(evt);
     });
-    this->messages_panel->Bind(wxEVT_SCROLLWIN_THUMBRELEASE, [this](wxScrollWinEvent& evt) {
+    this->messages_list->Bind(wxEVT_SCROLLWIN_THUMBRELEASE, [this](wxScrollWinEvent& evt) {
         this->OnScrollChange(evt);
     });
 
-    this->messages_sizer = new wxBoxSizer(wxVERTICAL);
-
-    this->messages_panel->SetSizer(this->messages_sizer);
-
     auto* new_msg_input = new wxTextCtrl(this, wxID_ANY, "", wxDefaultPosition, wxSize(360, 40), wxTE_PROCESS_ENTER);
     new_msg_input->SetBackgroundColour(wxColour(50, 50, 60));
     new_msg_input->SetForegroundColour(*wxWHITE);
@@ -108,99 +93,222 @@ ChatPanel::ChatPanel(const uint32_t channel_id, const uint16_t server_id, wxWind
     this->GetNewMessageInput()->SetMinSize(wxSize(-1, 50));
     this->GetNewMessageInput()->SetMaxSize(wxSize(-1, 50));
 
-    main_sizer->Add(this->GetMessagesPanel(), wxSizerFlags(1).Expand());
+    main_sizer->Add(this->GetMessagesList(), wxSizerFlags(1).Expand());
     main_sizer->Add(this->GetNewMessageInput(), wxSizerFlags(0).Expand());
 
     this->SetSizerAndFit(main_sizer);
 
     this->Bind(wxEVT_CHAT_UPDATE, &ChatPanel::OnChatUpdate, this);
 
-    this->LoadChannelData();
+    this->chat_update_timer = new wxTimer(this, wxID_ANY);
+
+    this->Bind(wxEVT_TIMER, [this](wxTimerEvent& event) { this->FlushPendingMessages(); }, this->chat_update_timer->GetId());
+
+    this->load_retry_timer = new wxTimer(this, wxID_ANY);
+
+    this->Bind(wxEVT_TIMER, [this](wxTimerEvent& event) { this->QueueResync(); }, this->load_retry_timer->GetId());
+
+    // Show the cached history right away, then fetch only what was sent since
+    this->LoadCachedChannelMessages();
     this->RedrawMessages();
+
+    this->CallAfter([this]() {
+        this->LoadChannelData();
+        this->RedrawMessages();
+    });
 }
 
 ChatPanel::~ChatPanel() {
-    swiftnet_client_cleanup(this->GetClientConnection());
+    this->LeaveChannel();
+
+    delete this->GetClientConnection();
+
+    this->chat_update_timer->Stop();
+    delete this->chat_update_timer;
+
+    this->load_retry_timer->Stop();
+    delete this->load_retry_timer;
 }
 
 void ChatPanel::RedrawMessages() {
-    this->messages_panel->Freeze();
+    TRACE_SCOPE("client", "RedrawMessages");
 
-    this->messages_sizer->Clear(true);
+    this->messages_list->SetMessagesCount(this->GetChannelMessages()->rows.size());
 
-    for (const auto& msg : *this->GetChannelMessages()) {
-        wxBoxSizer* row_sizer = new wxBoxSizer(wxHORIZONTAL);
+    if (this->messages_panel_bottom) {
+        this->messages_list->ScrollToBottom();
+    }
+}
 
-        wxStaticText* username_text = new wxStaticText(this->messages_panel, wxID_ANY, wxString::Format("%s: ", msg.sender_username));
-        username_text->SetFont(username_text->GetFont().Scale(1.1f).Bold());
-        username_text->SetForegroundColour(wxColour(180, 180, 255));
+bool ChatPanel::HandleLoadChannelDataRequest(transport::Packet* const packet_data) {
+    const ResponseInfo* const response_info = (ResponseInfo*)packet_data->Read(sizeof(ResponseInfo));
+    if (response_info == nullptr || response_info->request_type != RequestType::LOAD_CHANNEL_DATA) {
+        return true;
+    }
 
-        wxStaticText* message_text = new wxStaticText(this->messages_panel, wxID_ANY, msg.message);
-        message_text->SetFont(message_text->GetFont().Scale(1.6f));
-        message_text->SetForegroundColour(*wxWHITE);
-        message_text->Wrap(600);
+    // A rejection carries no response body
+    if (response_info->request_status == Status::RATE_LIMITED) {
+        return false;
+    }
 
-        row_sizer->Add(username_text, wxSizerFlags(0).Border(wxRIGHT, 8).Align(wxALIGN_CENTER_VERTICAL));
-        row_sizer->Add(message_text, wxSizerFlags(1).Align(wxALIGN_CENTER_VERTICAL));
+    const responses::LoadChannelDataResponse* response = (responses::LoadChannelDataResponse*)packet_data->Read(sizeof(responses::LoadChannelDataResponse));
+    if (response == nullptr) {
+        return true;
+    }
 
-        this->messages_sizer->Add(row_sizer, wxSizerFlags(0).Expand().Border(wxTOP | wxBOTTOM, 6));
+    if (response_info->request_status != Status::SUCCESS) {
+        // Handle errors
+        return true;
     }
 
-    this->messages_sizer->Layout();
-    this->messages_panel->FitInside();
+    LOG_DEBUG(CLIENT, "Loaded %u channel messages", response->channel_messages_len);
 
-    if (this->messages_panel_bottom) {
-        printf("Scrolling auto\n");
+    utils::trace::ScopedSpan deserialize_span("client", "DeserializeChannelMessages");
+
+    objects::ChannelMessageBatch loaded;
+
+    const bool complete = objects::DeserializeChannelMessages(packet_data, response->channel_messages_len, &loaded);
+    if (!complete) {
+        LOG_WARN(CLIENT, "Channel data ended before its %u messages", response->channel_messages_len);
+    }
+
+    deserialize_span.End();
 
-        int maxPos = this->messages_panel->GetScrollRange(wxVERTICAL) - this->messages_panel->GetScrollThumb(wxVERTICAL);
+    // Periodic updates flushed while this was in flight may already hold some of these
+    const size_t first_row = this->MergeChannelMessages(loaded);
 
-        this->messages_panel->Scroll(-1, maxPos);
+    // The load started before the prefetched page, so the history has no gap left and can be cached
+    if (complete) {
+        this->history_partial = false;
     }
 
-    this->messages_panel->Thaw();
+    this->ResolveSenders(first_row);
+    this->PersistChannelMessages();
+    this->TrimChannelMessages();
 
-    this->Layout();
+    return true;
 }
 
-void ChatPanel::HandleLoadChannelDataRequest(SwiftNetClientPacketData* const packet_data) {
-    const ResponseInfo* const response_info = (ResponseInfo*)swiftnet_client_read_packet(packet_data, sizeof(ResponseInfo));
-    if (response_info == nullptr || response_info->request_type != RequestType::LOAD_CHANNEL_DATA) {
+// Updates and loads can arrive in either order around a resync, so an older message fills its gap instead of being dropped
+size_t ChatPanel::MergeChannelMessages(const objects::ChannelMessageBatch& messages) {
+    objects::ChannelMessageBatch* const channel_messages = this->GetChannelMessages();
+
+    const size_t old_rows_len = channel_messages->rows.size();
+
+    size_t first_row = old_rows_len;
+
+    for (auto& message : messages.rows) {
+        if (message.id > this->GetLastMessageId()) {
+            channel_messages->Add(message);
+            continue;
+        }
+
+        auto& rows = channel_messages->rows;
+
+        auto position = std::lower_bound(rows.begin(), rows.end(), message.id, [](const objects::Database::ChannelMessageRow& row, const uint32_t id) {
+            return row.id < id;
+        });
+
+        if (position != rows.end() && position->id == message.id) {
+            continue;
+        }
+
+        const size_t index = position - rows.begin();
+
+        channel_messages->Insert(index, message);
+
+        first_row = std::min(first_row, index);
+
+        // Rows before the boundary are all cached, so a gap filled there is cached on its own
+        if (index < this->persisted_messages_len) {
+            wxGetApp().GetDatabase()->InsertCachedChannelMessages(this->GetServerIpAddress(), this->GetServerId(), this->GetChannelId(), &rows[index], 1, this->chat_room_frame->GetUserDirectory());
+
+            this->persisted_messages_len++;
+        }
+    }
+
+    if (first_row < old_rows_len) {
+        this->messages_list->InvalidateMessagesFrom(first_row);
+    }
+
+    return first_row;
+}
+
+// A sender the directory doesn't know joined after the roster was loaded, one resync covers every row
+void ChatPanel::ResolveSenders(const size_t first_row) {
+    objects::UserDirectory* const user_directory = this->chat_room_frame->GetUserDirectory();
+
+    const auto& rows = this->GetChannelMessages()->rows;
+
+    for (size_t i = first_row; i < rows.size(); i++) {
+        if (!user_directory->Contains(rows[i].sender_id)) {
+            this->chat_room_frame->LoadUserRoster(this->GetClientConnection());
+            return;
+        }
+    }
+}
+
+void ChatPanel::PersistChannelMessages() {
+    auto& rows = this->GetChannelMessages()->rows;
+    if (this->history_partial || this->persisted_messages_len >= rows.size()) {
         return;
     }
 
-    const responses::LoadChannelDataResponse* response = (responses::LoadChannelDataResponse*)swiftnet_client_read_packet(packet_data, sizeof(responses::LoadChannelDataResponse));
-    if (response == nullptr) {
+    int result = wxGetApp().GetDatabase()->InsertCachedChannelMessages(this->GetServerIpAddress(), this->GetServerId(), this->GetChannelId(), rows.data() + this->persisted_messages_len, rows.size() - this->persisted_messages_len, this->chat_room_frame->GetUserDirectory());
+    if (result != 0) {
         return;
     }
 
-    if (response_info->request_status != Status::SUCCESS) {
-        // Handle errors
+    this->persisted_messages_len = rows.size();
+}
+
+void ChatPanel::TrimChannelMessages() {
+    const size_t rows_len = this->GetChannelMessages()->rows.size();
+    if (rows_len <= CHANNEL_HISTORY_MAX_MESSAGES) {
         return;
     }
 
-    printf("Channel messages got: %d\n", response->channel_messages_len);
+    this->GetChannelMessages()->KeepLast(CHANNEL_HISTORY_TRIMMED_MESSAGES);
 
-    auto channel_messages = DeserializeChannelMessages(packet_data, response->channel_messages_len);
+    const size_t dropped = rows_len - CHANNEL_HISTORY_TRIMMED_MESSAGES;
 
-    *(this->GetChannelMessages()) = *channel_messages;
+    this->persisted_messages_len = this->persisted_messages_len > dropped ? this->persisted_messages_len - dropped : 0;
+
+    // Every row moved up, a count that didn't shrink would keep drawing the old rows' layouts
+    this->messages_list->InvalidateMessagesFrom(0);
 }
 
-void ChatPanel::OnScrollChange(wxScrollWinEvent& evt) {
-    int currentPos = this->messages_panel->GetScrollPos(wxVERTICAL);
+void ChatPanel::LoadCachedChannelMessages() {
+    wxGetApp().GetDatabase()->SelectCachedChannelMessages(this->GetServerIpAddress(), this->GetServerId(), this->GetChannelId(), this->GetChannelMessages(), this->chat_room_frame->GetUserDirectory());
 
-    int maxPos = this->messages_panel->GetScrollRange(wxVERTICAL) - this->messages_panel->GetScrollThumb(wxVERTICAL);
+    this->persisted_messages_len = this->GetChannelMessages()->rows.size();
 
-    printf("Current Pos: %d\nMax Pos: %d\n", currentPos, maxPos);
+    // Nothing cached yet, the prefetched newest page is shown until the full history arrives
+    if (this->persisted_messages_len == 0) {
+        objects::ChannelMessageBatch* const page = this->chat_room_frame->TakePrefetchedPage(this->GetChannelId());
 
-    bool bottom = (currentPos + 1) >= maxPos;
+        if (page != nullptr) {
+            this->MergeChannelMessages(*page);
+            this->history_partial = true;
 
-    this->messages_panel_bottom = bottom;
+            delete page;
+        }
+    }
 
+    this->TrimChannelMessages();
+}
+
+void ChatPanel::OnScrollChange(wxScrollWinEvent& evt) {
     evt.Skip();
+
+    // The list only knows its new position once the scroll event has been handled
+    this->CallAfter([this]() {
+        this->messages_panel_bottom = this->messages_list->IsScrolledToBottom();
+    });
 }
 
 void ChatPanel::SendMessage(const char* message, const uint32_t message_len) {
-    SwiftNetClientConnection* connection = this->GetClientConnection();
+    transport::ClientTransport* connection = this->GetClientConnection();
 
     const RequestInfo request_info = {
         .request_type = SEND_MESSAGE
@@ -211,20 +319,39 @@ void ChatPanel::SendMessage(const char* message, const uint32_t message_len) {
         .channel_id = this->GetChannelId()
     };
 
-    auto buffer = swiftnet_client_create_packet_buffer(sizeof(request_info) + sizeof(request_data) + message_len);
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data) + message_len);
 
-    swiftnet_client_append_to_packet(&request_info, sizeof(request_info), &buffer);
-    swiftnet_client_append_to_packet(&request_data, sizeof(request_data), &buffer);
-    swiftnet_client_append_to_packet(message, message_len, &buffer);
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
+    buffer->Append(message, message_len);
 
-    swiftnet_client_send_packet(connection, &buffer);
+    connection->SendPacket(buffer.Get());
+
+}
+
+void ChatPanel::LeaveChannel() {
+    transport::ClientTransport* connection = this->GetClientConnection();
+
+    const RequestInfo request_info = {
+        .request_type = LEAVE_CHANNEL
+    };
+
+    const requests::LeaveChannelRequest request_data = {
+        .channel_id = this->GetChannelId()
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
+
+    connection->SendPacket(buffer.Get());
 
-    swiftnet_client_destroy_packet_buffer(&buffer);
 }
 
 void ChatPanel::InitializeConnection(const in_addr ip_address) {
     const char* ip_address_string = inet_ntoa(ip_address);
-    SwiftNetClientConnection* new_connection = swiftnet_create_client(ip_address_string, this->GetServerId(), DEFAULT_TIMEOUT_CLIENT_CREATION);
+    transport::ClientTransport* new_connection = transport::CreateClient(ip_address_string, this->GetServerId(), DEFAULT_TIMEOUT_CLIENT_CREATION);
     if (new_connection == nullptr) {
         fprintf(stderr, "Failed to connect to server\n");
         return;
@@ -233,69 +360,210 @@ void ChatPanel::InitializeConnection(const in_addr ip_address) {
     this->client_connection = new_connection;
 }
 
-void ChatPanel::HandlePeriodicChatUpdate(struct SwiftNetClientPacketData* const packet_data) {
-    auto response = (responses::PeriodicChatUpdateResponse*)swiftnet_client_read_packet(packet_data, sizeof(responses::PeriodicChatUpdateResponse));
+void ChatPanel::HandlePeriodicChatUpdate(transport::Packet* const packet_data) {
+    auto response = (responses::PeriodicChatUpdateResponse*)packet_data->Read(sizeof(responses::PeriodicChatUpdateResponse));
 
-    printf("Periodic update\nNew messages: %d\n", response->channel_messages_len);
+    LOG_DEBUG(CLIENT, "Periodic update with %u new messages", response->channel_messages_len);
     
-    auto new_messages = DeserializeChannelMessages(packet_data, response->channel_messages_len);
+    utils::trace::ScopedSpan deserialize_span("client", "DeserializeChannelMessages");
+
+    // Reuses a batch the UI thread is done with when there is one
+    objects::ChannelMessageBatch new_messages;
+    this->recycled_messages.TryPop(new_messages);
+
+    if (!objects::DeserializeChannelMessages(packet_data, response->channel_messages_len, &new_messages)) {
+        LOG_WARN(CLIENT, "Chat update ended before its %u messages", response->channel_messages_len);
+    }
+
+    deserialize_span.End();
+
+    delete packet_data;
+
+    // The server sorts each channel's messages by id
+    const uint32_t first_message_id = new_messages.rows.empty() ? 0 : new_messages.rows.front().id;
+
+    // The UI thread drains one batch per update and only falls this far behind while blocked. Waiting for it would
+    // stall every other update on this connection, so the batch is dropped and reloaded once the UI catches up.
+    if (!this->incoming_messages.TryPush(std::move(new_messages))) {
+        LOG_WARN(CLIENT, "Dropped a chat update for channel %u, the UI is behind", this->GetChannelId());
+
+        if (first_message_id > 0) {
+            this->LowerResyncAfterId(first_message_id - 1);
+        }
+
+        this->QueueResync();
+
+        return;
+    }
+
+    // Only a batch the UI will show counts as taken, a panel dropping them has to look behind to the server
+    this->AcknowledgeChatUpdate();
+
+    if (!this->chat_update_queued.exchange(true, std::memory_order_acq_rel)) {
+        wxQueueEvent(this, new wxCommandEvent(wxEVT_CHAT_UPDATE));
+    }
+}
+
+// The server stopped sending this channel because the panel fell behind, reload everything since the last message
+void ChatPanel::HandleChatResync(transport::Packet* const packet_data) {
+    LOG_INFO(CLIENT, "Server asked to resync channel %u", this->GetChannelId());
+
+    delete packet_data;
+
+    this->QueueResync();
+}
+
+void ChatPanel::QueueResync() {
+    if (this->resync_queued.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    this->CallAfter([this]() {
+        this->resync_queued.store(false, std::memory_order_release);
+
+        this->FlushPendingMessages();
+        this->LoadChannelData();
+        this->RedrawMessages();
+    });
+}
+
+void ChatPanel::LowerResyncAfterId(const uint32_t message_id) {
+    uint32_t after_id = this->resync_after_id.load(std::memory_order_relaxed);
+
+    while (message_id < after_id && !this->resync_after_id.compare_exchange_weak(after_id, message_id, std::memory_order_acq_rel)) {
+    }
+}
 
-    this->channel_messages.insert(this->GetChannelMessages()->end(), new_messages->data(), new_messages->data() + new_messages->size());
+// Messages are sent without waiting, the server only answers the ones it turned away for being sent too fast
+void ChatPanel::HandleSendMessageRejected(transport::Packet* const packet_data) {
+    delete packet_data;
 
-    auto* evt = new wxCommandEvent(wxEVT_CHAT_UPDATE);
-    wxQueueEvent(this, evt);
+    LOG_WARN(CLIENT, "Message to channel %u was rate limited", this->GetChannelId());
 
-    swiftnet_client_destroy_packet_data(packet_data, this->GetClientConnection());
+    this->CallAfter([this]() {
+        this->GetNewMessageInput()->SetHint("Sending too fast, wait a moment");
+    });
+}
+
+// Fire and forget, the server only counts these to find panels that can't keep up
+void ChatPanel::AcknowledgeChatUpdate() {
+    const RequestInfo request_info = {
+        .request_type = ACKNOWLEDGE_CHAT_UPDATE
+    };
+
+    const requests::AcknowledgeChatUpdateRequest request_data = {
+        .channel_id = this->GetChannelId()
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
+
+    this->GetClientConnection()->SendPacket(buffer.Get());
 }
 
 void ChatPanel::OnChatUpdate(wxCommandEvent& event) {
+    this->chat_update_queued.store(false, std::memory_order_release);
+
+    if (!this->chat_update_timer->IsRunning()) {
+        this->chat_update_timer->StartOnce(CHAT_UPDATE_FRAME_INTERVAL);
+    }
+}
+
+void ChatPanel::FlushPendingMessages() {
+    TRACE_SCOPE("client", "FlushPendingMessages");
+
+    objects::ChannelMessageBatch batch;
+
+    size_t first_row = this->GetChannelMessages()->rows.size();
+
+    bool received = false;
+
+    while (this->incoming_messages.TryPop(batch)) {
+        first_row = std::min(first_row, this->MergeChannelMessages(batch));
+
+        batch.Clear();
+        this->recycled_messages.TryPush(std::move(batch));
+
+        received = true;
+    }
+
+    if (!received) {
+        return;
+    }
+
+    this->ResolveSenders(first_row);
+    this->PersistChannelMessages();
+    this->TrimChannelMessages();
+
+    // Lays out only the new rows and those a merge moved, the rest are left alone
     this->RedrawMessages();
 }
 
 void ChatPanel::LoadChannelData() {
-    SwiftNetClientConnection* connection = this->GetClientConnection();
+    transport::ClientTransport* connection = this->GetClientConnection();
 
     const RequestInfo request_info = {
         .request_type = LOAD_CHANNEL_DATA
     };
 
+    // Starts before any batch the transport thread dropped, the merge skips what is already shown
+    const uint32_t dropped_after_id = this->resync_after_id.exchange(UINT32_MAX, std::memory_order_acq_rel);
+
+    // A prefetched page is shown with nothing cached before it, so everything is loaded
+    const uint32_t last_message_id = this->history_partial ? 0 : this->GetLastMessageId();
+
     const requests::LoadChannelDataRequest request_data = {
-        .channel_id = this->GetChannelId()
+        .channel_id = this->GetChannelId(),
+        .after_message_id = std::min(last_message_id, dropped_after_id),
+        .limit = 0,
+        .subscribe = true,
+        .newest = false
     };
 
-    auto buffer = swiftnet_client_create_packet_buffer(sizeof(request_info) + sizeof(request_data));
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
 
-    swiftnet_client_append_to_packet(&request_info, sizeof(request_info), &buffer);
-    swiftnet_client_append_to_packet(&request_data, sizeof(request_data), &buffer);
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
 
-    SwiftNetClientPacketData* const response = swiftnet_client_make_request(connection, &buffer, DEFAULT_TIMEOUT_REQUEST);
+    transport::Packet* const response = connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
     if (response == nullptr) {
-        swiftnet_client_destroy_packet_buffer(&buffer);
-
         return;
     }
 
-    swiftnet_client_destroy_packet_buffer(&buffer);
+    // This load is what subscribes the panel, so a rejected one is tried again from the same message instead of given up
+    if (this->HandleLoadChannelDataRequest(response)) {
+        this->load_retry_delay = 0;
+    } else {
+        this->LowerResyncAfterId(request_data.after_message_id);
 
-    this->HandleLoadChannelDataRequest(response);
+        this->load_retry_delay = this->load_retry_delay == 0 ? CHANNEL_LOAD_RETRY_MIN_DELAY : std::min<uint32_t>(this->load_retry_delay * 2, CHANNEL_LOAD_RETRY_MAX_DELAY);
 
-    swiftnet_client_destroy_packet_data(response, connection);
+        LOG_WARN(CLIENT, "Server is rate limiting channel loads, retrying channel %u in %u ms", this->GetChannelId(), this->load_retry_delay);
+
+        if (!this->load_retry_timer->IsRunning()) {
+            this->load_retry_timer->StartOnce(this->load_retry_delay);
+        }
+    }
+
+    delete response;
 }
 
 wxTextCtrl* ChatPanel::GetNewMessageInput() {
     return this->new_message_input;
 }
 
-std::vector<objects::Database::ChannelMessageRow>* ChatPanel::GetChannelMessages() {
+objects::ChannelMessageBatch* ChatPanel::GetChannelMessages() {
     return &this->channel_messages;
 }
 
-SwiftNetClientConnection* ChatPanel::GetClientConnection() {
+transport::ClientTransport* ChatPanel::GetClientConnection() {
     return this->client_connection;
 }
 
-wxPanel* ChatPanel::GetMessagesPanel() {
-    return this->messages_panel;
+widgets::MessageList* ChatPanel::GetMessagesList() {
+    return this->messages_list;
 }
 
 uint16_t ChatPanel::GetServerId() {
@@ -305,3 +573,15 @@ uint16_t ChatPanel::GetServerId() {
 uint32_t ChatPanel::GetChannelId() {
     return this->channel_id;
 }
+
+uint32_t ChatPanel::GetLastMessageId() {
+    if (this->GetChannelMessages()->rows.empty()) {
+        return 0;
+    }
+
+    return this->GetChannelMessages()->rows.back().id;
+}
+
+in_addr ChatPanel::GetServerIpAddress() {
+    return this->server_ip_address;
+}
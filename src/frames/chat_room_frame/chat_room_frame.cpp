@@ -1,8 +1,14 @@
 #include "../frames.hpp"
-#include <swift_net.h>
+#include <arpa/inet.h>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <wx/event.h>
 #include <wx/osx/frame.h>
 #include <wx/osx/stattext.h>
@@ -11,11 +17,12 @@
 #include <wx/sizer.h>
 #include <wx/versioninfo.h>
 #include "../../main.hpp"
+#include "../../utils/log/log.hpp"
 
 using frames::ChatRoomFrame;
 
-static void packet_handler(SwiftNetClientPacketData* const packet_data, void* const user) {
-
+static void packet_handler(transport::Packet* const packet_data, void* const user) {
+    delete packet_data;
 }
 
 ChatRoomFrame::ChatRoomFrame(const in_addr ip_address, const uint16_t server_id) : wxFrame(wxGetApp().GetHomeFrame(), wxID_ANY, "Chat Room", wxDefaultPosition, wxSize(800, 600)), server_id(server_id), server_ip_address(ip_address)  {
@@ -40,7 +47,7 @@ ChatRoomFrame::ChatRoomFrame(const in_addr ip_address, const uint16_t server_id)
     // Handle loading server
     const char* string_ip = inet_ntoa(ip_address);
 
-    SwiftNetClientConnection* const connection = swiftnet_create_client(string_ip, server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
+    transport::ClientTransport* const connection = transport::CreateClient(string_ip, server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
     if (connection == NULL) {
         // Handle server not started, or any error
         return;
@@ -48,9 +55,11 @@ ChatRoomFrame::ChatRoomFrame(const in_addr ip_address, const uint16_t server_id)
 
     this->client_connection = connection;
 
-    swiftnet_client_set_message_handler(connection, packet_handler, nullptr);
+    connection->SetMessageHandler(packet_handler, nullptr);
 
     this->LoadServerInformation();
+    this->LoadUserRoster(connection);
+    this->PrefetchChannels();
 }
 
 ChatRoomFrame::~ChatRoomFrame() {
@@ -67,7 +76,19 @@ ChatRoomFrame::~ChatRoomFrame() {
         delete chat_chanel;
     }
 
-    swiftnet_client_cleanup(this->client_connection);
+    if (this->prefetch_thread != nullptr) {
+        this->stop_prefetch.store(true, std::memory_order_release);
+
+        this->prefetch_thread->join();
+
+        delete this->prefetch_thread;
+    }
+
+    for (auto& [channel_id, page] : this->prefetched_pages) {
+        delete page;
+    }
+
+    delete this->client_connection;
 }
 
 void ChatRoomFrame::UpdateMainSizer() {
@@ -93,15 +114,7 @@ void ChatRoomFrame::DrawChannels() {
 
     for (auto &channel : *this->GetChatChannels()) {
         widgets::Button* channel_button = new widgets::Button(this->channel_list_panel, channel->GetName(), [this, channel](wxMouseEvent& event){
-            if (this->GetChatPanel() != nullptr) {
-                delete this->GetChatPanel();
-
-                this->chat_panel = nullptr;
-            }
-
-            this->chat_panel = new ChatPanel(channel->GetId(), this->GetServerId(), this->main_panel, this->GetServerIpAddress());
-
-            this->UpdateMainSizer();
+            this->OpenChannel(channel);
         });
         channel_button->SetMinSize(wxSize(-1, 30));
         channel_button->SetMaxSize(wxSize(-1, 30));
@@ -114,9 +127,169 @@ void ChatRoomFrame::DrawChannels() {
     this->channel_list_panel->Layout();
 }
 
-void ChatRoomFrame::HandleLoadServerInfoResponse(SwiftNetClientPacketData* const packet_data) {
-    auto request_info = (ResponseInfo*)swiftnet_client_read_packet(packet_data, sizeof(ResponseInfo*));
-    auto request_data = (responses::LoadServerInformationResponse*)swiftnet_client_read_packet(packet_data, sizeof(responses::LoadServerInformationResponse));
+void ChatRoomFrame::OpenChannel(ChatChannel* const channel) {
+    ChatPanel* panel = this->GetWarmChatPanel(channel->GetId());
+
+    if (panel == nullptr) {
+        panel = new ChatPanel(channel->GetId(), this->GetServerId(), this->main_panel, this->GetServerIpAddress(), this);
+
+        this->warm_chat_panels.push_front(panel);
+
+        // The server keeps one subscription per warm panel, so the cache can't be larger than that
+        while (this->warm_chat_panels.size() > MAX_CHANNEL_SUBSCRIPTIONS) {
+            delete this->warm_chat_panels.back();
+
+            this->warm_chat_panels.pop_back();
+        }
+    }
+
+    if (this->GetChatPanel() != nullptr && this->GetChatPanel() != panel) {
+        this->GetChatPanel()->Hide();
+    }
+
+    this->chat_panel = panel;
+    this->chat_panel->Show();
+
+    this->UpdateMainSizer();
+}
+
+ChatRoomFrame::ChatPanel* ChatRoomFrame::GetWarmChatPanel(const uint32_t channel_id) {
+    for (auto it = this->warm_chat_panels.begin(); it != this->warm_chat_panels.end(); it++) {
+        if ((*it)->GetChannelId() != channel_id) {
+            continue;
+        }
+
+        ChatPanel* panel = *it;
+
+        this->warm_chat_panels.splice(this->warm_chat_panels.begin(), this->warm_chat_panels, it);
+
+        return panel;
+    }
+
+    return nullptr;
+}
+
+void ChatRoomFrame::PrefetchChannels() {
+    std::vector<std::pair<uint32_t, uint32_t>> channels;
+
+    for (auto &channel : *this->GetChatChannels()) {
+        const uint32_t last_message_id = wxGetApp().GetDatabase()->SelectCachedChannelLastMessageId(this->GetServerIpAddress(), this->GetServerId(), channel->GetId());
+
+        channels.emplace_back(channel->GetId(), last_message_id);
+    }
+
+    if (channels.empty()) {
+        return;
+    }
+
+    char ip_address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &this->server_ip_address, ip_address, sizeof(ip_address));
+
+    this->prefetch_thread = new std::thread([this, channels, ip_address = std::string(ip_address)]() {
+        // A connection of its own, the UI thread keeps making requests on the frame's
+        transport::ClientTransport* const connection = transport::CreateClient(ip_address.c_str(), this->GetServerId(), DEFAULT_TIMEOUT_CLIENT_CREATION);
+        if (connection == nullptr) {
+            return;
+        }
+
+        connection->SetMessageHandler(packet_handler, nullptr);
+
+        for (const auto& [channel_id, last_message_id] : channels) {
+            if (this->stop_prefetch.load(std::memory_order_acquire)) {
+                break;
+            }
+
+            this->PrefetchChannel(connection, channel_id, last_message_id);
+        }
+
+        delete connection;
+    });
+}
+
+// Runs on the prefetch thread. A cached channel pages forward from its last message so the cache never has gaps,
+// an uncached one only gets its newest page, which opening it shows while the full history loads.
+void ChatRoomFrame::PrefetchChannel(transport::ClientTransport* const connection, const uint32_t channel_id, const uint32_t after_message_id) {
+    const bool newest = after_message_id == 0;
+
+    uint32_t last_message_id = after_message_id;
+
+    for (uint32_t page = 0; page < MAX_PREFETCH_PAGES; page++) {
+        // Pages share the sender's expensive request budget with the panels, paced below its rate they never use it up
+        std::this_thread::sleep_for(std::chrono::milliseconds(PREFETCH_REQUEST_INTERVAL));
+
+        if (this->stop_prefetch.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        const RequestInfo request_info = {
+            .request_type = LOAD_CHANNEL_DATA
+        };
+
+        const requests::LoadChannelDataRequest request_data = {
+            .channel_id = channel_id,
+            .after_message_id = last_message_id,
+            .limit = CHANNEL_PAGE_SIZE,
+            .subscribe = false,
+            .newest = newest
+        };
+
+        transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+
+        buffer->Append(&request_info, sizeof(request_info));
+        buffer->Append(&request_data, sizeof(request_data));
+
+        transport::Packet* const packet_data = connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
+
+        if (packet_data == nullptr) {
+            return;
+        }
+
+        const ResponseInfo* const response_info = (ResponseInfo*)packet_data->Read(sizeof(ResponseInfo));
+        const responses::LoadChannelDataResponse* const response = (responses::LoadChannelDataResponse*)packet_data->Read(sizeof(responses::LoadChannelDataResponse));
+
+        if (response_info->request_type != RequestType::LOAD_CHANNEL_DATA || response_info->request_status != Status::SUCCESS || response->channel_messages_len == 0) {
+            delete packet_data;
+            return;
+        }
+
+        const bool has_more = response->has_more;
+
+        objects::ChannelMessageBatch* const messages = new objects::ChannelMessageBatch();
+
+        const bool complete = objects::DeserializeChannelMessages(packet_data, response->channel_messages_len, messages);
+
+        delete packet_data;
+
+        if (messages->rows.empty()) {
+            delete messages;
+            return;
+        }
+
+        last_message_id = messages->rows.back().id;
+
+        // The database belongs to the UI thread, the page's text goes with its batch once it is stored
+        this->CallAfter([this, channel_id, messages, newest]() {
+            if (newest) {
+                delete this->prefetched_pages[channel_id];
+
+                this->prefetched_pages[channel_id] = messages;
+                return;
+            }
+
+            wxGetApp().GetDatabase()->InsertCachedChannelMessages(this->GetServerIpAddress(), this->GetServerId(), channel_id, messages->rows.data(), messages->rows.size(), this->GetUserDirectory());
+
+            delete messages;
+        });
+
+        if (!complete || !has_more || newest) {
+            return;
+        }
+    }
+}
+
+void ChatRoomFrame::HandleLoadServerInfoResponse(transport::Packet* const packet_data) {
+    auto request_info = (ResponseInfo*)packet_data->Read(sizeof(ResponseInfo*));
+    auto request_data = (responses::LoadServerInformationResponse*)packet_data->Read(sizeof(responses::LoadServerInformationResponse));
 
     if (request_info->request_type != RequestType::LOAD_SERVER_INFORMATION) {
         return;
@@ -126,7 +299,7 @@ void ChatRoomFrame::HandleLoadServerInfoResponse(SwiftNetClientPacketData* const
         return;
     }
 
-    objects::Database::ServerChatChannelRow* rows = (objects::Database::ServerChatChannelRow*)swiftnet_client_read_packet(packet_data, sizeof(objects::Database::ServerChatChannelRow) * request_data->server_chat_channels_size);
+    objects::Database::ServerChatChannelRow* rows = (objects::Database::ServerChatChannelRow*)packet_data->Read(sizeof(objects::Database::ServerChatChannelRow) * request_data->server_chat_channels_size);
 
     for (uint32_t i = 0; i < request_data->server_chat_channels_size; i++) {
         auto channel = rows[i];
@@ -144,28 +317,49 @@ std::vector<ChatRoomFrame::ChatChannel*>* ChatRoomFrame::GetChatChannels() {
 }
 
 void ChatRoomFrame::LoadServerInformation() {
-    SwiftNetClientConnection* const connection = this->GetConnection();
+    transport::ClientTransport* const connection = this->GetConnection();
 
     const RequestInfo request_info = {
         .request_type = LOAD_SERVER_INFORMATION
     };
 
-    SwiftNetPacketBuffer buffer = swiftnet_client_create_packet_buffer(sizeof(request_info));
+    transport::PooledPacketBuffer buffer(sizeof(request_info));
 
-    swiftnet_client_append_to_packet(&request_info, sizeof(request_info), &buffer);
+    buffer->Append(&request_info, sizeof(request_info));
 
-    SwiftNetClientPacketData* const packet_data = swiftnet_client_make_request(connection, &buffer, DEFAULT_TIMEOUT_REQUEST);
+    transport::Packet* const packet_data = connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
     if (packet_data == NULL) {
-        swiftnet_client_destroy_packet_buffer(&buffer);
-
         return;
     }
 
     this->HandleLoadServerInfoResponse(packet_data);
 
-    swiftnet_client_destroy_packet_buffer(&buffer);
+    delete packet_data;
+}
+
+void ChatRoomFrame::LoadUserRoster(transport::ClientTransport* const connection) {
+    const RequestInfo request_info = {
+        .request_type = LOAD_USER_ROSTER
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(request_info));
+
+    buffer->Append(&request_info, sizeof(request_info));
+
+    transport::Packet* const packet_data = connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
+    if (packet_data == nullptr) {
+        return;
+    }
+
+    const ResponseInfo* const response_info = (ResponseInfo*)packet_data->Read(sizeof(ResponseInfo));
 
-    swiftnet_client_destroy_packet_data(packet_data, connection);
+    if (response_info != nullptr && response_info->request_type == RequestType::LOAD_USER_ROSTER && response_info->request_status == Status::SUCCESS) {
+        if (!this->GetUserDirectory()->Deserialize(packet_data)) {
+            LOG_WARN(CLIENT, "User roster ended early, %zu users loaded", this->GetUserDirectory()->GetSize());
+        }
+    }
+
+    delete packet_data;
 }
 
 ChatRoomFrame::ChatPanel* ChatRoomFrame::GetChatPanel() {
@@ -181,6 +375,23 @@ uint16_t ChatRoomFrame::GetServerId() {
 }
 
 
-SwiftNetClientConnection* ChatRoomFrame::GetConnection() {
+transport::ClientTransport* ChatRoomFrame::GetConnection() {
     return this->client_connection;
 }
+
+objects::UserDirectory* ChatRoomFrame::GetUserDirectory() {
+    return &this->user_directory;
+}
+
+objects::ChannelMessageBatch* ChatRoomFrame::TakePrefetchedPage(const uint32_t channel_id) {
+    auto page = this->prefetched_pages.find(channel_id);
+    if (page == this->prefetched_pages.end()) {
+        return nullptr;
+    }
+
+    objects::ChannelMessageBatch* const messages = page->second;
+
+    this->prefetched_pages.erase(page);
+
+    return messages;
+}
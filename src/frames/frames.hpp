@@ -6,12 +6,18 @@
 #include <wx/panel.h>
 #include <wx/scrolwin.h>
 #include <wx/sizer.h>
+#include <wx/timer.h>
 #include <wx/wx.h>
 #include "../widgets/widgets.hpp"
 #include "home_frame/panels/panels.hpp"
 #include <vector>
 #include "../objects/objects.hpp"
-#include <swift_net.h>
+#include "../utils/concurrency/spsc_queue.hpp"
+#include <atomic>
+#include <list>
+#include <thread>
+#include <unordered_map>
+#include "../transport/transport.hpp"
 
 namespace frames {
     class HomeFrame : public wxFrame {
@@ -43,7 +49,7 @@ namespace frames {
 
         class Channels : public wxPanel {
             public:
-                Channels(wxWindow* parent, SwiftNetClientConnection* client_connection);
+                Channels(wxWindow* parent, transport::ClientTransport* client_connection);
                 ~Channels();
 
             private:
@@ -59,11 +65,11 @@ namespace frames {
 
                 DECLARE_EVENT_TABLE()
 
-                SwiftNetClientConnection* client_connection;
+                transport::ClientTransport* client_connection;
         };
 
         private:
-            SwiftNetClientConnection* client_connection;
+            transport::ClientTransport* client_connection;
             widgets::MenuBar* menu_bar;
             wxPanel* active_menu = nullptr;
             AdminMenuFrame::Channels* channels_panel;
@@ -120,40 +126,84 @@ namespace frames {
 
         class ChatPanel : public wxPanel {
         public:
-            ChatPanel(const uint32_t channel_id, const uint16_t server_id, wxWindow* parent_window, const in_addr ip_address);
+            ChatPanel(const uint32_t channel_id, const uint16_t server_id, wxWindow* parent_window, const in_addr ip_address, ChatRoomFrame* const chat_room_frame);
             ~ChatPanel();
 
             void InitializeConnection(const in_addr ip_address);
 
             void LoadChannelData();
+            void LoadCachedChannelMessages();
 
             void SendMessage(const char* message, const uint32_t message_len);
+            void LeaveChannel();
             void OnScrollChange(wxScrollWinEvent& evt);
 
             uint16_t GetServerId();
             uint32_t GetChannelId();
-            SwiftNetClientConnection* GetClientConnection();
-            std::vector<objects::Database::ChannelMessageRow>* GetChannelMessages();
-            wxPanel* GetMessagesPanel();
+            uint32_t GetLastMessageId();
+            in_addr GetServerIpAddress();
+            transport::ClientTransport* GetClientConnection();
+            objects::ChannelMessageBatch* GetChannelMessages();
+            widgets::MessageList* GetMessagesList();
             wxTextCtrl* GetNewMessageInput();
-            void HandlePeriodicChatUpdate(struct SwiftNetClientPacketData* const packet_data);
+            void HandlePeriodicChatUpdate(transport::Packet* const packet_data);
+            void HandleChatResync(transport::Packet* const packet_data);
+            void HandleSendMessageRejected(transport::Packet* const packet_data);
         private:
-            void HandleLoadChannelDataRequest(SwiftNetClientPacketData* const packet_data);
+            void AcknowledgeChatUpdate();
+            // False when the server rate limited the load, nothing was merged
+            bool HandleLoadChannelDataRequest(transport::Packet* const packet_data);
+            // Merges by id, returns the first row that is new or moved
+            size_t MergeChannelMessages(const objects::ChannelMessageBatch& messages);
+            void PersistChannelMessages();
+            void TrimChannelMessages();
+            void ResolveSenders(const size_t first_row);
             void RedrawMessages();
             void OnChatUpdate(wxCommandEvent& event);
+            void FlushPendingMessages();
+            // Reloads on the UI thread, several requests before it runs share one reload
+            void QueueResync();
+            // Makes the next load start after the message at the latest
+            void LowerResyncAfterId(const uint32_t message_id);
 
-            SwiftNetClientConnection* client_connection;
+            transport::ClientTransport* client_connection;
+
+            // Owns the user directory that sender ids are resolved through
+            ChatRoomFrame* chat_room_frame;
             
             uint32_t channel_id;
             uint16_t server_id;
+            in_addr server_ip_address;
 
             wxTextCtrl* new_message_input;
-            wxScrolled<wxPanel>* messages_panel;
-            wxBoxSizer* messages_sizer;
+            widgets::MessageList* messages_list;
 
             bool messages_panel_bottom = true;
 
-            std::vector<objects::Database::ChannelMessageRow> channel_messages;
+            // The channel's whole history, its text lives in the batch's arena and is freed with the panel or by a trim
+            objects::ChannelMessageBatch channel_messages;
+
+            // Batches decoded on the transport thread, drained by the UI thread once per frame so a burst of updates costs one layout pass
+            utils::concurrency::SpscQueue<objects::ChannelMessageBatch, 256> incoming_messages;
+
+            // Drained batches handed back to the transport thread, so their arenas are reused instead of reallocated
+            utils::concurrency::SpscQueue<objects::ChannelMessageBatch, 8> recycled_messages;
+            std::atomic<bool> chat_update_queued = false;
+            wxTimer* chat_update_timer;
+
+            // Lowered by the transport thread when it drops a batch the UI had no room for, the next load starts there
+            std::atomic<uint32_t> resync_after_id = UINT32_MAX;
+            std::atomic<bool> resync_queued = false;
+
+            // Retries a rate limited load, the delay is 0 until a load was turned away
+            wxTimer* load_retry_timer;
+            uint32_t load_retry_delay = 0;
+
+            // Number of leading channel_messages already stored in the local cache
+            size_t persisted_messages_len = 0;
+
+            // Showing a prefetched newest page with older messages missing before it, nothing is cached until a full load filled them in
+            bool history_partial = false;
         };
 
         ChatRoomFrame(const in_addr ip_address, const uint16_t server_id);
@@ -162,28 +212,50 @@ namespace frames {
         void DrawChannels();
 
         void LoadServerInformation();
+        void PrefetchChannels();
+
+        // Replaces the user directory with the server's roster, any of the frame's connections can ask
+        void LoadUserRoster(transport::ClientTransport* const connection);
 
-        void HandleLoadServerInfoResponse(SwiftNetClientPacketData* packet_data);
+        void HandleLoadServerInfoResponse(transport::Packet* packet_data);
 
         uint16_t GetServerId();
         in_addr GetServerIpAddress();
         ChatPanel* GetChatPanel();
-        SwiftNetClientConnection* GetConnection();
+        transport::ClientTransport* GetConnection();
         std::vector<ChatChannel*>* GetChatChannels();
+        objects::UserDirectory* GetUserDirectory();
+        // The newest page prefetched for an uncached channel, the caller owns it. Null when there is none.
+        objects::ChannelMessageBatch* TakePrefetchedPage(const uint32_t channel_id);
     private:
         void UpdateMainSizer();
+        void OpenChannel(ChatChannel* const channel);
+        void PrefetchChannel(transport::ClientTransport* const connection, const uint32_t channel_id, const uint32_t after_message_id);
+        ChatPanel* GetWarmChatPanel(const uint32_t channel_id);
         
         wxPanel* channel_list_panel = nullptr;
 
         uint16_t server_id;
         in_addr server_ip_address;
 
-        SwiftNetClientConnection* client_connection;
+        transport::ClientTransport* client_connection;
         
         std::vector<ChatChannel*> chat_channels;
 
+        // Names of the server's members, shared by every chat panel of the frame
+        objects::UserDirectory user_directory;
+
         ChatPanel* chat_panel = nullptr;
 
+        // Recently viewed channels, most recent first. Hidden panels stay connected and subscribed so switching back is just a show
+        std::list<ChatPanel*> warm_chat_panels;
+
+        std::thread* prefetch_thread = nullptr;
+        std::atomic<bool> stop_prefetch = false;
+
+        // Newest pages of uncached channels by channel id. They stay out of the cache, which would take them for the whole history.
+        std::unordered_map<uint32_t, objects::ChannelMessageBatch*> prefetched_pages;
+
         wxScrolled<wxPanel>* users_panel;
 
         wxPanel* main_panel = nullptr;
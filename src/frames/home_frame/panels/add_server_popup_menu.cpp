@@ -2,7 +2,6 @@
 #include "../../../main.hpp"
 #include "../../../utils/crypto/crypto.hpp"
 #include "../../../utils/net/net.hpp"
-#include <swift_net.h>
 #include "../../../objects/objects.hpp"
 #include <wx/event.h>
 #include <wx/timer.h>
@@ -100,13 +99,13 @@ AddServerPopupMenu::AddServerPopupMenu(wxWindow* parent, wxPoint pos) : wxDialog
 AddServerPopupMenu::~AddServerPopupMenu() = default;
 
 AddServerPopupMenu::RequestServerExistationStatus AddServerPopupMenu::RequestServerExistsConfirmation(const char* ip_address, uint16_t server_id, const in_addr address, const char* username) {
-    SwiftNetClientConnection* client = nullptr;
+    transport::ClientTransport* client = nullptr;
 
     // Connect to local private IP if this is our own public IP
     if (address.s_addr == utils::net::get_public_ip().s_addr) {
-        client = swiftnet_create_client(inet_ntoa(utils::net::get_private_ip()), server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
+        client = transport::CreateClient(inet_ntoa(utils::net::get_private_ip()), server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
     } else {
-        client = swiftnet_create_client(ip_address, server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
+        client = transport::CreateClient(ip_address, server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
     }
 
     if (!client) {
@@ -117,25 +116,23 @@ AddServerPopupMenu::RequestServerExistationStatus AddServerPopupMenu::RequestSer
     requests::JoinServerRequest request_data = {};
     strncpy(request_data.username, username, sizeof(request_data.username) - 1);
 
-    auto buffer = swiftnet_client_create_packet_buffer(sizeof(request_info) + sizeof(request_data));
-    swiftnet_client_append_to_packet(&request_info, sizeof(request_info), &buffer);
-    swiftnet_client_append_to_packet(&request_data, sizeof(request_data), &buffer);
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
 
-    SwiftNetClientPacketData* response = swiftnet_client_make_request(client, &buffer, DEFAULT_TIMEOUT_REQUEST);
-
-    swiftnet_client_destroy_packet_buffer(&buffer);
+    transport::Packet* response = client->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
 
     if (!response) {
-        swiftnet_client_cleanup(client);
+        delete client;
         return NO_RESPONSE;
     }
 
-    auto* resp_info = (ResponseInfo*)swiftnet_client_read_packet(response, sizeof(ResponseInfo));
-    auto* resp_data = (responses::JoinServerResponse*)swiftnet_client_read_packet(response, sizeof(responses::JoinServerResponse));
+    auto* resp_info = (ResponseInfo*)response->Read(sizeof(ResponseInfo));
+    auto* resp_data = (responses::JoinServerResponse*)response->Read(sizeof(responses::JoinServerResponse));
 
     if (resp_info->request_type != RequestType::JOIN_SERVER) {
-        swiftnet_client_destroy_packet_data(response, client);
-        swiftnet_client_cleanup(client);
+        delete response;
+        delete client;
         return UNKNOWN_RESPONSE;
     }
 
@@ -148,8 +145,8 @@ AddServerPopupMenu::RequestServerExistationStatus AddServerPopupMenu::RequestSer
     } else {
     }
 
-    swiftnet_client_destroy_packet_data(response, client);
-    swiftnet_client_cleanup(client);
+    delete response;
+    delete client;
 
     return SUCCESSFULLY_CONNECTED;
 }
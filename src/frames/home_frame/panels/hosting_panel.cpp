@@ -4,6 +4,7 @@
 #include <cstring>
 #include <functional>
 #include <string>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 #include <wx/event.h>
@@ -17,7 +18,7 @@
 
 using namespace frames::home_frame::panels;
 
-HostingPanel::HostingPanel(wxPanel* parent_panel) : wxPanel(parent_panel) {
+HostingPanel::HostingPanel(wxPanel* parent_panel) : wxPanel(parent_panel), lifecycle(SERVER_LIFECYCLE_THREADS) {
     widgets::Button* create_new_server_button = new widgets::Button(this, "Create New Server", [this](wxMouseEvent& event) { this->CreateNewServer(event); });
     create_new_server_button->SetMinSize(wxSize(-1, 40));
     create_new_server_button->SetMaxSize(wxSize(-1, 40));
@@ -30,26 +31,14 @@ HostingPanel::HostingPanel(wxPanel* parent_panel) : wxPanel(parent_panel) {
     wxBoxSizer* manage_all_servers_sizer = new wxBoxSizer(wxHORIZONTAL);
 
     widgets::Button* start_all_servers_button = new widgets::Button(this, "Start All", [this](wxMouseEvent& event) {
-        for (auto &server : *this->GetHostedServers()) {
-            if (server.GetServerStatus() != objects::STOPPED) {
-                continue;
-            }
-
-            server.StartServer();
-        }
+        this->ChangeServers(*this->GetHostedServers(), objects::ServerLifecycle::START);
     });
     
     start_all_servers_button->SetMinSize(wxSize(-1, 40));
     start_all_servers_button->SetMaxSize(wxSize(-1, 40));
 
     widgets::Button* stop_all_servers_button = new widgets::Button(this, "Stop All", [this](wxMouseEvent& event) {
-        for (auto &server : *wxGetApp().GetHomeFrame()->GetHostingPanel()->GetHostedServers()) {
-            if (server.GetServerStatus() != objects::RUNNING) {
-                continue;
-            }
-
-            server.StopServer();
-        }
+        this->ChangeServers(*this->GetHostedServers(), objects::ServerLifecycle::STOP);
     });
     
     stop_all_servers_button->SetMinSize(wxSize(-1, 40));
@@ -58,8 +47,11 @@ HostingPanel::HostingPanel(wxPanel* parent_panel) : wxPanel(parent_panel) {
     manage_all_servers_sizer->Add(start_all_servers_button, 1, wxEXPAND);
     manage_all_servers_sizer->Add(stop_all_servers_button, 1, wxEXPAND);
 
+    this->lifecycle_status_text = new wxStaticText(this, wxID_ANY, "");
+
     main_sizer->Add(this->hosted_servers_panel, wxSizerFlags(0).Expand().Border(wxTOP | wxBOTTOM, 10));
     main_sizer->Add(manage_all_servers_sizer, wxSizerFlags(0).Expand().Border(wxBOTTOM, 10));
+    main_sizer->Add(this->lifecycle_status_text, wxSizerFlags(0).Border(wxBOTTOM, 10));
     main_sizer->Add(create_new_server_button, wxSizerFlags(0).Expand().Border(wxTOP | wxBOTTOM, 10));
 
     main_sizer_margin->AddStretchSpacer();
@@ -74,14 +66,78 @@ HostingPanel::HostingPanel(wxPanel* parent_panel) : wxPanel(parent_panel) {
     auto stored_hosted_servers = this->GetHostedServers();
 
     for (auto &server : *hosted_servers) {
-        stored_hosted_servers->emplace_back(server.server_id);
+        stored_hosted_servers->push_back(new objects::HostedServer(server.server_id, wxGetApp().GetDatabase()));
     }
 
     free(hosted_servers);
+
+    // Blocking HTTP, kept off the UI thread and done once instead of on every redraw
+    this->public_ip_thread = new std::thread([this]() {
+        const in_addr public_ip_address = utils::net::get_public_ip();
+
+        this->CallAfter([this, public_ip_address]() {
+            this->public_ip_address = public_ip_address;
+
+            this->DrawServers();
+        });
+    });
 }
 
 HostingPanel::~HostingPanel() {
+    this->public_ip_thread->join();
 
+    delete this->public_ip_thread;
+
+    this->lifecycle.Submit(*this->GetHostedServers(), objects::ServerLifecycle::STOP, nullptr, nullptr);
+    this->lifecycle.Wait();
+
+    for (auto server : *this->GetHostedServers()) {
+        delete server;
+    }
+}
+
+void HostingPanel::ChangeServers(const std::vector<objects::HostedServer*>& servers, const objects::ServerLifecycle::Action action) {
+    const uint32_t queued = this->lifecycle.Submit(servers, action, OnLifecycleProgress, this);
+
+    if (queued == 0) {
+        return;
+    }
+
+    this->failed_server_ids.clear();
+
+    this->lifecycle_status_text->SetLabel(wxString::Format(action == objects::ServerLifecycle::START ? "Starting %u servers" : "Stopping %u servers", queued));
+
+    // Shows the servers as starting or stopping
+    this->DrawServers();
+}
+
+void HostingPanel::OnLifecycleProgress(objects::HostedServer* server, const bool succeeded, const uint32_t done, const uint32_t total, void* const user) {
+    HostingPanel* const panel = static_cast<HostingPanel*>(user);
+
+    const uint16_t server_id = server->GetServerId();
+
+    panel->CallAfter([panel, server_id, succeeded, done, total]() {
+        if (!succeeded) {
+            panel->failed_server_ids.push_back(server_id);
+        }
+
+        wxString status = done == total ? wxString("") : wxString::Format("%u of %u servers done", done, total);
+
+        // Stays up once the batch is done, a server that failed to start shows the Start button again
+        if (!panel->failed_server_ids.empty()) {
+            wxString failed_ids;
+
+            for (auto failed_id : panel->failed_server_ids) {
+                failed_ids += wxString::Format(failed_ids.empty() ? "%u" : ", %u", failed_id);
+            }
+
+            status += wxString::Format(status.empty() ? "Failed to start server %s" : ", failed to start server %s", failed_ids);
+        }
+
+        panel->lifecycle_status_text->SetLabel(status);
+
+        panel->DrawServers();
+    });
 }
 
 void HostingPanel::DrawServers() {
@@ -91,18 +147,22 @@ void HostingPanel::DrawServers() {
 
     this->hosted_servers_panel->SetSizer(v_sizer);
 
-    in_addr public_ip_address = utils::net::get_public_ip();
+    for (auto server : *this->GetHostedServers()) {
+        uint16_t server_id = server->GetServerId();
+
+        std::string invitation_code = "Looking up public address...";
 
-    for (auto &server : *this->GetHostedServers()) {
-        uint16_t server_id = server.GetServerId();
+        if (this->public_ip_address.has_value()) {
+            const in_addr public_ip_address = this->public_ip_address.value();
 
-        std::vector<uint8_t> invitation_data;
-        invitation_data.resize(sizeof(public_ip_address) + sizeof(server_id));
+            std::vector<uint8_t> invitation_data;
+            invitation_data.resize(sizeof(public_ip_address) + sizeof(server_id));
 
-        memcpy(invitation_data.data(), &public_ip_address, sizeof(public_ip_address));
-        memcpy(invitation_data.data() + sizeof(public_ip_address), &server_id, sizeof(server_id));
+            memcpy(invitation_data.data(), &public_ip_address, sizeof(public_ip_address));
+            memcpy(invitation_data.data() + sizeof(public_ip_address), &server_id, sizeof(server_id));
 
-        std::string invitation_code = utils::crypto::base32_encode(invitation_data);
+            invitation_code = utils::crypto::base32_encode(invitation_data);
+        }
 
         std::string server_button_string = std::to_string(server_id) + "   " + invitation_code;
 
@@ -110,15 +170,36 @@ void HostingPanel::DrawServers() {
         server_panel->SetMinSize(wxSize(-1, 30));
         server_panel->SetMaxSize(wxSize(-1, 30));
 
-        widgets::Button* settings_server_button = new widgets::Button(server_panel, "Settings", [this, &server, server_id, public_ip_address](wxMouseEvent& event){ 
-            auto server_settings_frame = new frames::ServerSettingsFrame(server_id, public_ip_address.s_addr);
+        widgets::Button* settings_server_button = new widgets::Button(server_panel, "Settings", [this, server_id](wxMouseEvent& event){ 
+            if (!this->public_ip_address.has_value()) {
+                return;
+            }
+
+            auto server_settings_frame = new frames::ServerSettingsFrame(server_id, this->public_ip_address.value().s_addr);
 
             server_settings_frame->Show(true);
         });
         settings_server_button->SetMinSize(wxSize(-1, 30));
         settings_server_button->SetMaxSize(wxSize(-1, 30));
 
-        widgets::Button* start_server_button = new widgets::Button(server_panel, server.GetServerStatus() == objects::RUNNING ? "Stop" : "Start", [this, &server](wxMouseEvent& event){ server.GetServerStatus() == objects::RUNNING ? server.StopServer() : server.StartServer(); });
+        const char* start_server_label = "Start";
+
+        switch (server->GetServerStatus()) {
+            case objects::RUNNING: start_server_label = "Stop"; break;
+            case objects::STARTING: start_server_label = "Starting..."; break;
+            case objects::STOPPING: start_server_label = "Stopping..."; break;
+            default: break;
+        }
+
+        widgets::Button* start_server_button = new widgets::Button(server_panel, start_server_label, [this, server](wxMouseEvent& event){
+            const objects::HostedServerStatus status = server->GetServerStatus();
+
+            // A server already starting or stopping is claimed by its batch, Submit leaves it out
+            const objects::ServerLifecycle::Action action = status == objects::RUNNING ? objects::ServerLifecycle::STOP : objects::ServerLifecycle::START;
+
+            // Redraw after the handler returns, the button is destroyed by DrawServers
+            this->CallAfter([this, server, action]() { this->ChangeServers({server}, action); });
+        });
         start_server_button->SetMinSize(wxSize(-1, 30));
         start_server_button->SetMaxSize(wxSize(-1, 30));
 
@@ -150,19 +231,19 @@ void HostingPanel::CreateNewServer(wxMouseEvent&) {
 }
 
 void HostingPanel::InsertHostedServer(const uint16_t server_id) {
-    this->GetHostedServers()->push_back(objects::HostedServer(server_id));
+    this->GetHostedServers()->push_back(new objects::HostedServer(server_id, wxGetApp().GetDatabase()));
 }
 
 objects::HostedServer* HostingPanel::GetServerById(const uint16_t server_id) {
-    for (auto &server : *this->GetHostedServers()) {
-        if (server.GetServerId() == server_id) {
-            return &server;
+    for (auto server : *this->GetHostedServers()) {
+        if (server->GetServerId() == server_id) {
+            return server;
         }
     }
 
     return nullptr;
 }
 
-std::vector<objects::HostedServer>* HostingPanel::GetHostedServers() {
+std::vector<objects::HostedServer*>* HostingPanel::GetHostedServers() {
     return &this->hosted_servers;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <optional>
+#include <thread>
 #include <wx/timer.h>
 #include <wx/wx.h>
 #include "../../../objects/objects.hpp"
@@ -18,13 +20,27 @@ namespace frames::home_frame::panels {
 
         objects::HostedServer* GetServerById(const uint16_t server_id);
 
-        std::vector<objects::HostedServer>* GetHostedServers();
+        std::vector<objects::HostedServer*>* GetHostedServers();
     private:
         void CreateNewServer(wxMouseEvent&);
 
+        // Starts or stops the servers off the UI thread, the panel redraws as each one finishes
+        void ChangeServers(const std::vector<objects::HostedServer*>& servers, const objects::ServerLifecycle::Action action);
+        static void OnLifecycleProgress(objects::HostedServer* server, bool succeeded, uint32_t done, uint32_t total, void* user);
+
         wxPanel* hosted_servers_panel;
+        wxStaticText* lifecycle_status_text;
+
+        // Servers that failed to start since the last Start All or Stop All, only touched on the UI thread
+        std::vector<uint16_t> failed_server_ids;
+
+        std::vector<objects::HostedServer*> hosted_servers;
+
+        objects::ServerLifecycle lifecycle;
 
-        std::vector<objects::HostedServer> hosted_servers;
+        // Looked up once over HTTP when the panel opens, invitation codes wait for it
+        std::optional<in_addr> public_ip_address;
+        std::thread* public_ip_thread = nullptr;
     };
 
     class ServersPanel : public wxPanel {
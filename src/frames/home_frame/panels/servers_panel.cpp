@@ -20,7 +20,6 @@
 #include "../../../utils/net/net.hpp"
 #include "../../../widgets/widgets.hpp"
 #include "../../../utils/crypto/crypto.hpp"
-#include <swift_net.h>
 #include "../../../main.hpp"
 
 using frames::home_frame::panels::ServersPanel;
@@ -66,14 +65,14 @@ void ServersPanel::RefreshServerInfo() {
 
     for (auto &server : *joined_servers) {
         printf("Joined server: %s %d\n", inet_ntoa(server.ip_address), server.server_id);
-        SwiftNetClientConnection* const client = swiftnet_create_client(inet_ntoa(server.ip_address), server.server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
+        transport::ClientTransport* const client = transport::CreateClient(inet_ntoa(server.ip_address), server.server_id, DEFAULT_TIMEOUT_CLIENT_CREATION);
         if (client == nullptr) {
             stored_joined_servers->push_back(objects::JoinedServer(server.server_id, server.ip_address, objects::JoinedServer::ServerStatus::OFFLINE, false));
 
             continue;
         }
 
-        SwiftNetPacketBuffer buffer = swiftnet_client_create_packet_buffer(sizeof(requests::LoadJoinedServerDataRequest) + sizeof(RequestInfo));
+        transport::PooledPacketBuffer buffer(sizeof(requests::LoadJoinedServerDataRequest) + sizeof(RequestInfo));
 
         const RequestInfo request_info = {
             .request_type = RequestType::LOAD_JOINED_SERVER_DATA
@@ -82,30 +81,26 @@ void ServersPanel::RefreshServerInfo() {
         const requests::LoadJoinedServerDataRequest request = {
         };
 
-        swiftnet_client_append_to_packet(&request_info, sizeof(request_info), &buffer);
-        swiftnet_client_append_to_packet(&request, sizeof(request), &buffer);
+        buffer->Append(&request_info, sizeof(request_info));
+        buffer->Append(&request, sizeof(request));
 
-        SwiftNetClientPacketData* response = swiftnet_client_make_request(client, &buffer, DEFAULT_TIMEOUT_REQUEST);
+        transport::Packet* response = client->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
         if (response == nullptr) {
-            swiftnet_client_destroy_packet_buffer(&buffer);
-
             stored_joined_servers->push_back(objects::JoinedServer(server.server_id, server.ip_address, objects::JoinedServer::ServerStatus::OFFLINE, false));
 
             continue;
         }
 
-        swiftnet_client_destroy_packet_buffer(&buffer);
-
-        ResponseInfo* const response_info = (ResponseInfo*)swiftnet_client_read_packet(response, sizeof(ResponseInfo));
-        responses::LoadJoinedServerDataResponse* const server_data = (responses::LoadJoinedServerDataResponse*)swiftnet_client_read_packet(response, sizeof(responses::LoadJoinedServerDataResponse));
+        ResponseInfo* const response_info = (ResponseInfo*)response->Read(sizeof(ResponseInfo));
+        responses::LoadJoinedServerDataResponse* const server_data = (responses::LoadJoinedServerDataResponse*)response->Read(sizeof(responses::LoadJoinedServerDataResponse));
 
         std::cout << "Admin: " << server_data->admin << std::endl;
 
         stored_joined_servers->push_back(objects::JoinedServer(server.server_id, server.ip_address, objects::JoinedServer::ServerStatus::ONLINE, server_data->admin));
 
-        swiftnet_client_destroy_packet_data(response, client);
+        delete response;
 
-        swiftnet_client_cleanup(client);
+        delete client;
     }
 
     free(joined_servers);
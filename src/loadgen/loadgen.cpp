@@ -0,0 +1,664 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../objects/objects.hpp"
+#include "../protocol/protocol.hpp"
+#include "../transport/transport.hpp"
+#include "../utils/alloc/alloc.hpp"
+#include "../utils/log/log.hpp"
+#include "../utils/trace/trace.hpp"
+
+// Drives simulated chatters against one HostedServer over the loopback transport
+
+#define LOADGEN_TIMESTAMP_LENGTH 16
+
+// Allocations before this point fill the reused fan-out storage and are not steady state
+#define LOADGEN_ALLOCATION_WARMUP_MS 1000
+
+// Abusive clients send this many times the configured rate
+#define LOADGEN_ABUSIVE_RATE_MULTIPLIER 100
+
+// Messages a history reader asks for per page, always from the start of the channel
+#define LOADGEN_HISTORY_PAGE_SIZE 500
+// A refused reader waits this long before asking again, the way a client backs off
+#define LOADGEN_HISTORY_BACKOFF_MS 100
+
+struct LoadgenOptions {
+    uint32_t clients = 100;
+    uint32_t channels = 4;
+    double rate = 1.0;
+    uint32_t duration = 10;
+    uint32_t min_message_size = 32;
+    uint32_t max_message_size = 256;
+    uint32_t threads = 4;
+    uint32_t fanout_threads = 0;
+    uint32_t slow_clients = 0;
+    uint32_t abusive_clients = 0;
+    uint32_t history_readers = 0;
+    uint16_t server_id = 7000;
+    const char* database_path = ":memory:";
+    bool verbose = false;
+    bool server_stats = false;
+    const char* trace_path = nullptr;
+    bool assert_no_allocations = false;
+};
+
+struct LoadgenClient {
+    transport::ClientTransport* connection;
+    uint32_t channel_id;
+
+    // Slow clients never acknowledge, so the server holds their updates back and eventually resyncs them
+    bool acknowledges;
+};
+
+struct LoadgenStats {
+    std::atomic<uint64_t> sent = 0;
+    std::atomic<uint64_t> delivered = 0;
+    std::atomic<uint64_t> failed_joins = 0;
+    std::atomic<uint64_t> resyncs = 0;
+    std::atomic<uint64_t> rate_limited = 0;
+    std::atomic<uint64_t> history_pages = 0;
+    std::atomic<uint64_t> history_rejected = 0;
+
+    std::mutex latencies_mutex;
+    std::vector<uint64_t> latencies_ns;
+};
+
+static LoadgenStats stats;
+
+static uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void PrintUsage(const char* program) {
+    fprintf(stderr, "Usage: %s [--clients N] [--channels N] [--rate MSGS_PER_SEC_PER_CLIENT] [--duration SECONDS]\n", program);
+    fprintf(stderr, "          [--min-size BYTES] [--max-size BYTES] [--threads N] [--fanout-threads N] [--slow-clients N] [--abusive-clients N] [--history-readers N] [--server-id ID] [--database PATH] [--server-stats] [--trace PATH] [--verbose]\n");
+}
+
+static bool ParseOptions(int argc, char** argv, LoadgenOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--verbose") == 0) {
+            options->verbose = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--server-stats") == 0) {
+            options->server_stats = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--assert-no-allocations") == 0) {
+            options->assert_no_allocations = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        const char* value = argv[++i];
+
+        if (strcmp(arg, "--clients") == 0) {
+            options->clients = atoi(value);
+        } else if (strcmp(arg, "--channels") == 0) {
+            options->channels = atoi(value);
+        } else if (strcmp(arg, "--rate") == 0) {
+            options->rate = atof(value);
+        } else if (strcmp(arg, "--duration") == 0) {
+            options->duration = atoi(value);
+        } else if (strcmp(arg, "--min-size") == 0) {
+            options->min_message_size = atoi(value);
+        } else if (strcmp(arg, "--max-size") == 0) {
+            options->max_message_size = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options->threads = atoi(value);
+        } else if (strcmp(arg, "--fanout-threads") == 0) {
+            options->fanout_threads = atoi(value);
+        } else if (strcmp(arg, "--slow-clients") == 0) {
+            options->slow_clients = atoi(value);
+        } else if (strcmp(arg, "--abusive-clients") == 0) {
+            options->abusive_clients = atoi(value);
+        } else if (strcmp(arg, "--history-readers") == 0) {
+            options->history_readers = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--server-id") == 0) {
+            options->server_id = atoi(value);
+        } else if (strcmp(arg, "--database") == 0) {
+            options->database_path = value;
+        } else if (strcmp(arg, "--trace") == 0) {
+            options->trace_path = value;
+        } else {
+            return false;
+        }
+    }
+
+    // The body carries the send timestamp, a separator and the terminator
+    options->min_message_size = std::max<uint32_t>(options->min_message_size, LOADGEN_TIMESTAMP_LENGTH + 2);
+    options->max_message_size = std::max(options->max_message_size, options->min_message_size);
+
+    return options->clients > 0 && options->channels > 0 && options->rate > 0 && options->threads > 0;
+}
+
+// Runs on the loopback dispatch thread for every fan-out packet a client receives
+static void ClientPacketHandler(transport::Packet* const packet, void* const user) {
+    const uint64_t received_at = NowNs();
+
+    LoadgenClient* const client = static_cast<LoadgenClient*>(user);
+
+    const ResponseInfo* const response_info = (ResponseInfo*)packet->Read(sizeof(ResponseInfo));
+    if (response_info != nullptr && response_info->request_status == Status::RATE_LIMITED) {
+        stats.rate_limited.fetch_add(1, std::memory_order_relaxed);
+
+        delete packet;
+        return;
+    }
+
+    if (response_info == nullptr || response_info->request_type != RequestType::PERIODIC_CHAT_UPDATE) {
+        delete packet;
+        return;
+    }
+
+    // A resync only stops the updates, the simulated client does not reload
+    if (response_info->request_status != Status::SUCCESS) {
+        stats.resyncs.fetch_add(1, std::memory_order_relaxed);
+
+        delete packet;
+        return;
+    }
+
+    const responses::PeriodicChatUpdateResponse* const response = (responses::PeriodicChatUpdateResponse*)packet->Read(sizeof(responses::PeriodicChatUpdateResponse));
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(response->channel_messages_len);
+
+    for (uint32_t i = 0; i < response->channel_messages_len; i++) {
+        packet->Read(sizeof(uint32_t));
+        packet->Read(sizeof(uint32_t));
+
+        const uint32_t* const message_length = (uint32_t*)packet->Read(sizeof(uint32_t));
+        const char* const message = (const char*)packet->Read(*message_length);
+
+        if (message == nullptr) {
+            break;
+        }
+
+        const uint64_t sent_at = strtoull(std::string(message, LOADGEN_TIMESTAMP_LENGTH).c_str(), nullptr, 16);
+
+        latencies.push_back(received_at - sent_at);
+    }
+
+    delete packet;
+
+    if (client->acknowledges) {
+        const RequestInfo request_info = {
+            .request_type = RequestType::ACKNOWLEDGE_CHAT_UPDATE
+        };
+
+        const requests::AcknowledgeChatUpdateRequest request_data = {
+            .channel_id = client->channel_id
+        };
+
+        transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+
+        buffer->Append(&request_info, sizeof(request_info));
+        buffer->Append(&request_data, sizeof(request_data));
+
+        client->connection->SendPacket(buffer.Get());
+    }
+
+    stats.delivered.fetch_add(latencies.size(), std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(stats.latencies_mutex);
+
+    stats.latencies_ns.insert(stats.latencies_ns.end(), latencies.begin(), latencies.end());
+}
+
+static bool JoinServer(LoadgenClient* client, const uint32_t client_index) {
+    const RequestInfo request_info = {
+        .request_type = RequestType::JOIN_SERVER
+    };
+
+    requests::JoinServerRequest request_data = {};
+    snprintf(request_data.username, sizeof(request_data.username), "loadgen-%u", client_index);
+
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
+
+    transport::Packet* const response = client->connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
+    if (response == nullptr) {
+        return false;
+    }
+
+    const ResponseInfo* const response_info = (ResponseInfo*)response->Read(sizeof(ResponseInfo));
+    const bool joined = response_info != nullptr && response_info->request_status == Status::SUCCESS;
+
+    delete response;
+
+    return joined;
+}
+
+static bool OpenChannel(LoadgenClient* client) {
+    const RequestInfo request_info = {
+        .request_type = RequestType::LOAD_CHANNEL_DATA
+    };
+
+    const requests::LoadChannelDataRequest request_data = {
+        .channel_id = client->channel_id,
+        .after_message_id = 0,
+        .limit = 1,
+        .subscribe = true,
+        .newest = false
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
+
+    transport::Packet* const response = client->connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
+    if (response == nullptr) {
+        return false;
+    }
+
+    delete response;
+
+    return true;
+}
+
+// Keeps paging through the channel's history back to back, the bulk load a client scrolling far back puts on the server
+static void RunHistoryReader(LoadgenClient* client, const std::chrono::steady_clock::time_point end) {
+    const RequestInfo request_info = {
+        .request_type = RequestType::LOAD_CHANNEL_DATA
+    };
+
+    const requests::LoadChannelDataRequest request_data = {
+        .channel_id = client->channel_id,
+        .after_message_id = 0,
+        .limit = LOADGEN_HISTORY_PAGE_SIZE,
+        .subscribe = false,
+        .newest = false
+    };
+
+    while (std::chrono::steady_clock::now() < end) {
+        transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data));
+
+        buffer->Append(&request_info, sizeof(request_info));
+        buffer->Append(&request_data, sizeof(request_data));
+
+        transport::Packet* const response = client->connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
+        if (response == nullptr) {
+            continue;
+        }
+
+        const ResponseInfo* const response_info = (ResponseInfo*)response->Read(sizeof(ResponseInfo));
+
+        if (response_info != nullptr && response_info->request_status == Status::SUCCESS) {
+            stats.history_pages.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            stats.history_rejected.fetch_add(1, std::memory_order_relaxed);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOADGEN_HISTORY_BACKOFF_MS));
+        }
+
+        delete response;
+    }
+}
+
+// Asks the server for its metrics snapshot over the same protocol a monitoring client would use
+static void PrintServerStats(LoadgenClient* client, FILE* report) {
+    const RequestInfo request_info = {
+        .request_type = RequestType::LOAD_SERVER_STATS
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(request_info));
+
+    buffer->Append(&request_info, sizeof(request_info));
+
+    transport::Packet* const response = client->connection->MakeRequest(buffer.Get(), DEFAULT_TIMEOUT_REQUEST);
+    if (response == nullptr) {
+        fprintf(report, "Server stats request timed out\n");
+        return;
+    }
+
+    const ResponseInfo* const response_info = (ResponseInfo*)response->Read(sizeof(ResponseInfo));
+    const responses::LoadServerStatsResponse* const response_data = (responses::LoadServerStatsResponse*)response->Read(sizeof(responses::LoadServerStatsResponse));
+
+    const char* const snapshot = response_data != nullptr ? (const char*)response->Read(response_data->snapshot_len) : nullptr;
+
+    if (response_info == nullptr || response_info->request_status != Status::SUCCESS || snapshot == nullptr) {
+        fprintf(report, "Server refused the stats request\n");
+    } else {
+        fprintf(report, "\nserver stats\n%s", snapshot);
+    }
+
+    delete response;
+}
+
+static void SendMessage(LoadgenClient* client, std::vector<char>& message, const uint32_t message_len) {
+    char timestamp[LOADGEN_TIMESTAMP_LENGTH + 1];
+    snprintf(timestamp, sizeof(timestamp), "%016" PRIx64, NowNs());
+
+    memcpy(message.data(), timestamp, LOADGEN_TIMESTAMP_LENGTH);
+    message[LOADGEN_TIMESTAMP_LENGTH] = ':';
+    memset(message.data() + LOADGEN_TIMESTAMP_LENGTH + 1, 'x', message_len - LOADGEN_TIMESTAMP_LENGTH - 2);
+    message[message_len - 1] = '\0';
+
+    const RequestInfo request_info = {
+        .request_type = RequestType::SEND_MESSAGE
+    };
+
+    const requests::SendMessageRequest request_data = {
+        .message_len = message_len,
+        .channel_id = client->channel_id
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(request_info) + sizeof(request_data) + message_len);
+
+    buffer->Append(&request_info, sizeof(request_info));
+    buffer->Append(&request_data, sizeof(request_data));
+    buffer->Append(message.data(), message_len);
+
+    client->connection->SendPacket(buffer.Get());
+
+    stats.sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Each sender thread owns a slice of the clients and paces every one of them at the configured rate
+static void RunSender(std::vector<LoadgenClient>* clients, const uint32_t first, const uint32_t last, const LoadgenOptions* options, const std::chrono::steady_clock::time_point end) {
+    std::mt19937 random(first);
+    std::uniform_int_distribution<uint32_t> message_size(options->min_message_size, options->max_message_size);
+    std::uniform_real_distribution<double> start_offset(0.0, 1.0);
+
+    const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options->rate));
+    const auto abusive_interval = interval / LOADGEN_ABUSIVE_RATE_MULTIPLIER;
+
+    std::vector<char> message(options->max_message_size);
+
+    // Spread the first sends over one interval so clients don't fire in lockstep
+    std::vector<std::chrono::steady_clock::time_point> next_send;
+
+    const auto now = std::chrono::steady_clock::now();
+
+    for (uint32_t i = first; i < last; i++) {
+        next_send.push_back(now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval * start_offset(random)));
+    }
+
+    while (true) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= end) {
+            return;
+        }
+
+        auto earliest = end;
+
+        for (uint32_t i = first; i < last; i++) {
+            auto& client_next_send = next_send[i - first];
+
+            if (client_next_send <= now) {
+                SendMessage(&clients->at(i), message, message_size(random));
+
+                // The first clients after the slow ones are the abusive ones
+                const bool abusive = i >= options->slow_clients && i < options->slow_clients + options->abusive_clients;
+
+                client_next_send += abusive ? abusive_interval : interval;
+            }
+
+            earliest = std::min(earliest, client_next_send);
+        }
+
+        std::this_thread::sleep_until(earliest);
+    }
+}
+
+static double Percentile(const std::vector<uint64_t>& sorted, const double percentile) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(percentile * sorted.size()));
+
+    return sorted[index] / 1e6;
+}
+
+static long GetPeakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static double GetCpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+int main(int argc, char** argv) {
+    LoadgenOptions options;
+
+    if (!ParseOptions(argc, argv, &options)) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Stray prints of the shared code stay out of the report, --verbose also turns on debug logging
+    FILE* report = fdopen(dup(STDOUT_FILENO), "w");
+
+    utils::log::ConfigureFromEnvironment();
+
+    if (options.verbose) {
+        utils::log::SetAllLevels(utils::log::LEVEL_DEBUG);
+    } else {
+        freopen("/dev/null", "w", stdout);
+    }
+
+    transport::SetDefaultBackend(transport::LOOPBACK_BACKEND);
+    transport::Initialize();
+
+    objects::Database* database = new objects::Database(options.database_path);
+
+    database->InsertHostedServer(options.server_id);
+
+    for (uint32_t i = 0; i < options.channels; i++) {
+        char name[20];
+        snprintf(name, sizeof(name), "loadgen-%u", i);
+
+        database->InsertServerChatChannel(name, options.server_id);
+    }
+
+    auto channels = database->SelectServerChatChannels(std::nullopt, nullptr, options.server_id);
+
+    // Zero keeps the server default of one sender per core
+    if (options.fanout_threads > 0) {
+        objects::HostedServer::SetFanoutThreads(options.fanout_threads);
+    }
+
+    objects::HostedServer* server = new objects::HostedServer(options.server_id, database);
+
+    if (!server->StartServer()) {
+        fprintf(report, "Failed to start server %u\n", options.server_id);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<LoadgenClient> clients;
+    clients.reserve(options.clients);
+
+    for (uint32_t i = 0; i < options.clients; i++) {
+        LoadgenClient client = {
+            .connection = transport::CreateClient("127.0.0.1", options.server_id, DEFAULT_TIMEOUT_CLIENT_CREATION),
+            .channel_id = channels->at(i % channels->size()).id,
+            .acknowledges = i >= options.slow_clients
+        };
+
+        if (client.connection == nullptr || !JoinServer(&client, i) || !OpenChannel(&client)) {
+            stats.failed_joins.fetch_add(1, std::memory_order_relaxed);
+
+            delete client.connection;
+            continue;
+        }
+
+        // Reserved up front, so the element stays where the handler was pointed
+        clients.push_back(client);
+
+        clients.back().connection->SetMessageHandler(ClientPacketHandler, &clients.back());
+    }
+
+    std::vector<LoadgenClient> history_readers;
+    history_readers.reserve(options.history_readers);
+
+    for (uint32_t i = 0; i < options.history_readers; i++) {
+        LoadgenClient reader = {
+            .connection = transport::CreateClient("127.0.0.1", options.server_id, DEFAULT_TIMEOUT_CLIENT_CREATION),
+            .channel_id = channels->at(i % channels->size()).id,
+            .acknowledges = false
+        };
+
+        if (reader.connection == nullptr || !JoinServer(&reader, options.clients + i)) {
+            stats.failed_joins.fetch_add(1, std::memory_order_relaxed);
+
+            delete reader.connection;
+            continue;
+        }
+
+        history_readers.push_back(reader);
+    }
+
+    delete channels;
+
+    if (clients.empty()) {
+        fprintf(report, "No client could join the server\n");
+        return EXIT_FAILURE;
+    }
+
+    // Only the measured phase is traced, setup would fill the rings with joins
+    utils::trace::SetEnabled(options.trace_path != nullptr);
+
+    const double cpu_start = GetCpuSeconds();
+    const auto start = std::chrono::steady_clock::now();
+    const auto end = start + std::chrono::seconds(options.duration);
+
+    std::vector<std::thread> senders;
+
+    const uint32_t threads = std::min<uint32_t>(options.threads, clients.size());
+    const uint32_t clients_per_thread = (clients.size() + threads - 1) / threads;
+
+    for (uint32_t i = 0; i < threads; i++) {
+        const uint32_t first = i * clients_per_thread;
+        const uint32_t last = std::min<uint32_t>(first + clients_per_thread, clients.size());
+
+        senders.emplace_back(RunSender, &clients, first, last, &options, end);
+    }
+
+    for (auto& reader : history_readers) {
+        senders.emplace_back(RunHistoryReader, &reader, end);
+    }
+
+    // The steady state window starts after the warm-up and ends once the last tick went out
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::min<uint64_t>(LOADGEN_ALLOCATION_WARMUP_MS, options.duration * 500)));
+
+    utils::alloc::AllocationStats allocations_start[utils::alloc::SUBSYSTEMS_LEN];
+
+    for (uint32_t i = 0; i < utils::alloc::SUBSYSTEMS_LEN; i++) {
+        allocations_start[i] = utils::alloc::GetStats(static_cast<utils::alloc::Subsystem>(i));
+    }
+
+    for (auto& sender : senders) {
+        sender.join();
+    }
+
+    const double send_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Let the last fan-out ticks go out before measuring
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double cpu_seconds = GetCpuSeconds() - cpu_start;
+
+    uint64_t steady_allocations[utils::alloc::SUBSYSTEMS_LEN];
+
+    for (uint32_t i = 0; i < utils::alloc::SUBSYSTEMS_LEN; i++) {
+        steady_allocations[i] = utils::alloc::GetStats(static_cast<utils::alloc::Subsystem>(i)).allocations - allocations_start[i].allocations;
+    }
+
+    // Transport and client code is outside the server message path
+    const bool allocation_free = steady_allocations[utils::alloc::SERVER] == 0 && steady_allocations[utils::alloc::DATABASE] == 0;
+
+    if (options.trace_path != nullptr) {
+        utils::trace::SetEnabled(false);
+
+        utils::trace::DumpChromeTrace(options.trace_path);
+    }
+
+    std::vector<uint64_t> latencies;
+
+    {
+        std::lock_guard<std::mutex> lock(stats.latencies_mutex);
+        latencies.swap(stats.latencies_ns);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    fprintf(report, "clients            %zu joined, %" PRIu64 " failed\n", clients.size(), stats.failed_joins.load());
+    fprintf(report, "channels           %u\n", options.channels);
+    fprintf(report, "duration           %.2f s sending, %.2f s total\n", send_elapsed, elapsed);
+    fprintf(report, "sent               %" PRIu64 " (%.1f msgs/s)\n", stats.sent.load(), stats.sent.load() / send_elapsed);
+    fprintf(report, "delivered          %" PRIu64 " (%.1f msgs/s)\n", stats.delivered.load(), stats.delivered.load() / elapsed);
+    fprintf(report, "resyncs            %" PRIu64 "\n", stats.resyncs.load());
+    fprintf(report, "rate limited       %" PRIu64 "\n", stats.rate_limited.load());
+    fprintf(report, "history pages      %" PRIu64 " loaded, %" PRIu64 " refused\n", stats.history_pages.load(), stats.history_rejected.load());
+    fprintf(report, "latency p50        %.3f ms\n", Percentile(latencies, 0.50));
+    fprintf(report, "latency p99        %.3f ms\n", Percentile(latencies, 0.99));
+    fprintf(report, "latency p999       %.3f ms\n", Percentile(latencies, 0.999));
+    fprintf(report, "latency max        %.3f ms\n", latencies.empty() ? 0 : latencies.back() / 1e6);
+    // Clients run in the same process, so CPU and RSS include them
+    fprintf(report, "process cpu        %.2f s (%.1f%% of one core)\n", cpu_seconds, cpu_seconds / elapsed * 100);
+    fprintf(report, "peak rss           %ld KB\n", GetPeakRssKb());
+    fprintf(report, "steady allocations server %" PRIu64 ", database %" PRIu64 ", transport %" PRIu64 "\n", steady_allocations[utils::alloc::SERVER], steady_allocations[utils::alloc::DATABASE], steady_allocations[utils::alloc::TRANSPORT]);
+
+    if (options.assert_no_allocations && !allocation_free) {
+        fprintf(report, "FAILED: the server message path allocated in steady state\n");
+    }
+
+    if (options.server_stats) {
+        PrintServerStats(&clients.front(), report);
+    }
+
+    fclose(report);
+
+    for (auto& client : clients) {
+        delete client.connection;
+    }
+
+    for (auto& reader : history_readers) {
+        delete reader.connection;
+    }
+
+    server->StopServer();
+
+    delete server;
+    delete database;
+
+    transport::Cleanup();
+
+    return options.assert_no_allocations && !allocation_free ? EXIT_FAILURE : EXIT_SUCCESS;
+}
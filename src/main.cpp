@@ -5,6 +5,9 @@
 #include "frames/frames.hpp"
 #include "objects/objects.hpp"
 #include "swift_net.h"
+#include "transport/transport.hpp"
+#include "utils/log/log.hpp"
+#include "utils/trace/trace.hpp"
 #include "main.hpp"
 
 wxDEFINE_EVENT(wxEVT_CHAT_UPDATE, wxCommandEvent);
@@ -22,13 +25,26 @@ Application::~Application() {
         delete database;
     }
 
-    swiftnet_cleanup();
+    // Tracing is on only when SWIFTCOM_TRACE names the output file
+    const char* trace_path = getenv("SWIFTCOM_TRACE");
+    if (trace_path != nullptr) {
+        utils::trace::DumpChromeTrace(trace_path);
+    }
+
+    transport::Cleanup();
 }
 
 bool Application::OnInit() {
-    swiftnet_initialize();
+    transport::Initialize();
+
+    utils::trace::SetEnabled(getenv("SWIFTCOM_TRACE") != nullptr);
 
-    swiftnet_add_debug_flags(DEBUG_INITIALIZATION | DEBUG_LOST_PACKETS | DEBUG_PACKETS_RECEIVING | DEBUG_PACKETS_SENDING);
+    utils::log::ConfigureFromEnvironment();
+
+    // SwiftNet prints every packet with these on, so they are opt in
+    if (getenv("SWIFTCOM_SWIFTNET_DEBUG") != nullptr) {
+        swiftnet_add_debug_flags(DEBUG_INITIALIZATION | DEBUG_LOST_PACKETS | DEBUG_PACKETS_RECEIVING | DEBUG_PACKETS_SENDING);
+    }
 
     srand(time(0));
 
@@ -5,101 +5,26 @@
 #include <sqlite3.h>
 #include "objects/objects.hpp"
 #include "frames/frames.hpp"
+#include "protocol/protocol.hpp"
 #include <swift_net.h>
 
-#define DEFAULT_TIMEOUT_CLIENT_CREATION 500
-#define DEFAULT_TIMEOUT_REQUEST 200
-#define LOOPBACK false
+#define CHAT_UPDATE_FRAME_INTERVAL 16
+#define MAX_PREFETCH_PAGES 4
 
-wxDECLARE_EVENT(wxEVT_CHAT_UPDATE, wxCommandEvent);
-
-#define EVT_CHAT_UPDATE(id, fn) wx__DECLARE_EVT1(wxEVT_CHAT_UPDATE, id, &fn)
-
-// Request Types
-
-enum Status {
-    SUCCESS,
-    FAIL
-};
-
-enum RequestType {
-    JOIN_SERVER,
-    LOAD_SERVER_INFORMATION,
-    LOAD_CHANNEL_DATA,
-    SEND_MESSAGE,
-    LOAD_JOINED_SERVER_DATA,
-    LOAD_ADMIN_MENU_DATA,
-    CREATE_NEW_CHANNEL,
-    PERIODIC_CHAT_UPDATE,
-    CLIENT_ONLINE_CHECK
-};
-
-struct RequestInfo {
-    enum RequestType request_type;
-};
-
-struct ResponseInfo {
-    enum RequestType request_type;
-    enum Status request_status;
-};
-
-// Requests
+// Half the server's per sender rate for expensive requests, so prefetching leaves the open panels their loads
+#define PREFETCH_REQUEST_INTERVAL 200
 
-namespace requests {
-    struct LoadChannelDataRequest {
-        uint32_t channel_id;
-    };
+// A rate limited channel load is tried again after the delay, which doubles up to the maximum
+#define CHANNEL_LOAD_RETRY_MIN_DELAY 250
+#define CHANNEL_LOAD_RETRY_MAX_DELAY 8000
 
-    struct SendMessageRequest {
-        uint32_t message_len;
-        uint32_t channel_id;
-    };
+// A chat panel drops its oldest messages past the maximum, they stay in the local cache
+#define CHANNEL_HISTORY_MAX_MESSAGES 20000
+#define CHANNEL_HISTORY_TRIMMED_MESSAGES 15000
 
-    struct JoinServerRequest {
-        char username[20];
-    };
-
-    struct LoadJoinedServerDataRequest {
-    };
-
-    struct LoadAdminMenuDataRequest {
-    };
-
-    struct CreateNewChannelRequest {
-        char name[20];
-    };
-}
-
-// Responses
-
-namespace responses {
-    struct JoinServerResponse {
-    };
-
-    struct LoadServerInformationResponse {
-        uint32_t server_chat_channels_size;
-    };
-
-    struct LoadChannelDataResponse {
-        uint32_t channel_messages_len;
-    };
-
-    struct LoadJoinedServerDataResponse {
-        bool admin;
-    };
-
-    struct LoadAdminMenuDataResponse {
-        uint32_t channels_size;
-    };
-
-    struct CreateNewChannelResponse {
-
-    };
+wxDECLARE_EVENT(wxEVT_CHAT_UPDATE, wxCommandEvent);
 
-    struct PeriodicChatUpdateResponse {
-        uint32_t channel_messages_len;
-    };
-}
+#define EVT_CHAT_UPDATE(id, fn) wx__DECLARE_EVT1(wxEVT_CHAT_UPDATE, id, &fn)
 
 class Application : public wxApp
 {
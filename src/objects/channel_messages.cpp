@@ -0,0 +1,90 @@
+#include "objects.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "../transport/transport.hpp"
+#include "../utils/log/log.hpp"
+
+using namespace objects;
+
+void ChannelMessageBatch::Add(const Database::ChannelMessageRow& row) {
+    Database::ChannelMessageRow& stored = this->rows.emplace_back(row);
+
+    stored.message = std::string_view(this->text.CopyString(row.message.data(), row.message.size()), row.message.size());
+}
+
+void ChannelMessageBatch::Insert(const size_t index, const Database::ChannelMessageRow& row) {
+    Database::ChannelMessageRow& stored = *this->rows.insert(this->rows.begin() + index, row);
+
+    stored.message = std::string_view(this->text.CopyString(row.message.data(), row.message.size()), row.message.size());
+}
+
+void ChannelMessageBatch::Clear() {
+    this->rows.clear();
+    this->text.Reset();
+}
+
+void ChannelMessageBatch::KeepLast(const size_t rows_len) {
+    if (rows_len >= this->rows.size()) {
+        return;
+    }
+
+    ChannelMessageBatch kept;
+    kept.rows.reserve(rows_len);
+
+    for (size_t i = this->rows.size() - rows_len; i < this->rows.size(); i++) {
+        kept.Add(this->rows[i]);
+    }
+
+    std::swap(*this, kept);
+}
+
+void objects::SerializeChannelMessages(transport::PacketBuffer* buffer, const Database::ChannelMessageRow* messages, const size_t messages_len) {
+    for (size_t i = 0; i < messages_len; i++) {
+        const Database::ChannelMessageRow& message = messages[i];
+        const uint32_t new_message_len = message.message.size() + 1;
+
+        buffer->Append(&message.id, sizeof(message.id));
+        buffer->Append(&message.sender_id, sizeof(message.sender_id));
+        buffer->Append(&new_message_len, sizeof(new_message_len));
+        // The terminator right past the view goes out with the text
+        buffer->Append(message.message.data(), new_message_len);
+
+        LOG_TRACE(SERVER, "Serializing message: %s", message.message.data());
+    }
+}
+
+uint32_t objects::GetSerializedChannelMessageSize(const Database::ChannelMessageRow& message) {
+    return sizeof(message.id) + sizeof(message.sender_id) + sizeof(uint32_t) + message.message.size() + 1;
+}
+
+bool objects::DeserializeChannelMessages(transport::Packet* packet_data, const uint32_t channel_messages_len, ChannelMessageBatch* messages) {
+    messages->rows.reserve(messages->rows.size() + channel_messages_len);
+
+    for (uint32_t i = 0; i < channel_messages_len; i++) {
+        const uint32_t* const message_id = (uint32_t*)packet_data->Read(sizeof(uint32_t));
+        const uint32_t* const sender_id = (uint32_t*)packet_data->Read(sizeof(uint32_t));
+        const uint32_t* const message_length = (uint32_t*)packet_data->Read(sizeof(uint32_t));
+        if (message_id == nullptr || sender_id == nullptr || message_length == nullptr || *message_length == 0) {
+            return false;
+        }
+
+        const char* const message = (const char*)packet_data->Read(*message_length);
+        if (message == nullptr) {
+            return false;
+        }
+
+        // Copied into the batch's arena, so the view stays valid after the packet is gone
+        messages->Add((Database::ChannelMessageRow){
+            .id = *message_id,
+            .message = std::string_view(message, strnlen(message, *message_length)),
+            .sender_id = *sender_id
+        });
+
+        LOG_TRACE(CLIENT, "Received message: %s", messages->rows.back().message.data());
+    }
+
+    return true;
+}
@@ -2,17 +2,29 @@
 #include <cstdio>
 #include <cstring>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <sqlite3.h>
 #include <cstdint>
 #include <cstdlib>
+#include <ctime>
+#include <mutex>
 #include <iostream>
 #include <unordered_map>
 #include <vector>
+#include "../utils/alloc/alloc.hpp"
+#include "../utils/log/log.hpp"
+#include "../utils/metrics/metrics.hpp"
+#include "../utils/trace/trace.hpp"
 
 using namespace objects;
 
-Database::Database() {
-    this->OpenDatabase();
+Database::Database() : Database("swift_com") {
+
+}
+
+Database::Database(const char* path) {
+    this->OpenDatabase(path);
 
     this->InitializeDatabaseTables();
     
@@ -20,6 +32,12 @@ Database::Database() {
 }
 
 Database::~Database() {
+    sqlite3_trace_v2(this->database_connection, 0, nullptr, nullptr);
+
+    if (this->slow_query_log != nullptr) {
+        fclose(this->slow_query_log);
+    }
+
     for (const auto &statement : this->statements) {
         sqlite3_finalize(statement.second);
     }
@@ -27,16 +45,116 @@ Database::~Database() {
     sqlite3_close_v2(this->database_connection);
 }
 
-void Database::OpenDatabase() {
+static Database::StatementProfile CreateStatementProfile(const char* statement_name) {
+    const std::string prefix = std::string("db.") + statement_name;
+
+    return (Database::StatementProfile){
+        .statement_name = statement_name,
+        .duration = utils::metrics::RegisterHistogram(prefix.c_str(), utils::metrics::NANOSECONDS),
+        .rows = utils::metrics::RegisterCounter((prefix + ".rows").c_str()),
+        .vm_steps = utils::metrics::RegisterCounter((prefix + ".vm_steps").c_str()),
+        .fullscan_steps = utils::metrics::RegisterCounter((prefix + ".fullscan_steps").c_str()),
+        .sorts = utils::metrics::RegisterCounter((prefix + ".sorts").c_str()),
+        .autoindexes = utils::metrics::RegisterCounter((prefix + ".autoindexes").c_str()),
+        .start_ns = 0
+    };
+}
+
+// Runs inside sqlite3_step while the connection is held, so events of one connection never race each other
+static int HandleTraceEvent(unsigned type, void* context, void* p, void* x) {
+    Database* database = static_cast<Database*>(context);
+
+    if (type == SQLITE_TRACE_STMT) {
+        database->RecordStatementStart(static_cast<sqlite3_stmt*>(p));
+    } else if (type == SQLITE_TRACE_PROFILE) {
+        database->RecordStatementProfile(static_cast<sqlite3_stmt*>(p), *static_cast<int64_t*>(x));
+    } else if (type == SQLITE_TRACE_ROW) {
+        database->RecordStatementRow(static_cast<sqlite3_stmt*>(p));
+    }
+
+    return 0;
+}
+
+void Database::OpenDatabase(const char* path) {
     sqlite3* database_ptr;
 
-    int result = sqlite3_open("swift_com", &database_ptr);
+    int result = sqlite3_open(path, &database_ptr);
     if (result != SQLITE_OK) {
         std::cerr << "Failed to open database: " << sqlite3_errmsg(database_ptr) << std::endl;
         exit(EXIT_FAILURE);
     }
 
     this->database_connection = database_ptr;
+
+    this->unregistered_profile = CreateStatementProfile("unregistered");
+
+    sqlite3_trace_v2(database_ptr, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, HandleTraceEvent, this);
+}
+
+void Database::SetSlowQueryLog(const uint32_t threshold_ms, const char* path) {
+    this->slow_query_threshold_ns = threshold_ms * 1000000ULL;
+
+    if (path == nullptr) {
+        return;
+    }
+
+    FILE* file = fopen(path, "a");
+    if (file == nullptr) {
+        LOG_ERROR(DATABASE, "Failed to open slow query log %s", path);
+        return;
+    }
+
+    if (this->slow_query_log != nullptr) {
+        fclose(this->slow_query_log);
+    }
+
+    this->slow_query_log = file;
+}
+
+Database::StatementProfile& Database::GetStatementProfile(sqlite3_stmt* stmt) {
+    const auto profile = this->statement_profiles.find(stmt);
+
+    return profile != this->statement_profiles.end() ? profile->second : this->unregistered_profile;
+}
+
+void Database::RecordStatementStart(sqlite3_stmt* stmt) {
+    this->GetStatementProfile(stmt).start_ns = utils::trace::GetTimestampNs();
+}
+
+void Database::RecordStatementProfile(sqlite3_stmt* stmt, const uint64_t sqlite_duration_ns) {
+    StatementProfile& profile = this->GetStatementProfile(stmt);
+
+    const uint64_t duration_ns = profile.start_ns != 0 ? utils::trace::GetTimestampNs() - profile.start_ns : sqlite_duration_ns;
+
+    profile.start_ns = 0;
+
+    utils::metrics::RecordValue(profile.duration, duration_ns);
+
+    // Reset on read, so each run adds only its own work
+    utils::metrics::IncrementCounter(profile.vm_steps, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1));
+    utils::metrics::IncrementCounter(profile.fullscan_steps, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1));
+    utils::metrics::IncrementCounter(profile.sorts, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1));
+    utils::metrics::IncrementCounter(profile.autoindexes, sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1));
+
+    if (duration_ns < this->slow_query_threshold_ns) {
+        return;
+    }
+
+    char* expanded_sql = sqlite3_expanded_sql(stmt);
+    const char* sql = expanded_sql != nullptr ? expanded_sql : sqlite3_sql(stmt);
+
+    if (this->slow_query_log != nullptr) {
+        fprintf(this->slow_query_log, "%llu %.3f ms %s: %s\n", (unsigned long long)time(nullptr), duration_ns / 1000000.0, profile.statement_name, sql);
+        fflush(this->slow_query_log);
+    } else {
+        LOG_WARN(DATABASE, "Slow query %s took %.3f ms: %s", profile.statement_name, duration_ns / 1000000.0, sql);
+    }
+
+    sqlite3_free(expanded_sql);
+}
+
+void Database::RecordStatementRow(sqlite3_stmt* stmt) {
+    utils::metrics::IncrementCounter(this->GetStatementProfile(stmt).rows);
 }
 
 void Database::PrepareStatements() {
@@ -45,13 +163,17 @@ void Database::PrepareStatements() {
         (Statement){.statement_name = "insert_joined_server", .query = "INSERT INTO joined_servers (ip_address, server_id) VALUES ($1, $2);"},
         (Statement){.statement_name = "insert_hosted_server", .query = "INSERT INTO hosted_servers (id) VALUES ($1);"},
         (Statement){.statement_name = "insert_server_chat_channel", .query = "INSERT INTO server_chat_channels (name, hosted_server_id) VALUES ($1, $2);"},
-        (Statement){.statement_name = "insert_channel_message", .query = "INSERT INTO channel_messages (message, channel_id, sender_id) VALUES ($1, $2, $3) RETURNING channel_messages.id, (SELECT username FROM hosted_server_users WHERE id = channel_messages.sender_id) AS sender_username;"},
+        (Statement){.statement_name = "insert_channel_message", .query = "INSERT INTO channel_messages (message, channel_id, sender_id) VALUES ($1, $2, $3) RETURNING id;"},
         (Statement){.statement_name = "update_hosted_server_users", .query = "UPDATE hosted_server_users SET username = COALESCE($1, username), user_type = COALESCE($2, user_type) WHERE ($3 IS NULL OR id = $3) AND ($4 IS NULL OR ip_address = $4) AND ($5 IS NULL OR server_id = $5) OR ($6 IS NULL OR username = $6) OR ($7 IS NULL OR user_type = $7);"},
         (Statement){.statement_name = "select_hosted_servers", .query = "SELECT id FROM hosted_servers WHERE ($1 IS NULL OR id = $1);"},
         (Statement){.statement_name = "select_joined_servers", .query = "SELECT id, ip_address, server_id FROM joined_servers WHERE ($1 IS NULL OR id = $1) AND ($2 IS NULL OR ip_address = $2) AND ($3 IS NULL OR server_id = $3);"},
         (Statement){.statement_name = "select_hosted_server_users", .query = "SELECT id, username, ip_address, user_type FROM hosted_server_users WHERE ($1 IS NULL OR server_id = $1) AND ($2 IS NULL OR user_type = $2) AND ($3 IS NULL OR username = $3) AND ($4 IS NULL OR ip_address = $4);"},
         (Statement){.statement_name = "select_server_chat_channels", .query = "SELECT id, name, hosted_server_id FROM server_chat_channels WHERE ($1 IS NULL OR $1 = id) AND ($2 IS NULL OR $2 = name) AND ($3 IS NULL OR $3 = hosted_server_id);"},
-        (Statement){.statement_name = "select_channel_messages", .query = "SELECT messages.id, messages.message, length(messages.message), messages.sender_id, messages.channel_id, users.username FROM channel_messages messages JOIN hosted_server_users users ON users.id = messages.sender_id WHERE ($1 IS NULL OR messages.id = $1) AND ($2 IS NULL OR messages.message = $2) AND ($3 IS NULL OR messages.sender_id = $3) AND ($4 IS NULL OR messages.channel_id = $4);"},
+        (Statement){.statement_name = "select_channel_messages", .query = "SELECT messages.id, messages.message, messages.sender_id, messages.channel_id FROM channel_messages messages WHERE ($1 IS NULL OR messages.id = $1) AND ($2 IS NULL OR messages.message = $2) AND ($3 IS NULL OR messages.sender_id = $3) AND ($4 IS NULL OR messages.channel_id = $4) AND ($5 IS NULL OR messages.id > $5) ORDER BY messages.id LIMIT $6;"},
+        (Statement){.statement_name = "select_newest_channel_messages", .query = "SELECT id, message, sender_id, channel_id FROM (SELECT messages.id, messages.message, messages.sender_id, messages.channel_id FROM channel_messages messages WHERE messages.channel_id = $1 AND messages.id > $2 ORDER BY messages.id DESC LIMIT $3) ORDER BY id;"},
+        (Statement){.statement_name = "insert_cached_channel_message", .query = "INSERT OR IGNORE INTO cached_channel_messages (server_ip_address, server_id, channel_id, id, message, sender_id, sender_username) VALUES ($1, $2, $3, $4, $5, $6, $7);"},
+        (Statement){.statement_name = "select_cached_channel_last_message_id", .query = "SELECT COALESCE(MAX(id), 0) FROM cached_channel_messages WHERE server_ip_address = $1 AND server_id = $2 AND channel_id = $3;"},
+        (Statement){.statement_name = "select_cached_channel_messages", .query = "SELECT id, message, sender_id, sender_username FROM cached_channel_messages WHERE server_ip_address = $1 AND server_id = $2 AND channel_id = $3 ORDER BY id;"},
     };
 
     for(const auto& statement : statements) {
@@ -64,6 +186,8 @@ void Database::PrepareStatements() {
         }
 
         this->GetStatements().insert({statement.statement_name, stmt});
+
+        this->statement_profiles.insert({stmt, CreateStatementProfile(statement.statement_name)});
     }
 }
 
@@ -72,8 +196,10 @@ void Database::InitializeDatabaseTables() {
         "CREATE TABLE IF NOT EXISTS hosted_server_users (id INTEGER PRIMARY KEY AUTOINCREMENT, ip_address INTEGER UNIQUE NOT NULL, server_id INTEGER NOT NULL, username VARCHAR(20) NOT NULL, user_type INT NOT NULL DEFAULT 0);",
         "CREATE TABLE IF NOT EXISTS hosted_servers (id INTEGER PRIMARY KEY NOT NULL);",
         "CREATE TABLE IF NOT EXISTS joined_servers (id INTEGER PRIMARY KEY AUTOINCREMENT, ip_address INTEGER NOT NULL, server_id INTEGER NOT NULL);",
-        "CREATE TABLE IF NOT EXISTS server_chat_channels (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL, hosted_server_id INTEGER NOT NULL);"
-        "CREATE TABLE IF NOT EXISTS channel_messages (id INTEGER PRIMARY KEY AUTOINCREMENT, message TEXT NOT NULL, channel_id INTEGER NOT NULL, sender_id INTEGER NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS server_chat_channels (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL, hosted_server_id INTEGER NOT NULL);",
+        "CREATE TABLE IF NOT EXISTS channel_messages (id INTEGER PRIMARY KEY AUTOINCREMENT, message TEXT NOT NULL, channel_id INTEGER NOT NULL, sender_id INTEGER NOT NULL);",
+        // Client side cache of joined channels history
+        "CREATE TABLE IF NOT EXISTS cached_channel_messages (server_ip_address INTEGER NOT NULL, server_id INTEGER NOT NULL, channel_id INTEGER NOT NULL, id INTEGER NOT NULL, message TEXT NOT NULL, sender_id INTEGER NOT NULL, sender_username TEXT, PRIMARY KEY (server_ip_address, server_id, channel_id, id));"
     };
 
     for(const auto& query : queries) {
@@ -86,15 +212,19 @@ void Database::InitializeDatabaseTables() {
 }
 
 std::optional<Database::HostedServerUserRow> Database::InsertHostedServerUser(const uint16_t server_id, in_addr ip_address, const char* username) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("insert_hosted_server_user");
+    TRACE_SCOPE("db", "insert_hosted_server_user");
+    ALLOC_SCOPE(DATABASE);
 
     sqlite3_bind_int(stmt, 1, ip_address.s_addr);
     sqlite3_bind_int(stmt, 2, server_id);
     sqlite3_bind_text(stmt, 3, username, -1, SQLITE_TRANSIENT);
 
     int result_code = sqlite3_step(stmt);
-    if (result_code != SQLITE_DONE) {
-        std::cerr << "Failed to insert hosted_server_user" << std::endl;
+    if (result_code != SQLITE_ROW) {
+        LOG_ERROR(DATABASE, "Failed to insert hosted_server_user: %s", sqlite3_errmsg(this->GetDatabaseConnection()));
         
         sqlite3_reset(stmt);
 
@@ -117,15 +247,20 @@ std::optional<Database::HostedServerUserRow> Database::InsertHostedServerUser(co
 }
 
 std::optional<Database::ChannelMessageRow> Database::InsertChannelMessage(const char* message, const uint32_t channel_id, const uint32_t sender_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("insert_channel_message");
+    TRACE_SCOPE("db", "insert_channel_message");
+    ALLOC_SCOPE(DATABASE);
 
-    sqlite3_bind_text(stmt, 1, message, -1, SQLITE_TRANSIENT);
+    // The message outlives the step, so SQLite can read it in place
+    sqlite3_bind_text(stmt, 1, message, -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 2, channel_id);
     sqlite3_bind_int(stmt, 3, sender_id);
 
     int result = sqlite3_step(stmt);
     if (result != SQLITE_ROW) {
-        std::cerr << "Failed to insert channel message" << std::endl;
+        LOG_ERROR(DATABASE, "Failed to insert channel message: %s", sqlite3_errmsg(this->GetDatabaseConnection()));
 
         sqlite3_reset(stmt);
 
@@ -133,34 +268,80 @@ std::optional<Database::ChannelMessageRow> Database::InsertChannelMessage(const
     }
 
     int new_message_id = sqlite3_column_int(stmt, 0);
-    const char* username = (const char*)sqlite3_column_text(stmt, 1);
 
-    printf("DB MESSAGE INSERT USERNAME: %s\n", username);
+    LOG_TRACE(DATABASE, "Inserted message %d from user %u", new_message_id, sender_id);
 
     Database::ChannelMessageRow row = {
-        .channel_id = channel_id,
-        .message = message,
-        .message_length = static_cast<uint32_t>(strlen(message)),
         .id = static_cast<uint32_t>(new_message_id),
+        .message = message,
         .sender_id = sender_id,
+        .channel_id = channel_id
     };
 
-    memcpy(row.sender_username, username, sizeof(row.sender_username));
-
     sqlite3_reset(stmt);
 
     return row;
 }
 
+int Database::InsertCachedChannelMessages(const in_addr server_ip_address, const uint16_t server_id, const uint32_t channel_id, const ChannelMessageRow* messages, const size_t messages_len, UserDirectory* users) {
+    if (messages_len == 0) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    sqlite3_stmt* stmt = this->GetStatement("insert_cached_channel_message");
+    TRACE_SCOPE("db", "insert_cached_channel_message");
+    ALLOC_SCOPE(DATABASE);
+
+    sqlite3_exec(this->GetDatabaseConnection(), "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+
+    for (size_t i = 0; i < messages_len; i++) {
+        const ChannelMessageRow& message = messages[i];
+
+        // Kept with each message so cached history has names before the roster is synced, unknown senders are stored as NULL
+        const std::string_view sender_username = users->GetUsername(message.sender_id);
+
+        sqlite3_bind_int(stmt, 1, server_ip_address.s_addr);
+        sqlite3_bind_int(stmt, 2, server_id);
+        sqlite3_bind_int(stmt, 3, channel_id);
+        sqlite3_bind_int(stmt, 4, message.id);
+        sqlite3_bind_text(stmt, 5, message.message.data(), message.message.size(), SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 6, message.sender_id);
+        sqlite3_bind_text(stmt, 7, sender_username.data(), sender_username.size(), SQLITE_STATIC);
+
+        int result = sqlite3_step(stmt);
+        if (result != SQLITE_DONE) {
+            LOG_ERROR(DATABASE, "Failed to insert cached_channel_message: %s", sqlite3_errmsg(this->GetDatabaseConnection()));
+
+            sqlite3_reset(stmt);
+
+            sqlite3_exec(this->GetDatabaseConnection(), "ROLLBACK;", nullptr, nullptr, nullptr);
+
+            return -1;
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_exec(this->GetDatabaseConnection(), "COMMIT;", nullptr, nullptr, nullptr);
+
+    return 0;
+}
+
 int Database::InsertJoinedServer(const uint16_t server_id, in_addr ip_address) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("insert_joined_server");
+    TRACE_SCOPE("db", "insert_joined_server");
+    ALLOC_SCOPE(DATABASE);
 
     sqlite3_bind_int(stmt, 1, ip_address.s_addr);
     sqlite3_bind_int(stmt, 2, server_id);
 
     int result = sqlite3_step(stmt);
     if (result != SQLITE_DONE) {
-        std::cerr << "Failed to insert insert_joined_server" << std::endl;
+        LOG_ERROR(DATABASE, "Failed to insert joined_server: %s", sqlite3_errmsg(this->GetDatabaseConnection()));
 
         sqlite3_reset(stmt);
 
@@ -173,14 +354,18 @@ int Database::InsertJoinedServer(const uint16_t server_id, in_addr ip_address) {
 }
 
 int Database::InsertServerChatChannel(const char* name, const uint16_t server_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("insert_server_chat_channel");
+    TRACE_SCOPE("db", "insert_server_chat_channel");
+    ALLOC_SCOPE(DATABASE);
 
     sqlite3_bind_text(stmt, 1, name, -1, SQLITE_TRANSIENT);
     sqlite3_bind_int(stmt, 2, server_id);
 
     int result = sqlite3_step(stmt);
     if (result != SQLITE_DONE) {
-        std::cerr << "Failed to insert insert_joined_server" << std::endl;
+        LOG_ERROR(DATABASE, "Failed to insert server_chat_channel: %s", sqlite3_errmsg(this->GetDatabaseConnection()));
 
         sqlite3_reset(stmt);
 
@@ -193,13 +378,17 @@ int Database::InsertServerChatChannel(const char* name, const uint16_t server_id
 }
 
 int Database::InsertHostedServer(const uint16_t server_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("insert_hosted_server");
+    TRACE_SCOPE("db", "insert_hosted_server");
+    ALLOC_SCOPE(DATABASE);
 
     sqlite3_bind_int(stmt, 1, server_id);
 
     int result = sqlite3_step(stmt);
     if (result != SQLITE_DONE) {
-        std::cerr << "Failed to insert insert_hosted_server" << std::endl;
+        LOG_ERROR(DATABASE, "Failed to insert hosted_server: %s", sqlite3_errmsg(this->GetDatabaseConnection()));
 
         sqlite3_reset(stmt);
 
@@ -212,7 +401,11 @@ int Database::InsertHostedServer(const uint16_t server_id) {
 }
 
 int Database::UpdateHostedServerUsers(const char* new_username, const std::optional<Database::UserType> new_user_type, const std::optional<uint32_t> id, const std::optional<in_addr_t> ip_address, const std::optional<uint16_t> server_id, const char* username, const std::optional<Database::UserType> user_type) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("update_hosted_server_users");
+    TRACE_SCOPE("db", "update_hosted_server_users");
+    ALLOC_SCOPE(DATABASE);
 
     new_username != nullptr ? sqlite3_bind_text(stmt, 1, new_username, -1, SQLITE_TRANSIENT) : sqlite3_bind_null(stmt, 1);
     new_user_type.has_value() ? sqlite3_bind_int(stmt, 2, new_user_type.value()) : sqlite3_bind_null(stmt, 2);
@@ -224,7 +417,7 @@ int Database::UpdateHostedServerUsers(const char* new_username, const std::optio
 
     int result = sqlite3_step(stmt);
     if (result != SQLITE_DONE) {
-        std::cerr << "Failed to update hosted_server_users" << std::endl;
+        LOG_ERROR(DATABASE, "Failed to update hosted_server_users: %s", sqlite3_errmsg(this->GetDatabaseConnection()));
 
         sqlite3_reset(stmt);
         
@@ -237,7 +430,11 @@ int Database::UpdateHostedServerUsers(const char* new_username, const std::optio
 } 
 
 std::vector<Database::HostedServerUserRow>* Database::SelectHostedServerUsers(const std::optional<uint16_t> server_id, const std::optional<Database::UserType> user_type, const char* username, const std::optional<in_addr_t> ip_address) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("select_hosted_server_users");
+    TRACE_SCOPE("db", "select_hosted_server_users");
+    ALLOC_SCOPE(DATABASE);
 
     server_id.has_value() ? sqlite3_bind_int(stmt, 1, server_id.value()) : sqlite3_bind_null(stmt, 1);
     user_type.has_value() ? sqlite3_bind_int(stmt, 2, user_type.value()) : sqlite3_bind_null(stmt, 2);
@@ -266,7 +463,11 @@ std::vector<Database::HostedServerUserRow>* Database::SelectHostedServerUsers(co
 }
 
 std::vector<Database::JoinedServerRow>* Database::SelectJoinedServers(const std::optional<uint32_t> id, const std::optional<in_addr_t> ip_address, const std::optional<uint16_t> server_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("select_joined_servers");
+    TRACE_SCOPE("db", "select_joined_servers");
+    ALLOC_SCOPE(DATABASE);
 
     id.has_value() ? sqlite3_bind_int(stmt, 1, id.value()) : sqlite3_bind_null(stmt, 1);
     ip_address.has_value() ? sqlite3_bind_int(stmt, 2, ip_address.value()) : sqlite3_bind_null(stmt, 2);
@@ -287,51 +488,124 @@ std::vector<Database::JoinedServerRow>* Database::SelectJoinedServers(const std:
     return result;
 }
 
-std::vector<Database::ChannelMessageRow>* Database::SelectChannelMessages(const std::optional<uint32_t> id, const char* message, const std::optional<uint32_t> sender_id, const std::optional<uint32_t> channel_id) {
+void Database::SelectChannelMessages(const std::optional<uint32_t> id, const char* message, const std::optional<uint32_t> sender_id, const std::optional<uint32_t> channel_id, const std::optional<uint32_t> after_id, const std::optional<uint32_t> limit, ChannelMessageBatch* messages) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("select_channel_messages");
+    TRACE_SCOPE("db", "select_channel_messages");
+    ALLOC_SCOPE(DATABASE);
 
     id.has_value() ? sqlite3_bind_int(stmt, 1, id.value()) : sqlite3_bind_null(stmt, 1);
     message != nullptr ? sqlite3_bind_text(stmt, 2, message, -1, SQLITE_TRANSIENT) : sqlite3_bind_null(stmt, 2);
     sender_id.has_value() ? sqlite3_bind_int(stmt, 3, sender_id.value()) : sqlite3_bind_null(stmt, 3);
     channel_id.has_value() ? sqlite3_bind_int(stmt, 4, channel_id.value()) : sqlite3_bind_null(stmt, 4);
+    after_id.has_value() ? sqlite3_bind_int(stmt, 5, after_id.value()) : sqlite3_bind_null(stmt, 5);
+    limit.has_value() ? sqlite3_bind_int64(stmt, 6, limit.value()) : sqlite3_bind_int(stmt, 6, -1);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* const message = (const char*)sqlite3_column_text(stmt, 1);
+
+        LOG_TRACE(DATABASE, "Got message from db: %s", message);
+
+        // Byte counts rather than length(), which counts characters
+        auto message_row = (Database::ChannelMessageRow){
+            .id = static_cast<uint32_t>(sqlite3_column_int(stmt, 0)),
+            .message = std::string_view(message, sqlite3_column_bytes(stmt, 1)),
+            .sender_id = static_cast<uint32_t>(sqlite3_column_int(stmt, 2)),
+            .channel_id = static_cast<uint32_t>(sqlite3_column_int(stmt, 3))
+        };
+
+        // The column text is only valid until the next step, the batch keeps its own copy
+        messages->Add(message_row);
+    }
 
-    std::vector<Database::ChannelMessageRow>* result = new std::vector<Database::ChannelMessageRow>();
+    sqlite3_reset(stmt);
+}
+
+void Database::SelectNewestChannelMessages(const uint32_t channel_id, const uint32_t after_id, const uint32_t limit, ChannelMessageBatch* messages) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    sqlite3_stmt* stmt = this->GetStatement("select_newest_channel_messages");
+    TRACE_SCOPE("db", "select_newest_channel_messages");
+    ALLOC_SCOPE(DATABASE);
+
+    sqlite3_bind_int(stmt, 1, channel_id);
+    sqlite3_bind_int(stmt, 2, after_id);
+    sqlite3_bind_int64(stmt, 3, limit);
 
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        const uint32_t id = sqlite3_column_int(stmt, 0);
         const char* const message = (const char*)sqlite3_column_text(stmt, 1);
 
-        printf("Got message from db: %s\n", message);
+        messages->Add((Database::ChannelMessageRow){
+            .id = static_cast<uint32_t>(sqlite3_column_int(stmt, 0)),
+            .message = std::string_view(message, sqlite3_column_bytes(stmt, 1)),
+            .sender_id = static_cast<uint32_t>(sqlite3_column_int(stmt, 2)),
+            .channel_id = static_cast<uint32_t>(sqlite3_column_int(stmt, 3))
+        });
+    }
 
-        const uint32_t message_length = sqlite3_column_int(stmt, 2);
-        const uint32_t sender_id = sqlite3_column_int(stmt, 3);
-        const uint32_t channel_id = sqlite3_column_int(stmt, 4);
-        const char* sender_username = (const char*)sqlite3_column_text(stmt, 5);
+    sqlite3_reset(stmt);
+}
 
-        char* message_clone = (char*)malloc(message_length + 1);
+void Database::SelectCachedChannelMessages(const in_addr server_ip_address, const uint16_t server_id, const uint32_t channel_id, ChannelMessageBatch* messages, UserDirectory* users) {
+    std::lock_guard<std::mutex> lock(this->mutex);
 
-        memcpy(message_clone, message, message_length + 1);
+    sqlite3_stmt* stmt = this->GetStatement("select_cached_channel_messages");
+    TRACE_SCOPE("db", "select_cached_channel_messages");
+    ALLOC_SCOPE(DATABASE);
 
-        auto message_row = (Database::ChannelMessageRow){
-            .message = message_clone,
-            .message_length = message_length,
-            .id = id,
+    sqlite3_bind_int(stmt, 1, server_ip_address.s_addr);
+    sqlite3_bind_int(stmt, 2, server_id);
+    sqlite3_bind_int(stmt, 3, channel_id);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* const message = (const char*)sqlite3_column_text(stmt, 1);
+        const uint32_t sender_id = sqlite3_column_int(stmt, 2);
+        const char* const sender_username = (const char*)sqlite3_column_text(stmt, 3);
+
+        messages->Add((Database::ChannelMessageRow){
+            .id = static_cast<uint32_t>(sqlite3_column_int(stmt, 0)),
+            .message = std::string_view(message, sqlite3_column_bytes(stmt, 1)),
             .sender_id = sender_id,
             .channel_id = channel_id
-        };
+        });
+
+        if (sender_username != nullptr && !users->Contains(sender_id)) {
+            users->SetUsername(sender_id, std::string_view(sender_username, sqlite3_column_bytes(stmt, 3)));
+        }
+    }
+
+    sqlite3_reset(stmt);
+}
 
-        memcpy(&message_row.sender_username, sender_username, sizeof(message_row.sender_username));
+uint32_t Database::SelectCachedChannelLastMessageId(const in_addr server_ip_address, const uint16_t server_id, const uint32_t channel_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
 
-        result->push_back(message_row);
+    sqlite3_stmt* stmt = this->GetStatement("select_cached_channel_last_message_id");
+    TRACE_SCOPE("db", "select_cached_channel_last_message_id");
+    ALLOC_SCOPE(DATABASE);
+
+    sqlite3_bind_int(stmt, 1, server_ip_address.s_addr);
+    sqlite3_bind_int(stmt, 2, server_id);
+    sqlite3_bind_int(stmt, 3, channel_id);
+
+    uint32_t last_message_id = 0;
+
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        last_message_id = sqlite3_column_int(stmt, 0);
     }
 
     sqlite3_reset(stmt);
 
-    return result;
+    return last_message_id;
 }
 
 std::vector<Database::ServerChatChannelRow>* Database::SelectServerChatChannels(const std::optional<uint32_t> id, const char* name, const std::optional<uint16_t> server_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("select_server_chat_channels");
+    TRACE_SCOPE("db", "select_server_chat_channels");
+    ALLOC_SCOPE(DATABASE);
 
     id.has_value() ? sqlite3_bind_int(stmt, 1, id.value()) : sqlite3_bind_null(stmt, 1);
     name != nullptr ? sqlite3_bind_text(stmt, 2, name, -1, SQLITE_TRANSIENT) : sqlite3_bind_null(stmt, 2);
@@ -361,7 +635,11 @@ std::vector<Database::ServerChatChannelRow>* Database::SelectServerChatChannels(
 }
 
 std::vector<Database::HostedServerRow>* Database::SelectHostedServers(const std::optional<uint16_t> server_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
     sqlite3_stmt* stmt = this->GetStatement("select_hosted_servers");
+    TRACE_SCOPE("db", "select_hosted_servers");
+    ALLOC_SCOPE(DATABASE);
 
     std::vector<Database::HostedServerRow>* result = new std::vector<Database::HostedServerRow>();
 
@@ -1,171 +1,789 @@
 #include "objects.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <chrono>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <pthread.h>
-#include <stdatomic.h>
-#include <swift_net.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 #include <thread>
-#include "../main.hpp"
+#include <mutex>
+#include "../protocol/protocol.hpp"
+#include "../transport/transport.hpp"
+#include "../utils/alloc/alloc.hpp"
+#include "../utils/concurrency/reactor.hpp"
+#include "../utils/concurrency/worker_pool.hpp"
+#include "../utils/log/log.hpp"
+#include "../utils/metrics/metrics.hpp"
+#include "../utils/trace/trace.hpp"
 
 using namespace objects;
 
-static void SerializeChannelMessages(SwiftNetPacketBuffer* buffer, std::vector<Database::ChannelMessageRow>* messages) {
-    for (auto &message : *messages) {
-        const uint32_t new_message_len = message.message_length + 1;
-        
-        swiftnet_server_append_to_packet(&message.id, sizeof(message.id), buffer);
-        swiftnet_server_append_to_packet(&message.sender_id, sizeof(message.sender_id), buffer);
-        swiftnet_server_append_to_packet(&new_message_len, sizeof(message.message_length), buffer);
-        swiftnet_server_append_to_packet(message.message, new_message_len, buffer);
-        swiftnet_server_append_to_packet(message.sender_username, sizeof(message.sender_username), buffer);
+// Metric names of each request type, in RequestType order
+static const char* const request_type_names[] = {
+    "join_server",
+    "load_server_information",
+    "load_channel_data",
+    "send_message",
+    "load_joined_server_data",
+    "load_admin_menu_data",
+    "create_new_channel",
+    "periodic_chat_update",
+    "client_online_check",
+    "leave_channel",
+    "load_server_stats",
+    "load_user_roster",
+    "acknowledge_chat_update"
+};
+
+#define REQUEST_TYPES_LEN (sizeof(request_type_names) / sizeof(request_type_names[0]))
+
+struct RequestPolicy {
+    RequestCost cost;
+    RequestClass request_class;
+
+    // Whether the client waits on a response, a rejection of the others is sent back as a packet of its own
+    bool has_response;
+};
+
+// Admission and scheduling rules of each request type, in RequestType order
+static const RequestPolicy request_policies[] = {
+    {EXPENSIVE_REQUEST, NORMAL_REQUEST, true},       // join_server
+    {CHEAP_REQUEST, NORMAL_REQUEST, true},           // load_server_information
+    {EXPENSIVE_REQUEST, BULK_REQUEST, true},         // load_channel_data
+    {EXPENSIVE_REQUEST, INTERACTIVE_REQUEST, false}, // send_message
+    {CHEAP_REQUEST, NORMAL_REQUEST, true},           // load_joined_server_data
+    {EXPENSIVE_REQUEST, BULK_REQUEST, true},         // load_admin_menu_data
+    {EXPENSIVE_REQUEST, NORMAL_REQUEST, true},       // create_new_channel
+    {CHEAP_REQUEST, INTERACTIVE_REQUEST, false},     // periodic_chat_update
+    {CHEAP_REQUEST, INTERACTIVE_REQUEST, false},     // client_online_check
+    {CHEAP_REQUEST, INTERACTIVE_REQUEST, false},     // leave_channel
+    {EXPENSIVE_REQUEST, BULK_REQUEST, true},         // load_server_stats
+    {EXPENSIVE_REQUEST, NORMAL_REQUEST, true},       // load_user_roster
+    {CHEAP_REQUEST, INTERACTIVE_REQUEST, false}      // acknowledge_chat_update
+};
+
+static_assert(sizeof(request_policies) / sizeof(request_policies[0]) == REQUEST_TYPES_LEN, "Every request type needs a policy");
+
+// Metric names of each request class, in RequestClass order
+static const char* const request_class_names[] = {
+    "interactive",
+    "normal",
+    "bulk"
+};
+
+// Requests a class may be passed over for while it has work waiting, the interactive class is never owed a turn
+static const uint32_t request_class_shares[] = {
+    UINT32_MAX,
+    SCHEDULER_NORMAL_SHARE,
+    SCHEDULER_BULK_SHARE
+};
+
+static_assert(sizeof(request_class_names) / sizeof(request_class_names[0]) == REQUEST_CLASSES_LEN, "Every request class needs a name");
+
+#define FANOUT_BUFFER_INITIAL_SIZE 4096
+
+// Recipients one fan-out task sends to, small enough that a large channel spreads over every thread
+#define FANOUT_PARTITION_SIZE 256
 
-        printf("Serializing message: %s\n", message.message);
+struct RequestClassMetrics {
+    utils::metrics::MetricId wait;
+    utils::metrics::MetricId latency;
+    utils::metrics::MetricId queue_depth;
+};
+
+struct RequestMetrics {
+    utils::metrics::MetricId requests;
+    utils::metrics::MetricId errors;
+    utils::metrics::MetricId rejected;
+    utils::metrics::MetricId latency;
+};
+
+// Shared by every hosted server in the process
+struct ServerMetrics {
+    RequestMetrics request_types[REQUEST_TYPES_LEN];
+    RequestClassMetrics request_classes[REQUEST_CLASSES_LEN];
+    utils::metrics::MetricId unknown_requests;
+    utils::metrics::MetricId shed_requests;
+    utils::metrics::MetricId fanout_batch_messages;
+    utils::metrics::MetricId fanout_channels;
+    utils::metrics::MetricId fanout_packets;
+    utils::metrics::MetricId fanout_tick;
+    utils::metrics::MetricId fanout_partitions;
+    utils::metrics::MetricId fanout_partition;
+    utils::metrics::MetricId online_checks;
+    utils::metrics::MetricId online_check_failures;
+    utils::metrics::MetricId user_queue_depth;
+    utils::metrics::MetricId user_queue_bytes;
+    utils::metrics::MetricId held_back_updates;
+    utils::metrics::MetricId catch_up_batches;
+    utils::metrics::MetricId resyncs;
+};
+
+static ServerMetrics CreateServerMetrics() {
+    ServerMetrics metrics;
+
+    for (uint32_t i = 0; i < REQUEST_TYPES_LEN; i++) {
+        const std::string name = request_type_names[i];
+
+        metrics.request_types[i] = (RequestMetrics){
+            .requests = utils::metrics::RegisterCounter(("requests." + name).c_str()),
+            .errors = utils::metrics::RegisterCounter(("errors." + name).c_str()),
+            .rejected = utils::metrics::RegisterCounter(("rejected." + name).c_str()),
+            .latency = utils::metrics::RegisterHistogram(("latency." + name).c_str(), utils::metrics::NANOSECONDS)
+        };
     }
+
+    for (uint32_t i = 0; i < REQUEST_CLASSES_LEN; i++) {
+        const std::string name = request_class_names[i];
+
+        metrics.request_classes[i] = (RequestClassMetrics){
+            .wait = utils::metrics::RegisterHistogram(("scheduler." + name + ".wait").c_str(), utils::metrics::NANOSECONDS),
+            .latency = utils::metrics::RegisterHistogram(("scheduler." + name + ".latency").c_str(), utils::metrics::NANOSECONDS),
+            .queue_depth = utils::metrics::RegisterHistogram(("scheduler." + name + ".queue_depth").c_str(), utils::metrics::COUNT)
+        };
+    }
+
+    metrics.unknown_requests = utils::metrics::RegisterCounter("requests.unknown");
+    metrics.shed_requests = utils::metrics::RegisterCounter("requests.shed");
+    metrics.fanout_batch_messages = utils::metrics::RegisterHistogram("fanout.batch_messages", utils::metrics::COUNT);
+    metrics.fanout_channels = utils::metrics::RegisterHistogram("fanout.channels", utils::metrics::COUNT);
+    metrics.fanout_packets = utils::metrics::RegisterHistogram("fanout.packets", utils::metrics::COUNT);
+    metrics.fanout_tick = utils::metrics::RegisterHistogram("fanout.tick", utils::metrics::NANOSECONDS);
+    metrics.fanout_partitions = utils::metrics::RegisterHistogram("fanout.partitions", utils::metrics::COUNT);
+    metrics.fanout_partition = utils::metrics::RegisterHistogram("fanout.partition", utils::metrics::NANOSECONDS);
+    metrics.online_checks = utils::metrics::RegisterCounter("online_checks.sent");
+    metrics.online_check_failures = utils::metrics::RegisterCounter("online_checks.failed");
+    metrics.user_queue_depth = utils::metrics::RegisterHistogram("fanout.user_queue_depth", utils::metrics::COUNT);
+    metrics.user_queue_bytes = utils::metrics::RegisterHistogram("fanout.user_queue_bytes", utils::metrics::COUNT);
+    metrics.held_back_updates = utils::metrics::RegisterCounter("fanout.held_back_updates");
+    metrics.catch_up_batches = utils::metrics::RegisterCounter("fanout.catch_up_batches");
+    metrics.resyncs = utils::metrics::RegisterCounter("fanout.resyncs");
+
+    return metrics;
 }
 
-struct BackgroundProcessNewMessagesChannel {
-    uint32_t bytes_to_allocate;
-    SwiftNetPacketBuffer buffer;
-    std::vector<objects::Database::ChannelMessageRow> messages;
+static const ServerMetrics& GetServerMetrics() {
+    static const ServerMetrics metrics = CreateServerMetrics();
+
+    return metrics;
+}
+
+static void CountRequestError(const RequestType request_type) {
+    utils::metrics::IncrementCounter(GetServerMetrics().request_types[request_type].errors);
+}
+
+// One channel's run of messages in a sorted tick batch
+struct FanoutChannel {
+    uint32_t channel_id;
+    uint32_t first_message;
+    uint32_t messages_len;
+    transport::PacketBuffer* buffer;
+
+    // Range of the channel's subscribers in the grouped recipient addresses
+    uint32_t first_recipient;
+    uint32_t recipients_len;
+    uint32_t next_recipient;
 };
 
-void HostedServer::BackgroundProcesses() {
-    while (true) {
-        if (atomic_load_explicit(&this->stop_background_processes, memory_order_acquire) == true) {
-            break;
-        }
+// Subscriber of a channel in this tick, in member order until grouped by channel
+struct FanoutRecipient {
+    uint32_t channel;
+    transport::ClientAddrData addr_data;
+};
 
-        if (this->GetNewMessages()->size() == 0) {
-            usleep(200000);
-            continue;
+// One batch send, serialized buffers are only read while sending so every partition of a channel shares one
+struct FanoutPartition {
+    const transport::PacketBuffer* buffer;
+    uint32_t first_recipient;
+    uint32_t recipients_len;
+};
+
+// Kept across ticks and only ever grown, so a steady load stops allocating after the first ticks
+struct objects::FanoutState {
+    ChannelMessageBatch new_messages;
+    std::vector<FanoutChannel> channels;
+    std::vector<transport::PacketBuffer*> channel_buffers;
+    std::vector<ServerUserHandle> stale_users;
+    std::vector<FanoutRecipient> recipients;
+    std::vector<transport::ClientAddrData> recipient_addr_data;
+    std::vector<FanoutPartition> partitions;
+    std::vector<uint64_t> partition_times;
+
+    ~FanoutState() {
+        for (auto buffer : this->channel_buffers) {
+            delete buffer;
         }
+    }
+};
 
-        auto channel_new_messages = std::unordered_map<uint32_t, BackgroundProcessNewMessagesChannel>();
+// Zero until set, the pool then sizes itself to the machine
+static std::atomic<uint32_t> fanout_threads = 0;
 
-        for (auto &new_message : *this->GetNewMessages()) {
-            auto it = channel_new_messages.find(new_message.channel_id);
-            if (it == channel_new_messages.end()) {
-                channel_new_messages.emplace(new_message.channel_id, (BackgroundProcessNewMessagesChannel){.bytes_to_allocate = sizeof(ResponseInfo) + sizeof(responses::PeriodicChatUpdateResponse), .messages = std::vector<objects::Database::ChannelMessageRow>()});
-                channel_new_messages.at(new_message.channel_id).messages.push_back(new_message);
-                channel_new_messages.at(new_message.channel_id).bytes_to_allocate += new_message.message_length + 1 + sizeof(new_message.message_length) + sizeof(new_message.id) + sizeof(new_message.sender_id) + sizeof(new_message.sender_username);
+static utils::concurrency::WorkerPool& GetFanoutPool() {
+    static utils::concurrency::WorkerPool pool(HostedServer::GetFanoutThreads());
 
-                continue;
-            } else {
-                it->second.bytes_to_allocate += new_message.message_length + 1 + sizeof(new_message.message_length) + sizeof(new_message.id) + sizeof(new_message.sender_id) + sizeof(new_message.sender_username);
-                it->second.messages.push_back(new_message);
+    return pool;
+}
 
-                continue;
-            }
+// One thread takes the servers that handed over online checks in turn and spreads each one's checks over a pool
+class OnlineCheckRunner {
+public:
+    OnlineCheckRunner() : pool(ONLINE_CHECK_THREADS) {
+        this->thread = new std::thread([this]() {
+            this->Run();
+        });
+    }
+
+    ~OnlineCheckRunner() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            this->stop = true;
         }
 
-        for (auto& [channel_id, channel_new_message] : channel_new_messages) {
-            const ResponseInfo response_info = {
-                .request_type = RequestType::PERIODIC_CHAT_UPDATE,
-                .request_status = Status::SUCCESS
-            };
+        this->work_condition.notify_one();
+
+        this->thread->join();
 
-            const responses::PeriodicChatUpdateResponse response = {
-                .channel_messages_len = static_cast<uint32_t>(channel_new_message.messages.size())
-            };
-            
-            channel_new_message.buffer = swiftnet_server_create_packet_buffer(channel_new_message.bytes_to_allocate);
+        delete this->thread;
+    }
 
-            swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &channel_new_message.buffer);
-            swiftnet_server_append_to_packet(&response, sizeof(response), &channel_new_message.buffer);
+    void Submit(HostedServer* server) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
 
-            SerializeChannelMessages(&channel_new_message.buffer, &channel_new_message.messages);
+            this->servers.push_back(server);
         }
 
-        for (auto &user : *this->GetServerUsers()) {
-            if (user.status == ServerUserStatus::OFFLINE) {
-                continue;
+        this->work_condition.notify_one();
+    }
+
+    // Returns once the server's checks are neither waiting nor running
+    void Wait(HostedServer* server) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        this->done_condition.wait(lock, [this, server]() {
+            return this->running != server && std::find(this->servers.begin(), this->servers.end(), server) == this->servers.end();
+        });
+    }
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        while (true) {
+            this->work_condition.wait(lock, [this]() { return this->stop || !this->servers.empty(); });
+
+            if (this->servers.empty()) {
+                return;
             }
 
-            auto now = std::chrono::steady_clock::now();
-            auto elapsed = now - user.time_since_last_request;
+            this->running = this->servers.front();
+            this->servers.pop_front();
 
-            if (elapsed > std::chrono::seconds(60)) {
-                const RequestInfo online_check_req_info = {
-                    .request_type = RequestType::CLIENT_ONLINE_CHECK
-                };
+            lock.unlock();
+
+            this->running->RunOnlineChecks(this->pool);
 
-                auto online_check_buffer = swiftnet_server_create_packet_buffer(sizeof(online_check_req_info));
+            lock.lock();
 
-                swiftnet_server_append_to_packet(&online_check_req_info, sizeof(online_check_req_info), &online_check_buffer);
+            this->running = nullptr;
 
-                auto online_check_response = swiftnet_server_make_request(server, &online_check_buffer, user.addr_data, DEFAULT_TIMEOUT_REQUEST);
+            this->done_condition.notify_all();
+        }
+    }
 
-                swiftnet_server_destroy_packet_buffer(&online_check_buffer);
+    utils::concurrency::WorkerPool pool;
+    std::thread* thread;
 
-                if (online_check_response == nullptr) {
-                    user.status = ServerUserStatus::OFFLINE,
-                    memset(&user.addr_data, 0x00, sizeof(user.addr_data));
+    std::mutex mutex;
+    std::condition_variable work_condition;
+    std::condition_variable done_condition;
 
-                    continue;
-                }
+    std::deque<HostedServer*> servers;
+    HostedServer* running = nullptr;
+    bool stop = false;
+};
+
+static OnlineCheckRunner& GetOnlineCheckRunner() {
+    static OnlineCheckRunner runner;
+
+    return runner;
+}
+
+void HostedServer::RunOnlineChecks(utils::concurrency::WorkerPool& pool) {
+    ALLOC_SCOPE(SERVER);
+
+    const RequestInfo online_check_req_info = {
+        .request_type = RequestType::CLIENT_ONLINE_CHECK
+    };
+
+    transport::PooledPacketBuffer online_check_buffer(sizeof(online_check_req_info));
+
+    online_check_buffer->Append(&online_check_req_info, sizeof(online_check_req_info));
+
+    auto check = [&](const size_t index) {
+        TRACE_SCOPE("fanout", "online_check");
+
+        OnlineCheck& online_check = this->online_checks[index];
+
+        auto online_check_response = this->GetServer()->MakeRequest(online_check_buffer.Get(), online_check.addr_data, DEFAULT_TIMEOUT_REQUEST);
+
+        online_check.online = online_check_response != nullptr;
+
+        delete online_check_response;
+    };
+
+    pool.ForEach(this->online_checks.size(), check);
+
+    this->online_checks_answered.store(true, std::memory_order_release);
+}
+
+void HostedServer::Tick() {
+    ALLOC_SCOPE(SERVER);
+
+    const ServerMetrics& metrics = GetServerMetrics();
+
+    ChannelMessageBatch& new_messages = this->fanout_state->new_messages;
+    std::vector<FanoutChannel>& channels = this->fanout_state->channels;
+    std::vector<transport::PacketBuffer*>& channel_buffers = this->fanout_state->channel_buffers;
+    std::vector<ServerUserHandle>& stale_users = this->fanout_state->stale_users;
+    std::vector<FanoutRecipient>& recipients = this->fanout_state->recipients;
+    std::vector<transport::ClientAddrData>& recipient_addr_data = this->fanout_state->recipient_addr_data;
+    std::vector<FanoutPartition>& partitions = this->fanout_state->partitions;
+    std::vector<uint64_t>& partition_times = this->fanout_state->partition_times;
 
-                this->MarkUserOnline(&user);
+    ServerUserTable* const users = this->GetServerUsers();
 
-                swiftnet_server_destroy_packet_data(online_check_response, server);
+    transport::ServerTransport* const server = this->GetServer();
+
+    auto send_partition = [&](const size_t partition) {
+        ALLOC_SCOPE(SERVER);
+        TRACE_SCOPE("fanout", "partition");
+
+        const auto partition_start = std::chrono::steady_clock::now();
+
+        const FanoutPartition& fanout_partition = partitions[partition];
+
+        server->SendPacketBatch(fanout_partition.buffer, &recipient_addr_data[fanout_partition.first_recipient], fanout_partition.recipients_len);
+
+        // Recorded by the reactor thread, so sender threads never create metric shards mid run
+        partition_times[partition] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - partition_start).count();
+    };
+
+    utils::metrics::SetGauge(this->online_users_gauge, users->CountOnline());
+    utils::metrics::SetGauge(this->members_gauge, users->GetSize());
+    utils::metrics::SetGauge(this->lagging_users_gauge, this->lagging_users.size());
+
+    this->TakeNewMessages(new_messages);
+
+    // Counted here rather than on the check threads, so those never create metric shards
+    if (this->online_checks_answered.load(std::memory_order_acquire)) {
+        for (const OnlineCheck& online_check : this->online_checks) {
+            utils::metrics::IncrementCounter(metrics.online_checks);
+
+            // Went offline or came back on another address while it was being checked
+            if (memcmp(&users->addr_data[online_check.handle], &online_check.addr_data, sizeof(online_check.addr_data)) != 0) {
+                continue;
             }
 
-            auto it = channel_new_messages.find(user.active_channel_id);
-            if (it == channel_new_messages.end()) {
+            if (!online_check.online) {
+                utils::metrics::IncrementCounter(metrics.online_check_failures);
+
+                users->MarkOffline(online_check.handle);
+
                 continue;
             }
 
-            swiftnet_server_send_packet(this->GetServer(), &it->second.buffer, user.addr_data);
+            users->MarkOnline(online_check.handle);
+        }
+
+        this->online_checks.clear();
+        this->online_checks_answered.store(false, std::memory_order_relaxed);
+        this->online_checks_sent = false;
+    }
+
+    // A stopping server's last tick hands over nothing, its transport is about to go
+    if (!this->online_checks_sent && this->GetServerStatus() == HostedServerStatus::RUNNING) {
+        stale_users.clear();
+        users->CollectStale(std::chrono::steady_clock::now() - std::chrono::seconds(60), &stale_users);
+
+        for (const ServerUserHandle handle : stale_users) {
+            if (this->online_checks.size() == ONLINE_CHECKS_PER_TICK) {
+                break;
+            }
+
+            this->online_checks.push_back((OnlineCheck){
+                .handle = handle,
+                .addr_data = users->addr_data[handle],
+                .online = false
+            });
+        }
+
+        if (!this->online_checks.empty()) {
+            this->online_checks_sent = true;
+
+            GetOnlineCheckRunner().Submit(this);
+        }
+    }
+
+    // Runs on quiet ticks too, a member that caught up gets its held back updates and one that doesn't is resynced in time
+    this->DrainSendQueues();
+
+    std::vector<Database::ChannelMessageRow>& rows = new_messages.rows;
+
+    if (rows.size() == 0) {
+        return;
+    }
+
+    const auto tick_start = std::chrono::steady_clock::now();
+
+    utils::trace::ScopedSpan tick_span("fanout", "tick");
+    utils::trace::ScopedSpan group_span("fanout", "group_messages");
+
+    // Ids grow with every insert, so this groups each channel's messages in the order they were sent
+    std::sort(rows.begin(), rows.end(), [](const Database::ChannelMessageRow& a, const Database::ChannelMessageRow& b) {
+        return a.channel_id != b.channel_id ? a.channel_id < b.channel_id : a.id < b.id;
+    });
+
+    channels.clear();
+
+    for (uint32_t first = 0; first < rows.size();) {
+        uint32_t last = first + 1;
+
+        while (last < rows.size() && rows[last].channel_id == rows[first].channel_id) {
+            last++;
+        }
+
+        if (channels.size() == channel_buffers.size()) {
+            channel_buffers.push_back(new transport::PacketBuffer(FANOUT_BUFFER_INITIAL_SIZE));
+        }
+
+        channels.push_back((FanoutChannel){
+            .channel_id = rows[first].channel_id,
+            .first_message = first,
+            .messages_len = last - first,
+            .buffer = channel_buffers[channels.size()],
+            .first_recipient = 0,
+            .recipients_len = 0,
+            .next_recipient = 0
+        });
+
+        first = last;
+    }
+
+    group_span.End();
+
+    utils::trace::ScopedSpan serialize_span("fanout", "serialize");
+
+    for (auto& channel : channels) {
+        const ResponseInfo response_info = {
+            .request_type = RequestType::PERIODIC_CHAT_UPDATE,
+            .request_status = Status::SUCCESS
+        };
+
+        const responses::PeriodicChatUpdateResponse response = {
+            .channel_messages_len = channel.messages_len
+        };
+
+        channel.buffer->Clear();
+
+        channel.buffer->Append(&response_info, sizeof(response_info));
+        channel.buffer->Append(&response, sizeof(response));
+
+        SerializeChannelMessages(channel.buffer, &rows[channel.first_message], channel.messages_len);
+    }
+
+    serialize_span.End();
+
+    utils::trace::ScopedSpan send_span("fanout", "send");
+
+    recipients.clear();
+
+    users->ForEachSubscription([&](const ServerUserHandle handle, const uint32_t subscription, const uint32_t channel_id) {
+        auto it = std::lower_bound(channels.begin(), channels.end(), channel_id, [](const FanoutChannel& channel, const uint32_t channel_id) {
+            return channel.channel_id < channel_id;
+        });
+
+        if (it == channels.end() || it->channel_id != channel_id) {
+            return;
         }
 
-        for (auto& [channel_id, channel_new_message] : channel_new_messages) {
-            swiftnet_server_destroy_packet_buffer(&channel_new_message.buffer);
+        const uint32_t unacknowledged = users->GetUnacknowledgedUpdates(handle);
+
+        utils::metrics::RecordValue(metrics.user_queue_depth, unacknowledged);
+
+        // Once held back, a member gets everything through its queue so the messages stay in order
+        if (unacknowledged >= USER_SEND_WINDOW || (handle < this->send_queues.size() && this->send_queues[handle] != nullptr && this->send_queues[handle]->lagging)) {
+            this->HoldBackUpdate(handle, it->buffer, channel_id, it->messages_len);
+            return;
         }
 
-        for (auto &new_message : *this->GetNewMessages()) {
-            free((void*)new_message.message);
+        users->AddUnacknowledgedUpdate(handle);
+
+        it->recipients_len++;
+
+        recipients.push_back((FanoutRecipient){
+            .channel = static_cast<uint32_t>(it - channels.begin()),
+            .addr_data = users->subscription_addr_data[handle].addr_data[subscription]
+        });
+    });
+
+    // Counting sort by channel, so every partition is one payload for a contiguous address list
+    uint32_t channel_offset = 0;
+
+    for (auto& channel : channels) {
+        channel.first_recipient = channel_offset;
+        channel.next_recipient = channel_offset;
+
+        channel_offset += channel.recipients_len;
+    }
+
+    recipient_addr_data.resize(recipients.size());
+
+    for (const FanoutRecipient& recipient : recipients) {
+        recipient_addr_data[channels[recipient.channel].next_recipient++] = recipient.addr_data;
+    }
+
+    partitions.clear();
+
+    for (const FanoutChannel& channel : channels) {
+        for (uint32_t first = 0; first < channel.recipients_len; first += FANOUT_PARTITION_SIZE) {
+            partitions.push_back((FanoutPartition){
+                .buffer = channel.buffer,
+                .first_recipient = channel.first_recipient + first,
+                .recipients_len = std::min<uint32_t>(FANOUT_PARTITION_SIZE, channel.recipients_len - first)
+            });
         }
+    }
+
+    const size_t partitions_len = partitions.size();
+
+    partition_times.resize(partitions_len);
 
-        this->GetNewMessages()->clear();
+    GetFanoutPool().ForEach(partitions_len, send_partition);
 
-        usleep(200000);
+    for (const uint64_t partition_time : partition_times) {
+        utils::metrics::RecordValue(metrics.fanout_partition, partition_time);
     }
+
+    const uint32_t packets_sent = recipients.size();
+
+    send_span.End();
+
+    utils::metrics::RecordValue(metrics.fanout_batch_messages, rows.size());
+    utils::metrics::RecordValue(metrics.fanout_channels, channels.size());
+    utils::metrics::RecordValue(metrics.fanout_packets, packets_sent);
+    utils::metrics::RecordValue(metrics.fanout_partitions, partitions_len);
+
+    new_messages.Clear();
+
+    utils::metrics::RecordValue(metrics.fanout_tick, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tick_start).count());
+
+    tick_span.End();
 }
 
-static void HandleLoadChannelDataRequest(HostedServer* server, SwiftNetServerPacketData* packet_data) {
-    requests::LoadChannelDataRequest* request_data = (requests::LoadChannelDataRequest*)swiftnet_server_read_packet(packet_data, sizeof(requests::LoadChannelDataRequest));
+#define CHAT_UPDATE_HEADER_SIZE (sizeof(ResponseInfo) + sizeof(responses::PeriodicChatUpdateResponse))
+
+void HostedServer::HoldBackUpdate(const ServerUserHandle handle, const transport::PacketBuffer* update, const uint32_t channel_id, const uint32_t messages_len) {
+    utils::metrics::IncrementCounter(GetServerMetrics().held_back_updates);
+
+    if (handle >= this->send_queues.size()) {
+        this->send_queues.resize(this->GetServerUsers()->GetSize(), nullptr);
+    }
+
+    UserSendQueue*& queue = this->send_queues[handle];
+
+    if (queue == nullptr) {
+        queue = new UserSendQueue();
+    }
+
+    if (!queue->lagging) {
+        queue->lagging = true;
+
+        this->lagging_users.push_back(handle);
+    }
+
+    // Past the bound nothing more is queued, DrainSendQueues resyncs the member on the next tick
+    if (!queue->Push(channel_id, update->GetData() + CHAT_UPDATE_HEADER_SIZE, update->GetSize() - CHAT_UPDATE_HEADER_SIZE, messages_len)) {
+        queue->lagging_ticks = USER_SEND_QUEUE_MAX_TICKS;
+    }
+}
+
+void HostedServer::DrainSendQueues() {
+    TRACE_SCOPE("fanout", "drain_send_queues");
+
+    const ServerMetrics& metrics = GetServerMetrics();
+
+    ServerUserTable* const users = this->GetServerUsers();
+
+    uint32_t still_lagging = 0;
+
+    for (const ServerUserHandle handle : this->lagging_users) {
+        UserSendQueue* const queue = this->send_queues[handle];
+
+        // Already resynced, the queue went with it
+        if (queue == nullptr) {
+            continue;
+        }
+
+        utils::metrics::RecordValue(metrics.user_queue_bytes, queue->bytes);
+
+        if (queue->lagging_ticks >= USER_SEND_QUEUE_MAX_TICKS) {
+            this->ResyncUser(handle);
+            continue;
+        }
+
+        if (users->GetUnacknowledgedUpdates(handle) >= USER_SEND_WINDOW) {
+            queue->lagging_ticks++;
+
+            this->lagging_users[still_lagging++] = handle;
+            continue;
+        }
+
+        // Caught up, every channel's held back updates go out as one batch
+        const UserSubscriptions& user_subscriptions = users->subscriptions[handle];
+
+        for (uint32_t i = 0; i < queue->channels_len; i++) {
+            const UserSendQueue::PendingChannel& pending = queue->channels[i];
+
+            for (uint32_t subscription = 0; subscription < user_subscriptions.len; subscription++) {
+                if (user_subscriptions.channel_ids[subscription] != pending.channel_id) {
+                    continue;
+                }
+
+                const ResponseInfo response_info = {
+                    .request_type = RequestType::PERIODIC_CHAT_UPDATE,
+                    .request_status = Status::SUCCESS
+                };
+
+                const responses::PeriodicChatUpdateResponse response = {
+                    .channel_messages_len = pending.messages_len
+                };
+
+                transport::PooledPacketBuffer buffer(CHAT_UPDATE_HEADER_SIZE + pending.messages.size());
+
+                buffer->Append(&response_info, sizeof(response_info));
+                buffer->Append(&response, sizeof(response));
+                buffer->Append(pending.messages.data(), pending.messages.size());
+
+                this->GetServer()->SendPacket(buffer.Get(), users->subscription_addr_data[handle].addr_data[subscription]);
+
+                users->AddUnacknowledgedUpdate(handle);
+
+                utils::metrics::IncrementCounter(metrics.catch_up_batches);
+
+                break;
+            }
+        }
+
+        queue->Clear();
+    }
+
+    this->lagging_users.resize(still_lagging);
+}
+
+// Tells each of the member's chat panels to reload, then stops sending to it until it subscribes again
+void HostedServer::ResyncUser(const ServerUserHandle handle) {
+    ServerUserTable* const users = this->GetServerUsers();
+
+    LOG_INFO(SERVER, "User %u fell behind on chat updates, resyncing", users->rows[handle].id);
+
+    utils::metrics::IncrementCounter(GetServerMetrics().resyncs);
+
+    const ResponseInfo response_info = {
+        .request_type = RequestType::PERIODIC_CHAT_UPDATE,
+        .request_status = Status::FAIL
+    };
+
+    const responses::PeriodicChatUpdateResponse response = {
+        .channel_messages_len = 0
+    };
+
+    transport::PooledPacketBuffer buffer(CHAT_UPDATE_HEADER_SIZE);
 
-    Database* database = wxGetApp().GetDatabase();
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response, sizeof(response));
 
-    ServerUser* user = server->GetUserByAddrData(packet_data->metadata.sender);
-    if (user == nullptr) {
-        printf("User is not registered as member of this server\n");
-        swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    const UserSubscriptions& user_subscriptions = users->subscriptions[handle];
+
+    for (uint32_t i = 0; i < user_subscriptions.len; i++) {
+        this->GetServer()->SendPacket(buffer.Get(), users->subscription_addr_data[handle].addr_data[i]);
+    }
+
+    users->UnsubscribeAll(handle);
+    users->ResetUnacknowledgedUpdates(handle);
+
+    delete this->send_queues[handle];
+
+    this->send_queues[handle] = nullptr;
+}
+
+static void HandleLoadChannelDataRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleLoadChannelDataRequest");
+
+    requests::LoadChannelDataRequest* request_data = (requests::LoadChannelDataRequest*)packet_data->Read(sizeof(requests::LoadChannelDataRequest));
+
+    Database* database = server->GetDatabase();
+
+    ServerUserTable* const users = server->GetServerUsers();
+
+    const ServerUserHandle user = server->GetUserByAddrData(packet_data->GetSender());
+    if (user == INVALID_SERVER_USER_HANDLE) {
+        LOG_WARN(SERVER, "Channel data requested by a non member");
+        CountRequestError(LOAD_CHANNEL_DATA);
+        delete packet_data;
         return;
     }
 
-    if (user->status == ServerUserStatus::ONLINE) {
-        user->active_channel_id = request_data->channel_id;
+    if (request_data->subscribe) {
+        if (users->statuses[user] != ServerUserStatus::ONLINE) {
+            users->addr_data[user] = packet_data->GetSender();
+            LOG_DEBUG(SERVER, "User %u came online", users->rows[user].id);
+            users->MarkOnline(user);
+        }
+
+        users->Subscribe(user, request_data->channel_id, packet_data->GetSender());
+    }
+
+    // Ask for one row past the page to know whether the client has to come back for more
+    const std::optional<uint32_t> limit = request_data->limit > 0 ? std::optional<uint32_t>(request_data->limit + 1) : std::nullopt;
+
+    // Reused by every request this thread handles
+    static thread_local ChannelMessageBatch channel_messages;
+
+    const bool newest = request_data->newest && limit.has_value();
+
+    if (newest) {
+        database->SelectNewestChannelMessages(request_data->channel_id, request_data->after_message_id, limit.value(), &channel_messages);
     } else {
-        user->addr_data = packet_data->metadata.sender;
-        printf("Setting addr data\n");
-        server->MarkUserOnline(user);
-        user->active_channel_id = request_data->channel_id;
+        database->SelectChannelMessages(std::nullopt, nullptr, std::nullopt, request_data->channel_id, request_data->after_message_id, limit, &channel_messages);
     }
 
-    auto channel_messages = database->SelectChannelMessages(std::nullopt, nullptr, std::nullopt, request_data->channel_id);
+    std::vector<Database::ChannelMessageRow>& rows = channel_messages.rows;
+
+    // The extra row is past the end of a forward page, and before the start of a newest page
+    const bool has_more = limit.has_value() && rows.size() > request_data->limit;
+    if (has_more && newest) {
+        rows.erase(rows.begin());
+    } else if (has_more) {
+        rows.pop_back();
+    }
 
     uint32_t bytes_to_allocate = (sizeof(responses::LoadChannelDataResponse) + sizeof(ResponseInfo));
 
-    for (auto &message : *channel_messages) {
-        bytes_to_allocate += sizeof(message.id) + sizeof(message.sender_id) + sizeof(message.message_length) + sizeof(message.sender_username) + message.message_length + 1;
+    for (auto &message : rows) {
+        bytes_to_allocate += GetSerializedChannelMessageSize(message);
     }
 
     const ResponseInfo response_info = {
@@ -174,38 +792,38 @@ static void HandleLoadChannelDataRequest(HostedServer* server, SwiftNetServerPac
     };
 
     const responses::LoadChannelDataResponse response_request_data = {
-        .channel_messages_len = (uint32_t)channel_messages->size()
+        .channel_messages_len = (uint32_t)rows.size(),
+        .has_more = has_more
     };
 
-    SwiftNetPacketBuffer buffer = swiftnet_server_create_packet_buffer(bytes_to_allocate);
-
-    swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &buffer);
-    swiftnet_server_append_to_packet(&response_request_data, sizeof(response_request_data), &buffer);
+    transport::PooledPacketBuffer buffer(bytes_to_allocate);
 
-    SerializeChannelMessages(&buffer, channel_messages);
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response_request_data, sizeof(response_request_data));
 
-    swiftnet_server_make_response(server->GetServer(), packet_data, &buffer);
+    SerializeChannelMessages(buffer.Get(), rows.data(), rows.size());
 
-    swiftnet_server_destroy_packet_buffer(&buffer);
-    swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    server->GetServer()->MakeResponse(packet_data, buffer.Get());
 
-    for (auto& message : *channel_messages) {
-        free((void*)message.message);
-    }
+    delete packet_data;
 
-    delete channel_messages;
+    channel_messages.Clear();
 }
 
-static void HandleJoinServerRequest(HostedServer* server, SwiftNetServerPacketData* packet_data) {
-    const in_addr ip_address = packet_data->metadata.sender.sender_address;
+static void HandleJoinServerRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleJoinServerRequest");
+
+    const in_addr ip_address = packet_data->GetSender().sender_address;
     const uint16_t server_id = server->GetServerId();
 
-    const char* username = (const char*)swiftnet_server_read_packet(packet_data, 20);
+    const char* username = (const char*)packet_data->Read(20);
 
-    printf("Inserting user: %s %d\n", username, ip_address.s_addr);
+    LOG_DEBUG(SERVER, "Inserting user: %.20s %u", username, ip_address.s_addr);
 
-    auto result = wxGetApp().GetDatabase()->InsertHostedServerUser(server_id, ip_address, username);
+    auto result = server->GetDatabase()->InsertHostedServerUser(server_id, ip_address, username);
     if (!result.has_value()) {
+        CountRequestError(JOIN_SERVER);
+
         const ResponseInfo response_info = {
             .request_type = RequestType::JOIN_SERVER,
             .request_status = Status::FAIL
@@ -214,18 +832,19 @@ static void HandleJoinServerRequest(HostedServer* server, SwiftNetServerPacketDa
         const responses::JoinServerResponse response = {
         };
 
-        SwiftNetPacketBuffer buffer = swiftnet_server_create_packet_buffer(sizeof(response) + sizeof(response_info));
+        transport::PooledPacketBuffer buffer(sizeof(response) + sizeof(response_info));
 
-        swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &buffer);
-        swiftnet_server_append_to_packet(&response, sizeof(response), &buffer);
+        buffer->Append(&response_info, sizeof(response_info));
+        buffer->Append(&response, sizeof(response));
 
-        swiftnet_server_make_response(server->GetServer(), packet_data, &buffer);
+        server->GetServer()->MakeResponse(packet_data, buffer.Get());
 
-        swiftnet_server_destroy_packet_buffer(&buffer);
-        swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+        delete packet_data;
+
+        return;
     }
 
-    SwiftNetPacketBuffer buffer = swiftnet_server_create_packet_buffer(sizeof(responses::JoinServerResponse) + sizeof(ResponseInfo));
+    transport::PooledPacketBuffer buffer(sizeof(responses::JoinServerResponse) + sizeof(ResponseInfo));
 
     const ResponseInfo response_info = {
         .request_type = RequestType::JOIN_SERVER,
@@ -235,21 +854,23 @@ static void HandleJoinServerRequest(HostedServer* server, SwiftNetServerPacketDa
     const responses::JoinServerResponse response = {
     };
 
-    swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &buffer);
-    swiftnet_server_append_to_packet(&response, sizeof(response), &buffer);
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response, sizeof(response));
 
-    swiftnet_server_make_response(server->GetServer(), packet_data, &buffer);
+    server->GetServer()->MakeResponse(packet_data, buffer.Get());
 
-    server->GetServerUsers()->push_back((ServerUser){.data = result.value(), .status = ServerUserStatus::OFFLINE, .addr_data = packet_data->metadata.sender});
+    server->GetServerUsers()->Add(result.value(), ServerUserStatus::OFFLINE, packet_data->GetSender());
+    server->GetUserDirectory()->SetUsername(result->id, std::string_view(result->username, sizeof(result->username)));
 
-    swiftnet_server_destroy_packet_buffer(&buffer);
-    swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    delete packet_data;
 }
 
-static void HandleLoadAdminMenuDataRequest(HostedServer* server, SwiftNetServerPacketData* packet_data) {
-    auto const request = (requests::LoadAdminMenuDataRequest*)swiftnet_server_read_packet(packet_data, sizeof(requests::LoadAdminMenuDataRequest));
+static void HandleLoadAdminMenuDataRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleLoadAdminMenuDataRequest");
 
-    auto channels = wxGetApp().GetDatabase()->SelectServerChatChannels(std::nullopt, nullptr, server->GetServerId());
+    auto const request = (requests::LoadAdminMenuDataRequest*)packet_data->Read(sizeof(requests::LoadAdminMenuDataRequest));
+
+    auto channels = server->GetDatabase()->SelectServerChatChannels(std::nullopt, nullptr, server->GetServerId());
 
     ResponseInfo response_info = {
         .request_status = Status::SUCCESS,
@@ -260,27 +881,28 @@ static void HandleLoadAdminMenuDataRequest(HostedServer* server, SwiftNetServerP
         .channels_size = static_cast<uint32_t>(channels->size())
     };
     
-    SwiftNetPacketBuffer buffer = swiftnet_server_create_packet_buffer(sizeof(responses::LoadAdminMenuDataResponse) + sizeof(ResponseInfo) + (channels->size() * (sizeof(objects::Database::ServerChatChannelRow))));
+    transport::PooledPacketBuffer buffer(sizeof(responses::LoadAdminMenuDataResponse) + sizeof(ResponseInfo) + (channels->size() * (sizeof(objects::Database::ServerChatChannelRow))));
 
-    swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &buffer);
-    swiftnet_server_append_to_packet(&response, sizeof(response), &buffer);
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response, sizeof(response));
 
     for (auto &channel : *channels) {
-        swiftnet_server_append_to_packet(&channel, sizeof(channel), &buffer);
+        buffer->Append(&channel, sizeof(channel));
     }
 
-    swiftnet_server_make_response(server->GetServer(), packet_data, &buffer);
+    server->GetServer()->MakeResponse(packet_data, buffer.Get());
 
-    swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
-    swiftnet_server_destroy_packet_buffer(&buffer);
+    delete packet_data;
 
     delete channels;
 }
 
-static void HandleLoadServerInformationRequest(HostedServer* server, SwiftNetServerPacketData* packet_data) {
-    auto server_chat_channels = wxGetApp().GetDatabase()->SelectServerChatChannels(std::nullopt, nullptr, server->GetServerId());
+static void HandleLoadServerInformationRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleLoadServerInformationRequest");
+
+    auto server_chat_channels = server->GetDatabase()->SelectServerChatChannels(std::nullopt, nullptr, server->GetServerId());
 
-    SwiftNetServer* server_swiftnet = server->GetServer();
+    transport::ServerTransport* server_transport = server->GetServer();
 
     const uint32_t size = server_chat_channels->size();
 
@@ -294,32 +916,32 @@ static void HandleLoadServerInformationRequest(HostedServer* server, SwiftNetSer
         .server_chat_channels_size = size
     };
 
-    SwiftNetPacketBuffer buffer = swiftnet_server_create_packet_buffer(bytes_to_alloc + sizeof(response_info));
+    transport::PooledPacketBuffer buffer(bytes_to_alloc + sizeof(response_info));
 
-    swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &buffer);
-    swiftnet_server_append_to_packet(&response_data, sizeof(response_data), &buffer);
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response_data, sizeof(response_data));
 
     if (size > 0) {
-        swiftnet_server_append_to_packet(server_chat_channels->data(), size * sizeof(Database::ServerChatChannelRow), &buffer);
+        buffer->Append(server_chat_channels->data(), size * sizeof(Database::ServerChatChannelRow));
 
-        for (auto &channel : *server_chat_channels) {
-            printf("%s, %d, %d\n", channel.name, channel.id, channel.hosted_server_id);
-        }
+        LOG_DEBUG(SERVER, "Sending %u channels", size);
     }
 
-    swiftnet_server_make_response(server_swiftnet, packet_data, &buffer);
+    server_transport->MakeResponse(packet_data, buffer.Get());
 
-    swiftnet_server_destroy_packet_buffer(&buffer);
-    swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    delete packet_data;
 
     delete server_chat_channels;
 }
 
-static void HandleLoadJoinedServerDataRequest(HostedServer* server, SwiftNetServerPacketData* packet_data) {
-    const in_addr sender = packet_data->metadata.sender.sender_address;
+static void HandleLoadJoinedServerDataRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleLoadJoinedServerDataRequest");
 
-    auto query_result = wxGetApp().GetDatabase()->SelectHostedServerUsers(server->GetServerId(), std::nullopt, nullptr, sender.s_addr);
+    const in_addr sender = packet_data->GetSender().sender_address;
+
+    auto query_result = server->GetDatabase()->SelectHostedServerUsers(server->GetServerId(), std::nullopt, nullptr, sender.s_addr);
     if (query_result->size() == 0) {
+        CountRequestError(LOAD_JOINED_SERVER_DATA);
         return;
     }
 
@@ -332,63 +954,80 @@ static void HandleLoadJoinedServerDataRequest(HostedServer* server, SwiftNetServ
         .request_type = RequestType::LOAD_JOINED_SERVER_DATA
     };
 
-    std::cout << "User type: " << member.user_type << std::endl;
-    std::cout << "Admin User type: " << Database::UserType::Admin << std::endl;
-    std::cout << "Is admin: " << (member.user_type == Database::UserType::Admin) << std::endl;;
+    LOG_DEBUG(SERVER, "User %u is admin: %d", member.id, member.user_type == Database::UserType::Admin);
 
     const responses::LoadJoinedServerDataResponse response = {
         .admin = member.user_type == Database::UserType::Admin
     };
 
-    SwiftNetPacketBuffer buffer = swiftnet_server_create_packet_buffer(sizeof(response_info) + sizeof(response));
+    transport::PooledPacketBuffer buffer(sizeof(response_info) + sizeof(response));
 
-    swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &buffer);
-    swiftnet_server_append_to_packet(&response, sizeof(response), &buffer);
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response, sizeof(response));
 
-    swiftnet_server_make_response(server->GetServer(), packet_data, &buffer);
+    server->GetServer()->MakeResponse(packet_data, buffer.Get());
 
-    swiftnet_server_destroy_packet_buffer(&buffer);
-    swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    delete packet_data;
 
     return;
 }
 
-static void HandleSendMessageRequest(HostedServer* server, SwiftNetServerPacketData* packet_data) {
-    requests::SendMessageRequest* request = (requests::SendMessageRequest*)swiftnet_server_read_packet(packet_data, sizeof(requests::SendMessageRequest));
+static void HandleSendMessageRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleSendMessageRequest");
 
-    const char* message = (const char*)swiftnet_server_read_packet(packet_data, request->message_len);
+    requests::SendMessageRequest* request = (requests::SendMessageRequest*)packet_data->Read(sizeof(requests::SendMessageRequest));
 
-    ServerUser* user = server->GetUserByAddrData(packet_data->metadata.sender);
-    if (user == nullptr || user->status == ServerUserStatus::OFFLINE) {
-        std::cout << "User not connected" << std::endl;
+    const char* message = (const char*)packet_data->Read(request->message_len);
 
-        swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    ServerUserTable* const users = server->GetServerUsers();
 
-        return;
-    }
+    const ServerUserHandle user = server->GetUserByAddrData(packet_data->GetSender());
+    if (user == INVALID_SERVER_USER_HANDLE || users->statuses[user] == ServerUserStatus::OFFLINE) {
+        LOG_DEBUG(SERVER, "Message from a user that is not connected");
+
+        CountRequestError(SEND_MESSAGE);
 
-    char* message_clone = (char*)malloc(request->message_len);
+        delete packet_data;
 
-    memcpy(message_clone, message, request->message_len);
+        return;
+    }
 
-    auto result = wxGetApp().GetDatabase()->InsertChannelMessage(message_clone, request->channel_id, user->data.id);
+    // The row points into the packet, AddNewMessage copies the text before the packet is deleted
+    auto result = server->GetDatabase()->InsertChannelMessage(message, request->channel_id, users->rows[user].id);
 
     if (result.has_value()) {
-        printf("new message username: %s\n", result.value().sender_username);
-        server->GetNewMessages()->push_back(result.value());
+        server->AddNewMessage(result.value());
     } else {
-        free(message_clone);
+        CountRequestError(SEND_MESSAGE);
     }
 
-    server->MarkUserOnline(user);
+    users->MarkOnline(user);
 
-    swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    delete packet_data;
 }
 
-static void HandleCreateNewChannelRequest(HostedServer* server, SwiftNetServerPacketData* packet_data) {
-    auto request = (requests::CreateNewChannelRequest*)swiftnet_server_read_packet(packet_data, sizeof(requests::CreateNewChannelRequest));
+static void HandleLeaveChannelRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleLeaveChannelRequest");
 
-    int result = wxGetApp().GetDatabase()->InsertServerChatChannel(request->name, server->GetServerId());
+    auto request = (requests::LeaveChannelRequest*)packet_data->Read(sizeof(requests::LeaveChannelRequest));
+
+    const ServerUserHandle user = server->GetUserByAddrData(packet_data->GetSender());
+    if (user != INVALID_SERVER_USER_HANDLE) {
+        server->GetServerUsers()->Unsubscribe(user, request->channel_id);
+    }
+
+    delete packet_data;
+}
+
+static void HandleCreateNewChannelRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleCreateNewChannelRequest");
+
+    auto request = (requests::CreateNewChannelRequest*)packet_data->Read(sizeof(requests::CreateNewChannelRequest));
+
+    int result = server->GetDatabase()->InsertServerChatChannel(request->name, server->GetServerId());
+    if (result != 0) {
+        CountRequestError(CREATE_NEW_CHANNEL);
+    }
 
     const ResponseInfo response_info = {
         .request_status = result == 0 ? Status::SUCCESS : Status::FAIL,
@@ -397,29 +1036,145 @@ static void HandleCreateNewChannelRequest(HostedServer* server, SwiftNetServerPa
 
     const responses::CreateNewChannelResponse response = {};
 
-    auto buffer = swiftnet_server_create_packet_buffer(sizeof(response_info) + sizeof(response));
+    transport::PooledPacketBuffer buffer(sizeof(response_info) + sizeof(response));
+
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response, sizeof(response));
+
+    server->GetServer()->MakeResponse(packet_data, buffer.Get());
+
+    delete packet_data;
+}
+
+// Only answered for clients on this host, the snapshot covers every server in the process
+static void HandleLoadServerStatsRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleLoadServerStatsRequest");
+
+    const in_addr sender = packet_data->GetSender().sender_address;
+
+    const bool local = (ntohl(sender.s_addr) >> 24) == 127;
+    if (!local) {
+        CountRequestError(LOAD_SERVER_STATS);
+    }
+
+    const std::string snapshot = local ? utils::metrics::FormatSnapshot() + utils::alloc::FormatStats() : std::string();
+
+    const ResponseInfo response_info = {
+        .request_type = RequestType::LOAD_SERVER_STATS,
+        .request_status = local ? Status::SUCCESS : Status::FAIL
+    };
+
+    const responses::LoadServerStatsResponse response = {
+        .snapshot_len = local ? static_cast<uint32_t>(snapshot.size() + 1) : 0
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(response_info) + sizeof(response) + response.snapshot_len);
 
-    swiftnet_server_append_to_packet(&response_info, sizeof(response_info), &buffer);
-    swiftnet_server_append_to_packet(&response, sizeof(response), &buffer);
+    buffer->Append(&response_info, sizeof(response_info));
+    buffer->Append(&response, sizeof(response));
+    buffer->Append(snapshot.c_str(), response.snapshot_len);
 
-    swiftnet_server_make_response(server->GetServer(), packet_data, &buffer);
+    server->GetServer()->MakeResponse(packet_data, buffer.Get());
 
-    swiftnet_server_destroy_packet_buffer(&buffer);
-    swiftnet_server_destroy_packet_data(packet_data, server->GetServer());
+    delete packet_data;
 }
 
-static void PacketCallback(SwiftNetServerPacketData* packet_data, void* const user) {
-    const uint16_t server_id = packet_data->metadata.port_info.destination_port;
+static void HandleAcknowledgeChatUpdateRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleAcknowledgeChatUpdateRequest");
 
-    HostedServer* server = wxGetApp().GetHomeFrame()->GetHostingPanel()->GetServerById(server_id);
-    if (server == nullptr) {
-        printf("null server\n");
+    auto request = (requests::AcknowledgeChatUpdateRequest*)packet_data->Read(sizeof(requests::AcknowledgeChatUpdateRequest));
+
+    const ServerUserHandle user = server->GetUserByAddrData(packet_data->GetSender());
+    if (request == nullptr || user == INVALID_SERVER_USER_HANDLE) {
+        CountRequestError(ACKNOWLEDGE_CHAT_UPDATE);
+        delete packet_data;
         return;
     }
 
-    RequestInfo* request_info = (RequestInfo*)swiftnet_server_read_packet(packet_data, sizeof(RequestInfo));
+    server->GetServerUsers()->AcknowledgeUpdate(user);
+
+    delete packet_data;
+}
+
+// Clients fetch this once per server and again only when a message comes from someone they don't know
+static void HandleLoadUserRosterRequest(HostedServer* server, transport::Packet* packet_data) {
+    TRACE_SCOPE("handler", "HandleLoadUserRosterRequest");
+
+    UserDirectory* const user_directory = server->GetUserDirectory();
+
+    const ResponseInfo response_info = {
+        .request_type = RequestType::LOAD_USER_ROSTER,
+        .request_status = Status::SUCCESS
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(response_info) + user_directory->GetSerializedSize());
+
+    buffer->Append(&response_info, sizeof(response_info));
+
+    user_directory->Serialize(buffer.Get());
+
+    server->GetServer()->MakeResponse(packet_data, buffer.Get());
+
+    delete packet_data;
+}
+
+// Answers the request with RATE_LIMITED and deletes it
+static void RejectRequest(HostedServer* server, transport::Packet* packet_data, const RequestType request_type) {
+    utils::metrics::IncrementCounter(GetServerMetrics().request_types[request_type].rejected);
+
+    const ResponseInfo response_info = {
+        .request_type = request_type,
+        .request_status = Status::RATE_LIMITED
+    };
+
+    transport::PooledPacketBuffer buffer(sizeof(response_info));
+
+    buffer->Append(&response_info, sizeof(response_info));
+
+    if (request_policies[request_type].has_response) {
+        server->GetServer()->MakeResponse(packet_data, buffer.Get());
+    } else {
+        server->GetServer()->SendPacket(buffer.Get(), packet_data->GetSender());
+    }
+
+    delete packet_data;
+}
+
+// Sheds expensive work while the handler is behind, then charges the sender's and the server's bucket.
+// Runs on the transport thread before the request is queued. A rejected request is answered and deleted here.
+static bool AdmitRequest(HostedServer* server, transport::Packet* packet_data, const RequestType request_type) {
+    const RequestPolicy& policy = request_policies[request_type];
+
+    const auto now = std::chrono::steady_clock::now();
+
+    bool admitted = true;
 
-    switch (request_info->request_type) {
+    if (policy.cost == EXPENSIVE_REQUEST && server->GetQueuedRequests() > SERVER_SHED_QUEUE_DEPTH) {
+        utils::metrics::IncrementCounter(GetServerMetrics().shed_requests);
+
+        admitted = false;
+    }
+
+    if (admitted) {
+        RequestBudget* const budget = server->GetSenderBudget(packet_data->GetSender().sender_address);
+
+        // The sender's bucket goes first, so one flooder does not drain what everyone else shares
+        if (budget != nullptr && !budget->buckets[policy.cost].TryTake(now)) {
+            admitted = false;
+        } else if (!server->GetRequestBucket(policy.cost)->TryTake(now)) {
+            admitted = false;
+        }
+    }
+
+    if (!admitted) {
+        RejectRequest(server, packet_data, request_type);
+    }
+
+    return admitted;
+}
+
+static void HandleRequest(HostedServer* server, transport::Packet* packet_data, const RequestType request_type) {
+    switch (request_type) {
         case JOIN_SERVER: HandleJoinServerRequest(server, packet_data); break;
         case LOAD_SERVER_INFORMATION: HandleLoadServerInformationRequest(server, packet_data); break;
         case LOAD_CHANNEL_DATA: HandleLoadChannelDataRequest(server, packet_data); break;
@@ -427,98 +1182,367 @@ static void PacketCallback(SwiftNetServerPacketData* packet_data, void* const us
         case LOAD_JOINED_SERVER_DATA: HandleLoadJoinedServerDataRequest(server, packet_data); break;
         case LOAD_ADMIN_MENU_DATA: HandleLoadAdminMenuDataRequest(server, packet_data); break;
         case CREATE_NEW_CHANNEL: HandleCreateNewChannelRequest(server, packet_data); break;
-        default: break;
+        case LEAVE_CHANNEL: HandleLeaveChannelRequest(server, packet_data); break;
+        case LOAD_SERVER_STATS: HandleLoadServerStatsRequest(server, packet_data); break;
+        case LOAD_USER_ROSTER: HandleLoadUserRosterRequest(server, packet_data); break;
+        case ACKNOWLEDGE_CHAT_UPDATE: HandleAcknowledgeChatUpdateRequest(server, packet_data); break;
+        default: delete packet_data; break;
+    }
+}
+
+// Runs on the transport thread, admits the packet and sorts it into its class queue so a long handler never holds up reading
+static void PacketCallback(transport::Packet* packet_data, void* const user) {
+    ALLOC_SCOPE(SERVER);
+
+    HostedServer* const server = static_cast<HostedServer*>(user);
+
+    const ServerMetrics& metrics = GetServerMetrics();
+
+    RequestInfo* request_info = (RequestInfo*)packet_data->Read(sizeof(RequestInfo));
+    if (request_info == nullptr || request_info->request_type >= REQUEST_TYPES_LEN) {
+        utils::metrics::IncrementCounter(metrics.unknown_requests);
+        delete packet_data;
+        return;
+    }
+
+    const RequestType request_type = request_info->request_type;
+
+    utils::metrics::IncrementCounter(metrics.request_types[request_type].requests);
+
+    // Rejected before it takes a queue slot, so a flooding sender can't fill the queues everyone else waits in
+    if (!AdmitRequest(server, packet_data, request_type)) {
+        return;
+    }
+
+    if (!server->QueueRequest(packet_data, request_type, request_policies[request_type].request_class)) {
+        utils::metrics::IncrementCounter(metrics.shed_requests);
+
+        RejectRequest(server, packet_data, request_type);
     }
 }
 
-HostedServer::HostedServer(uint16_t id) : id(id) {
+bool HostedServer::QueueRequest(transport::Packet* packet, const RequestType request_type, const RequestClass request_class) {
+    ScheduledRequest request = {
+        .packet = packet,
+        .request_type = request_type,
+        .queued_at = std::chrono::steady_clock::now()
+    };
 
+    if (!this->request_queues[request_class].TryPush(std::move(request))) {
+        return false;
+    }
+
+    const uint32_t queue_depth = this->queued_requests[request_class].fetch_add(1, std::memory_order_release) + 1;
+
+    utils::metrics::RecordValue(GetServerMetrics().request_classes[request_class].queue_depth, queue_depth);
+
+    // The server task only stops draining once every class is empty, so it needs waking only when one stops being empty
+    if (queue_depth == 1) {
+        utils::concurrency::GetReactor().Wake(this->server_task);
+    }
+
+    return true;
+}
+
+bool HostedServer::TakeNextRequest(ScheduledRequest& request) {
+    uint32_t queued[REQUEST_CLASSES_LEN];
+
+    bool any_queued = false;
+
+    for (uint32_t i = 0; i < REQUEST_CLASSES_LEN; i++) {
+        queued[i] = this->queued_requests[i].load(std::memory_order_acquire);
+
+        any_queued = any_queued || queued[i] > 0;
+    }
+
+    if (!any_queued) {
+        return false;
+    }
+
+    // A class that waited through its share goes first, otherwise the highest class with work
+    uint32_t chosen = REQUEST_CLASSES_LEN;
+
+    for (uint32_t i = 0; i < REQUEST_CLASSES_LEN; i++) {
+        if (queued[i] > 0 && this->passed_over[i] >= request_class_shares[i]) {
+            chosen = i;
+            break;
+        }
+    }
+
+    if (chosen == REQUEST_CLASSES_LEN) {
+        for (uint32_t i = 0; i < REQUEST_CLASSES_LEN; i++) {
+            if (queued[i] > 0) {
+                chosen = i;
+                break;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < REQUEST_CLASSES_LEN; i++) {
+        this->passed_over[i] = i != chosen && queued[i] > 0 ? this->passed_over[i] + 1 : 0;
+    }
+
+    this->request_queues[chosen].TryPop(request);
+
+    this->queued_requests[chosen].fetch_sub(1, std::memory_order_relaxed);
+
+    return true;
+}
+
+void HostedServer::RunRequest(const ScheduledRequest& request) {
+    const ServerMetrics& metrics = GetServerMetrics();
+
+    const RequestClassMetrics& class_metrics = metrics.request_classes[request_policies[request.request_type].request_class];
+
+    const auto started_at = std::chrono::steady_clock::now();
+
+    utils::metrics::RecordValue(class_metrics.wait, std::chrono::duration_cast<std::chrono::nanoseconds>(started_at - request.queued_at).count());
+
+    {
+        utils::metrics::ScopedTimer request_timer(metrics.request_types[request.request_type].latency);
+
+        TRACE_SCOPE("server", "HandleRequest");
+
+        HandleRequest(this, request.packet, request.request_type);
+    }
+
+    utils::metrics::RecordValue(class_metrics.latency, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - request.queued_at).count());
+}
+
+void HostedServer::RunQueuedRequests() {
+    ALLOC_SCOPE(SERVER);
+
+    ScheduledRequest request;
+
+    for (uint32_t handled = 0; handled < SCHEDULER_BATCH_SIZE; handled++) {
+        if (!this->TakeNextRequest(request)) {
+            return;
+        }
+
+        this->RunRequest(request);
+    }
+
+    // Queued behind other servers' work instead of holding the reactor thread, the run picks up where this one stopped
+    utils::concurrency::GetReactor().Wake(this->server_task);
+}
+
+void HostedServer::RunServerTask() {
+    this->RunQueuedRequests();
+
+    const auto now = std::chrono::steady_clock::now();
+
+    // Runs woken by requests come between ticks, the deadline check keeps the tick on its own interval
+    if (now >= this->next_tick) {
+        this->next_tick = utils::concurrency::Reactor::GetAlignedDeadline(std::chrono::milliseconds(HOSTED_SERVER_TICK_MS), now);
+
+        this->Tick();
+    }
+}
+
+uint32_t HostedServer::GetQueuedRequests() {
+    uint32_t queued = this->GetServer()->GetQueuedPackets();
+
+    for (auto& class_queued : this->queued_requests) {
+        queued += class_queued.load(std::memory_order_relaxed);
+    }
+
+    return queued;
+}
+
+HostedServer::HostedServer(uint16_t id, Database* database) : id(id), database(database) {
+    const std::string metric_prefix = "server." + std::to_string(id);
+
+    this->online_users_gauge = utils::metrics::RegisterGauge((metric_prefix + ".online_users").c_str());
+    this->members_gauge = utils::metrics::RegisterGauge((metric_prefix + ".members").c_str());
+    this->lagging_users_gauge = utils::metrics::RegisterGauge((metric_prefix + ".lagging_users").c_str());
+
+    this->request_buckets[CHEAP_REQUEST] = utils::rate_limit::TokenBucket(SERVER_CHEAP_REQUESTS_RATE, SERVER_CHEAP_REQUESTS_BURST);
+    this->request_buckets[EXPENSIVE_REQUEST] = utils::rate_limit::TokenBucket(SERVER_EXPENSIVE_REQUESTS_RATE, SERVER_EXPENSIVE_REQUESTS_BURST);
 };
 
 HostedServer::~HostedServer() = default;
 
-void HostedServer::StartServer() {
-    this->status = HostedServerStatus::RUNNING;
+bool HostedServer::StartServer() {
+    this->status = HostedServerStatus::STARTING;
 
-    SwiftNetServer* const new_server = swiftnet_create_server(this->GetServerId(), LOOPBACK);
+    transport::ServerTransport* const new_server = transport::CreateServer(this->GetServerId());
     if (new_server == nullptr) {
-        printf("Failed to create new server\n");
+        LOG_ERROR(SERVER, "Failed to create server %u", this->GetServerId());
 
-        exit(EXIT_FAILURE);
+        this->status = HostedServerStatus::STOPPED;
+
+        return false;
     }
 
-    swiftnet_server_set_message_handler(new_server, PacketCallback, nullptr);
+    new_server->SetMessageHandler(PacketCallback, this);
 
     this->server = new_server;
 
-    auto users = wxGetApp().GetDatabase()->SelectHostedServerUsers(this->GetServerId(), std::nullopt, nullptr, std::nullopt);
+    auto users = this->GetDatabase()->SelectHostedServerUsers(this->GetServerId(), std::nullopt, nullptr, std::nullopt);
     for (auto &user : *users) {
-        this->GetServerUsers()->push_back((ServerUser){
-            .data = user,
-            .status = ServerUserStatus::OFFLINE
-        });
+        this->GetServerUsers()->Add(user, ServerUserStatus::OFFLINE, (transport::ClientAddrData){});
+
+        this->GetUserDirectory()->SetUsername(user.id, std::string_view(user.username, sizeof(user.username)));
     }
 
-    atomic_store_explicit(&this->stop_background_processes, false, memory_order_release);
+    delete users;
 
-    this->background_processes_thread = new std::thread([this]() {
-        this->BackgroundProcesses();
-    });
+    this->fanout_state = new FanoutState();
 
-    wxGetApp().GetHomeFrame()->GetHostingPanel()->DrawServers();
+    utils::concurrency::Reactor& reactor = utils::concurrency::GetReactor();
+
+    this->next_tick = utils::concurrency::Reactor::GetAlignedDeadline(std::chrono::milliseconds(HOSTED_SERVER_TICK_MS), std::chrono::steady_clock::now());
+
+    this->server_task = reactor.AddTask([](void* context) {
+        static_cast<HostedServer*>(context)->RunServerTask();
+    }, this, std::chrono::milliseconds(HOSTED_SERVER_TICK_MS));
+
+    // Requests that arrived while the members were loading
+    reactor.Wake(this->server_task);
+
+    this->status = HostedServerStatus::RUNNING;
+
+    return true;
 }
 
 void HostedServer::StopServer() {
-    this->status = HostedServerStatus::STOPPED;
+    this->status = HostedServerStatus::STOPPING;
 
-    swiftnet_server_cleanup(this->GetServer());
+    utils::concurrency::Reactor& reactor = utils::concurrency::GetReactor();
 
-    this->server = nullptr;
+    // Stop taking requests, those already queued are still answered
+    this->GetServer()->SetMessageHandler(nullptr, nullptr);
+
+    reactor.RemoveTask(this->server_task);
 
-    this->server_users.clear();
+    // With the task gone this thread is the only consumer of the queues and the only user of the table
+    ScheduledRequest request;
 
-    atomic_store_explicit(&this->stop_background_processes, true, memory_order_release);
+    while (this->TakeNextRequest(request)) {
+        this->RunRequest(request);
+    }
 
-    this->background_processes_thread->join();
+    // One last tick sends what those requests added, before the transport it sends through goes away
+    this->Tick();
 
-    delete this->background_processes_thread;
+    // Checks handed over earlier still use the transport
+    GetOnlineCheckRunner().Wait(this);
 
-    this->background_processes_thread = nullptr;
+    this->online_checks.clear();
+    this->online_checks_answered.store(false, std::memory_order_relaxed);
+    this->online_checks_sent = false;
 
-    wxGetApp().GetHomeFrame()->GetHostingPanel()->DrawServers();
-}
+    delete this->fanout_state;
 
-ServerUser* HostedServer::GetUserByAddrData(const SwiftNetClientAddrData addr_data) {
-    for (auto &user : *this->GetServerUsers()) {
-        if (user.data.ip_address.s_addr == addr_data.sender_address.s_addr) {
-            return &user;
+    this->fanout_state = nullptr;
+
+    // A callback still running when the handler was cleared may have queued one more, freed while its transport exists
+    for (uint32_t i = 0; i < REQUEST_CLASSES_LEN; i++) {
+        while (this->request_queues[i].TryPop(request)) {
+            delete request.packet;
         }
+
+        this->queued_requests[i].store(0, std::memory_order_relaxed);
+        this->passed_over[i] = 0;
+    }
+
+    delete this->GetServer();
+
+    this->server = nullptr;
+
+    // The transport thread that charged them is gone with the transport
+    this->sender_budgets.clear();
+
+    for (auto queue : this->send_queues) {
+        delete queue;
     }
 
-    return nullptr;
+    this->send_queues.clear();
+    this->lagging_users.clear();
+
+    this->server_users.Clear();
+    this->user_directory.Clear();
+
+    this->status = HostedServerStatus::STOPPED;
 }
 
-void HostedServer::MarkUserOnline(ServerUser* const user) {
-    user->status = ServerUserStatus::ONLINE;
-    user->time_since_last_request = std::chrono::steady_clock::now();
+ServerUserHandle HostedServer::GetUserByAddrData(const transport::ClientAddrData addr_data) {
+    return this->GetServerUsers()->Find(addr_data.sender_address);
 }
 
-std::vector<ServerUser>* HostedServer::GetServerUsers() {
+ServerUserTable* HostedServer::GetServerUsers() {
     return &this->server_users;
 }
 
-SwiftNetServer* HostedServer::GetServer() {
+utils::rate_limit::TokenBucket* HostedServer::GetRequestBucket(const RequestCost cost) {
+    return &this->request_buckets[cost];
+}
+
+RequestBudget* HostedServer::GetSenderBudget(const in_addr address) {
+    auto budget = this->sender_budgets.find(address.s_addr);
+    if (budget != this->sender_budgets.end()) {
+        return &budget->second;
+    }
+
+    if (this->sender_budgets.size() >= SERVER_SENDER_BUDGETS_MAX) {
+        return nullptr;
+    }
+
+    auto inserted = this->sender_budgets.emplace(address.s_addr, (RequestBudget){
+        .buckets = {
+            utils::rate_limit::TokenBucket(USER_CHEAP_REQUESTS_RATE, USER_CHEAP_REQUESTS_BURST),
+            utils::rate_limit::TokenBucket(USER_EXPENSIVE_REQUESTS_RATE, USER_EXPENSIVE_REQUESTS_BURST)
+        }
+    });
+
+    return &inserted.first->second;
+}
+
+void HostedServer::SetFanoutThreads(const uint32_t threads_len) {
+    fanout_threads.store(std::max(threads_len, 1u), std::memory_order_relaxed);
+}
+
+uint32_t HostedServer::GetFanoutThreads() {
+    const uint32_t threads_len = fanout_threads.load(std::memory_order_relaxed);
+
+    return threads_len > 0 ? threads_len : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+transport::ServerTransport* HostedServer::GetServer() {
     return this->server;
 }
 
+Database* HostedServer::GetDatabase() {
+    return this->database;
+}
+
+UserDirectory* HostedServer::GetUserDirectory() {
+    return &this->user_directory;
+}
+
 uint16_t HostedServer::GetServerId() {
     return this->id;
 }
 
-std::vector<objects::Database::ChannelMessageRow>* HostedServer::GetNewMessages() {
-    return &this->new_messages;
+void HostedServer::AddNewMessage(const Database::ChannelMessageRow& message) {
+    std::lock_guard<std::mutex> lock(this->new_messages_mutex);
+
+    this->new_messages.Add(message);
+}
+
+// Swaps the pending messages out, so packet handlers never wait on a fan-out tick
+void HostedServer::TakeNewMessages(ChannelMessageBatch& messages) {
+    std::lock_guard<std::mutex> lock(this->new_messages_mutex);
+
+    std::swap(messages, this->new_messages);
 }
 
 HostedServerStatus HostedServer::GetServerStatus() {
-    return this->status;
+    return this->status.load(std::memory_order_acquire);
+}
+
+bool HostedServer::BeginTransition(const HostedServerStatus transition) {
+    HostedServerStatus expected = transition == STARTING ? STOPPED : RUNNING;
+
+    return this->status.compare_exchange_strong(expected, transition, std::memory_order_acq_rel);
 }
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
 #include <optional>
+#include <string_view>
 #include <sqlite3.h>
 #include <arpa/inet.h>
 #include <cstdint>
@@ -9,12 +15,68 @@
 #include <thread>
 #include <unordered_map>
 #include <vector>
-#include <swift_net.h>
+#include "../protocol/protocol.hpp"
+#include "../transport/transport.hpp"
+#include "../utils/arena/arena.hpp"
+#include "../utils/concurrency/reactor.hpp"
+#include "../utils/concurrency/spsc_queue.hpp"
+#include "../utils/concurrency/worker_pool.hpp"
+#include "../utils/metrics/metrics.hpp"
+#include "../utils/rate_limit/rate_limit.hpp"
+
+#define DATABASE_SLOW_QUERY_MS 100
+
+// Usernames travel in a fixed size field, zero padded
+#define USERNAME_SIZE 20
+
+#define INVALID_SERVER_USER_HANDLE UINT32_MAX
+
+// Chat updates a member may leave unacknowledged before the fan-out holds the rest back
+#define USER_SEND_WINDOW 16
+// A held back member is resynced once its queue outgrows this or it stays behind this many ticks
+#define USER_SEND_QUEUE_MAX_BYTES 65536
+#define USER_SEND_QUEUE_MAX_TICKS 25
+
+// Request budgets in requests per second and burst size, expensive requests hit the database or scan a table
+#define USER_CHEAP_REQUESTS_RATE 50
+#define USER_CHEAP_REQUESTS_BURST 100
+#define USER_EXPENSIVE_REQUESTS_RATE 10
+#define USER_EXPENSIVE_REQUESTS_BURST 20
+#define SERVER_CHEAP_REQUESTS_RATE 50000
+#define SERVER_CHEAP_REQUESTS_BURST 100000
+#define SERVER_EXPENSIVE_REQUESTS_RATE 5000
+#define SERVER_EXPENSIVE_REQUESTS_BURST 10000
+
+// Expensive requests are shed while more packets than this wait for the handler
+#define SERVER_SHED_QUEUE_DEPTH 256
+// Senders with buckets of their own, any past this only have the server's
+#define SERVER_SENDER_BUDGETS_MAX 4096
+
+// Requests of one priority class that may wait for the server task, a full class queue sheds what arrives
+#define SCHEDULER_QUEUE_CAPACITY 1024
+// A waiting class is served at least once every this many requests, so interactive traffic can't starve the others
+#define SCHEDULER_NORMAL_SHARE 4
+#define SCHEDULER_BULK_SHARE 8
+// Requests one scheduler run handles before the reactor thread moves on to other servers
+#define SCHEDULER_BATCH_SIZE 64
+
+// Every running server's fan-out tick, aligned so all of them come due on the same reactor wake-up
+#define HOSTED_SERVER_TICK_MS 200
+
+// Servers a ServerLifecycle starts or stops at once
+#define SERVER_LIFECYCLE_THREADS 8
+
+// Online checks wait on the member, so they run on a pool of their own and the tick never blocks on one.
+// A tick hands over this many at most, members still silent are checked once those are answered.
+#define ONLINE_CHECK_THREADS 8
+#define ONLINE_CHECKS_PER_TICK 256
 
 namespace objects {
     typedef enum {
         STOPPED,
-        RUNNING
+        RUNNING,
+        STARTING,
+        STOPPING
     } HostedServerStatus;
 
     class JoinedServer {
@@ -37,6 +99,9 @@ namespace objects {
         bool admin;
     };
 
+    struct ChannelMessageBatch;
+    class UserDirectory;
+
     class Database {
     public:
         enum UserType {
@@ -54,13 +119,13 @@ namespace objects {
             uint32_t id;
         } JoinedServerRow;
 
+        // The message doesn't own its text, it lives in a ChannelMessageBatch arena or in whatever the row was read from.
+        // It is null terminated right past the view. Sender names are resolved through a UserDirectory.
         typedef struct {
             uint32_t id;
-            const char* message;
-            uint32_t message_length;
+            std::string_view message;
             uint32_t sender_id;
             uint32_t channel_id;
-            char sender_username[20];
         } ChannelMessageRow;
 
         typedef struct {
@@ -81,79 +146,423 @@ namespace objects {
             const char* query;
         } Statement;
 
+        // Metrics fed by the connection's profile and row trace events, keyed by the registered statement name
+        typedef struct {
+            const char* statement_name;
+            utils::metrics::MetricId duration;
+            utils::metrics::MetricId rows;
+            utils::metrics::MetricId vm_steps;
+            utils::metrics::MetricId fullscan_steps;
+            utils::metrics::MetricId sorts;
+            utils::metrics::MetricId autoindexes;
+
+            // Set by the statement event, SQLite's own profile time only has millisecond resolution
+            uint64_t start_ns;
+        } StatementProfile;
+
         Database();
+        Database(const char* path);
         ~Database();
 
-        void OpenDatabase();
+        void OpenDatabase(const char* path);
         void InitializeDatabaseTables();
         void PrepareStatements();
 
         std::vector<HostedServerRow>* SelectHostedServers(const std::optional<uint16_t> server_id);
         std::vector<JoinedServerRow>* SelectJoinedServers(const std::optional<uint32_t> id, const std::optional<in_addr_t> ip_address, const std::optional<uint16_t> server_id);
         std::vector<ServerChatChannelRow>* SelectServerChatChannels(const std::optional<uint32_t> id, const char* name, const std::optional<uint16_t> server_id);
-        std::vector<ChannelMessageRow>* SelectChannelMessages(const std::optional<uint32_t> id, const char* message, const std::optional<uint32_t> sender_id, const std::optional<uint32_t> channel_id);
+        // Appends to the caller's batch, so a reused batch selects without allocating
+        void SelectChannelMessages(const std::optional<uint32_t> id, const char* message, const std::optional<uint32_t> sender_id, const std::optional<uint32_t> channel_id, const std::optional<uint32_t> after_id, const std::optional<uint32_t> limit, ChannelMessageBatch* messages);
+        // The channel's last limit messages past after_id, still oldest first
+        void SelectNewestChannelMessages(const uint32_t channel_id, const uint32_t after_id, const uint32_t limit, ChannelMessageBatch* messages);
+        // Cached sender names fill in users the directory doesn't know yet, so history shows names before the roster is synced
+        void SelectCachedChannelMessages(const in_addr server_ip_address, const uint16_t server_id, const uint32_t channel_id, ChannelMessageBatch* messages, UserDirectory* users);
+        uint32_t SelectCachedChannelLastMessageId(const in_addr server_ip_address, const uint16_t server_id, const uint32_t channel_id);
         std::vector<HostedServerUserRow>* SelectHostedServerUsers(const std::optional<uint16_t> server_id, const std::optional<Database::UserType> user_type, const char* username, const std::optional<in_addr_t> ip_address);
 
         int InsertHostedServer(const uint16_t server_id);
         std::optional<HostedServerUserRow> InsertHostedServerUser(const uint16_t server_id, in_addr ip_address, const char* username);
         int InsertJoinedServer(const uint16_t server_id, in_addr ip_address);
         int InsertServerChatChannel(const char* name, const uint16_t server_id);
+        // The row's message points at the given text
         std::optional<ChannelMessageRow> InsertChannelMessage(const char* message, const uint32_t channel_id, const uint32_t sender_id);
+        int InsertCachedChannelMessages(const in_addr server_ip_address, const uint16_t server_id, const uint32_t channel_id, const ChannelMessageRow* messages, const size_t messages_len, UserDirectory* users);
 
+        // A new username doesn't reach a running server's UserDirectory, only its next start reads it
         int UpdateHostedServerUsers(const char* new_username, const std::optional<Database::UserType> new_user_type, const std::optional<uint32_t> id, const std::optional<in_addr_t> ip_address, const std::optional<uint16_t> server_id, const char* username, const std::optional<Database::UserType> user_type);
 
+        // Statements slower than the threshold are logged with their bound parameters, to the file when a path is given
+        void SetSlowQueryLog(const uint32_t threshold_ms, const char* path);
+
+        void RecordStatementStart(sqlite3_stmt* stmt);
+        void RecordStatementProfile(sqlite3_stmt* stmt, const uint64_t sqlite_duration_ns);
+        void RecordStatementRow(sqlite3_stmt* stmt);
+
         sqlite3_stmt* GetStatement(const char* statement_name);
 
         std::unordered_map<const char*, sqlite3_stmt*>& GetStatements();
         sqlite3* GetDatabaseConnection();
     private:
         sqlite3* database_connection;
+
+        // Hosted servers and the client share the connection and its prepared statements, a call holds this from bind to reset
+        std::mutex mutex;
+
         std::unordered_map<const char*, sqlite3_stmt*> statements;
+        std::unordered_map<sqlite3_stmt*, StatementProfile> statement_profiles;
+
+        // sqlite3_exec and other statements that were not registered in PrepareStatements
+        StatementProfile unregistered_profile;
+
+        StatementProfile& GetStatementProfile(sqlite3_stmt* stmt);
+
+        uint64_t slow_query_threshold_ns = DATABASE_SLOW_QUERY_MS * 1000000ULL;
+        FILE* slow_query_log = nullptr;
+    };
+
+    // Rows with their text copied into an arena. Clearing keeps the memory, so a batch that is reused stops allocating once it has grown.
+    // Dropping the batch frees all of its text at once.
+    struct ChannelMessageBatch {
+        std::vector<Database::ChannelMessageRow> rows;
+        utils::arena::Arena text;
+
+        // Copies the row's message and points the stored row at the copy
+        void Add(const Database::ChannelMessageRow& row);
+        // Same as Add, stored before the row at index instead of at the end
+        void Insert(const size_t index, const Database::ChannelMessageRow& row);
+        void Clear();
+
+        // Keeps only the newest rows, copied into a fresh arena so the old chunks are released together
+        void KeepLast(const size_t rows_len);
     };
 
-    enum ServerUserStatus {
+    // Wire format of a message list: id, sender id, message length with the terminator, message
+    void SerializeChannelMessages(transport::PacketBuffer* buffer, const Database::ChannelMessageRow* messages, const size_t messages_len);
+    uint32_t GetSerializedChannelMessageSize(const Database::ChannelMessageRow& message);
+
+    // Appends to the batch, returns false when the packet ends before the last message
+    bool DeserializeChannelMessages(transport::Packet* packet_data, const uint32_t channel_messages_len, ChannelMessageBatch* messages);
+
+    // Usernames by user id, each name stored once. Messages only carry the sender id and are resolved here,
+    // the server keeps one per hosted server and a client syncs a copy with LOAD_USER_ROSTER.
+    // A server's copy is filled at start and on each join, nothing renames a user while it runs.
+    class UserDirectory {
+    public:
+        UserDirectory();
+        ~UserDirectory();
+
+        UserDirectory(const UserDirectory&) = delete;
+        UserDirectory& operator=(const UserDirectory&) = delete;
+
+        // Adds a user or replaces its name, names are cut to what fits the wire field
+        void SetUsername(const uint32_t user_id, const std::string_view username);
+
+        // Empty for an unknown user. The view stays valid until Clear, a replaced name is left in place.
+        std::string_view GetUsername(const uint32_t user_id);
+        bool Contains(const uint32_t user_id);
+        size_t GetSize();
+        void Clear();
+
+        // Roster wire format: LoadUserRosterResponse, then per user its id and zero padded username
+        uint32_t GetSerializedSize();
+        void Serialize(transport::PacketBuffer* buffer);
+
+        // Replaces the directory with the roster, returns false when the packet ends early
+        bool Deserialize(transport::Packet* packet_data);
+    private:
+        std::mutex mutex;
+
+        std::unordered_map<uint32_t, std::string_view> usernames;
+        utils::arena::Arena text;
+    };
+
+    enum ServerUserStatus : uint8_t {
         ONLINE,
         OFFLINE
     };
 
-    struct ServerUser {
-        ServerUserStatus status;
-        Database::HostedServerUserRow data;
-        SwiftNetClientAddrData addr_data;
-        uint32_t active_channel_id;
-        std::chrono::time_point<std::chrono::steady_clock> time_since_last_request;
+    enum RequestCost : uint8_t {
+        CHEAP_REQUEST,
+        EXPENSIVE_REQUEST,
+        REQUEST_COSTS_LEN
+    };
+
+    // Order the server task serves requests in, interactive ones go first unless another class is owed its share
+    enum RequestClass : uint8_t {
+        INTERACTIVE_REQUEST,
+        NORMAL_REQUEST,
+        BULK_REQUEST,
+        REQUEST_CLASSES_LEN
+    };
+
+    // An admitted packet waiting for the server task, the handler deletes it
+    struct ScheduledRequest {
+        transport::Packet* packet;
+        RequestType request_type;
+        std::chrono::steady_clock::time_point queued_at;
     };
 
+    // A sender's token buckets, one per request cost
+    struct RequestBudget {
+        utils::rate_limit::TokenBucket buckets[REQUEST_COSTS_LEN];
+    };
+
+    // Index of a member in its server's ServerUserTable
+    typedef uint32_t ServerUserHandle;
+
+    // A member silent for too long, online is filled in by the online check thread
+    struct OnlineCheck {
+        ServerUserHandle handle;
+        transport::ClientAddrData addr_data;
+        bool online;
+    };
+
+    // The channels a member is subscribed to, oldest first. Only these ids are read when the fan-out matches channels.
+    struct UserSubscriptions {
+        uint32_t channel_ids[MAX_CHANNEL_SUBSCRIPTIONS];
+        uint32_t len;
+    };
+
+    // Every open chat panel of a client subscribes with its own connection, so hidden panels keep receiving updates
+    struct UserSubscriptionAddresses {
+        transport::ClientAddrData addr_data[MAX_CHANNEL_SUBSCRIPTIONS];
+    };
+
+    // A hosted server's members as parallel columns indexed by handle. The fan-out and liveness scans stream the
+    // small hot columns, addresses and database rows are only read for the members a scan picks out.
+    // Only the server's reactor task reads or writes it, handlers and the tick alike, so nothing here is locked.
+    // Add may move every column, so no pointer into one is kept past a handler or a tick. Handles are indices
+    // and stay valid until Clear, since members are never removed while the server runs.
+    struct ServerUserTable {
+        // Hot, read by every scan
+        std::vector<ServerUserStatus> statuses;
+        std::vector<std::chrono::steady_clock::time_point> last_request_times;
+        std::vector<UserSubscriptions> subscriptions;
+
+        // Updates sent and not acknowledged yet, counted up by the tick and down by acknowledgements
+        std::vector<uint32_t> unacknowledged_updates;
+
+        // Cold, read per member
+        std::vector<transport::ClientAddrData> addr_data;
+        std::vector<UserSubscriptionAddresses> subscription_addr_data;
+        std::vector<Database::HostedServerUserRow> rows;
+
+        ServerUserHandle Add(const Database::HostedServerUserRow& row, const ServerUserStatus status, const transport::ClientAddrData addr_data);
+
+        // INVALID_SERVER_USER_HANDLE when no member has the address
+        ServerUserHandle Find(const in_addr ip_address) const;
+        size_t GetSize() const;
+        void Clear();
+
+        void MarkOnline(const ServerUserHandle handle);
+        // Drops the member's subscriptions, address and unacknowledged updates
+        void MarkOffline(const ServerUserHandle handle);
+
+        void Subscribe(const ServerUserHandle handle, const uint32_t channel_id, const transport::ClientAddrData addr_data);
+        void Unsubscribe(const ServerUserHandle handle, const uint32_t channel_id);
+        void UnsubscribeAll(const ServerUserHandle handle);
+
+        uint32_t GetUnacknowledgedUpdates(const ServerUserHandle handle);
+        void AddUnacknowledgedUpdate(const ServerUserHandle handle);
+        // Never goes below zero, acknowledgements of updates sent before a reset are ignored
+        void AcknowledgeUpdate(const ServerUserHandle handle);
+        void ResetUnacknowledgedUpdates(const ServerUserHandle handle);
+
+        uint32_t CountOnline() const;
+
+        // Appends the online members whose last request is older than the cutoff
+        void CollectStale(const std::chrono::steady_clock::time_point cutoff, std::vector<ServerUserHandle>* handles) const;
+
+        // Calls visitor(handle, subscription_index, channel_id) for every subscription. Offline members have none,
+        // so this reads the subscriptions column and nothing else.
+        template <typename Visitor>
+        void ForEachSubscription(Visitor visitor) const {
+            const size_t users_len = this->subscriptions.size();
+
+            for (size_t handle = 0; handle < users_len; handle++) {
+                const UserSubscriptions& user_subscriptions = this->subscriptions[handle];
+
+                for (uint32_t i = 0; i < user_subscriptions.len; i++) {
+                    visitor(static_cast<ServerUserHandle>(handle), i, user_subscriptions.channel_ids[i]);
+                }
+            }
+        }
+    private:
+        std::unordered_map<in_addr_t, ServerUserHandle> handles_by_address;
+    };
+
+    // Chat updates held back from a member that stopped acknowledging, at most one coalesced run of messages
+    // per channel. Only the server task touches it.
+    struct UserSendQueue {
+        struct PendingChannel {
+            uint32_t channel_id;
+            uint32_t messages_len;
+            std::vector<uint8_t> messages;
+        };
+
+        PendingChannel channels[MAX_CHANNEL_SUBSCRIPTIONS];
+        uint32_t channels_len = 0;
+        uint32_t bytes = 0;
+        uint32_t lagging_ticks = 0;
+        // Listed in the server's lagging users. An update too large to queue leaves the queue empty but still listed.
+        bool lagging = false;
+
+        // Appends serialized messages to the channel's run, false when that would pass USER_SEND_QUEUE_MAX_BYTES
+        bool Push(const uint32_t channel_id, const uint8_t* messages, const uint32_t messages_size, const uint32_t messages_len);
+        // Keeps the capacity, a member that lags again reuses it. The member is no longer listed as lagging.
+        void Clear();
+    };
+
+    // Reused fan-out storage of one running server
+    struct FanoutState;
+
     class HostedServer {
     public:
-        HostedServer(uint16_t id);
+        HostedServer(uint16_t id, Database* database);
         ~HostedServer();
 
-        void StartServer();
+        // False when the transport could not be created, the server is back to STOPPED
+        bool StartServer();
         void StopServer();
 
-        ServerUser* GetUserByAddrData(const SwiftNetClientAddrData addr_data);
+        ServerUserHandle GetUserByAddrData(const transport::ClientAddrData addr_data);
 
-        SwiftNetServer* GetServer();
+        transport::ServerTransport* GetServer();
+        Database* GetDatabase();
         uint16_t GetServerId();
         HostedServerStatus GetServerStatus();
-        std::vector<Database::ChannelMessageRow>* GetNewMessages();
-        std::vector<ServerUser>* GetServerUsers();
-        void MarkUserOnline(ServerUser* const user);
+        // Claims a stopped server for STARTING or a running one for STOPPING, false while it is in any other state
+        bool BeginTransition(const HostedServerStatus transition);
+        void AddNewMessage(const Database::ChannelMessageRow& message);
+        UserDirectory* GetUserDirectory();
+        void TakeNewMessages(ChannelMessageBatch& messages);
+        ServerUserTable* GetServerUsers();
+
+        // Per server bucket of the cost, shared by every sender including those not yet members
+        utils::rate_limit::TokenBucket* GetRequestBucket(const RequestCost cost);
+        // The sender's own buckets, nullptr once SERVER_SENDER_BUDGETS_MAX senders have one. Transport thread only.
+        RequestBudget* GetSenderBudget(const in_addr address);
+
+        // Threads that send one fan-out tick, counting the reactor thread running it. The pool is shared by every
+        // server in the process and sized when the first one starts.
+        static void SetFanoutThreads(uint32_t threads_len);
+        static uint32_t GetFanoutThreads();
+
+        // Called from the transport thread only, false when the class queue is full
+        bool QueueRequest(transport::Packet* packet, const RequestType request_type, const RequestClass request_class);
+        // Packets waiting in the transport plus requests waiting in the class queues
+        uint32_t GetQueuedRequests();
+
+        // Runs on the online check thread with the checks the last tick handed over
+        void RunOnlineChecks(utils::concurrency::WorkerPool& pool);
     private:
         uint16_t id;
 
-        void BackgroundProcesses();
-        HostedServerStatus status = STOPPED;
+        Database* database;
+
+        // The server's one reactor task, runs the queued requests and the tick once it came due.
+        // Handlers and the tick never overlap, so neither locks the member table against the other.
+        void RunServerTask();
+        void Tick();
+        void RunQueuedRequests();
+
+        // Sends the catch-up batches of members that acknowledged enough again, resyncs the ones that never will
+        void DrainSendQueues();
+        // Holds one serialized chat update back for a member past its send window
+        void HoldBackUpdate(const ServerUserHandle handle, const transport::PacketBuffer* update, const uint32_t channel_id, const uint32_t messages_len);
+        void ResyncUser(const ServerUserHandle handle);
+
+        // Next request in class order, false once every class queue is empty
+        bool TakeNextRequest(ScheduledRequest& request);
+        void RunRequest(const ScheduledRequest& request);
+
+        // Read by the UI while a lifecycle thread starts or stops the server
+        std::atomic<HostedServerStatus> status = STOPPED;
+
+        // Comes due every tick and is woken whenever a class queue stops being empty
+        utils::concurrency::ReactorTaskId server_task;
+        utils::concurrency::Reactor::TimePoint next_tick;
+
+        FanoutState* fanout_state = nullptr;
+
+        // Handed over by the tick, the tick leaves them alone until answered is set and then applies them
+        std::vector<OnlineCheck> online_checks;
+        bool online_checks_sent = false;
+        std::atomic<bool> online_checks_answered = false;
+
+        // Filled by the transport thread, drained by the server task
+        utils::concurrency::SpscQueue<ScheduledRequest, SCHEDULER_QUEUE_CAPACITY> request_queues[REQUEST_CLASSES_LEN];
+        std::atomic<uint32_t> queued_requests[REQUEST_CLASSES_LEN] = {};
+
+        // Requests served since the class last had a turn while it had work waiting
+        uint32_t passed_over[REQUEST_CLASSES_LEN] = {};
+
+        // Filled by packet handlers, drained by the fan-out tick
+        std::mutex new_messages_mutex;
+        ChannelMessageBatch new_messages;
+
+        transport::ServerTransport* server = nullptr;
+
+        ServerUserTable server_users;
+
+        UserDirectory user_directory;
+
+        // Indexed by member handle, a queue is created the first time its member lags and freed by a resync
+        std::vector<UserSendQueue*> send_queues;
+        std::vector<ServerUserHandle> lagging_users;
+
+        // Charged by the transport thread before a request is queued, nothing else touches them
+        utils::rate_limit::TokenBucket request_buckets[REQUEST_COSTS_LEN];
+        std::unordered_map<in_addr_t, RequestBudget> sender_budgets;
+
+        utils::metrics::MetricId online_users_gauge;
+        utils::metrics::MetricId members_gauge;
+        utils::metrics::MetricId lagging_users_gauge;
+    };
+
+    // Starts and stops hosted servers on threads of its own, several at once, so the caller never waits on one
+    class ServerLifecycle {
+    public:
+        enum Action : uint8_t {
+            START,
+            STOP
+        };
+
+        // Called on a lifecycle thread after each server, done counts the servers of its batch finished so far.
+        // succeeded is false for a server that failed to start and is STOPPED again.
+        typedef void (*ProgressCallback)(HostedServer* server, bool succeeded, uint32_t done, uint32_t total, void* user);
+
+        ServerLifecycle(uint32_t threads_len);
+        // Finishes every batch submitted so far
+        ~ServerLifecycle();
+
+        ServerLifecycle(const ServerLifecycle&) = delete;
+        ServerLifecycle& operator=(const ServerLifecycle&) = delete;
+
+        // Servers not in the state the action starts from are left out, returns how many were queued
+        uint32_t Submit(const std::vector<HostedServer*>& servers, const Action action, ProgressCallback callback, void* user);
+        // Returns once every batch submitted so far finished
+        void Wait();
+    private:
+        struct Batch {
+            std::vector<HostedServer*> servers;
+            Action action;
+            ProgressCallback callback;
+            void* user;
+        };
 
-        _Atomic bool stop_background_processes;
+        void RunBatches();
 
-        std::thread* background_processes_thread = nullptr;
+        utils::concurrency::WorkerPool pool;
 
-        std::vector<Database::ChannelMessageRow> new_messages = {};
+        std::thread* batches_thread = nullptr;
 
-        SwiftNetServer* server = nullptr;
+        std::mutex mutex;
+        std::condition_variable batches_condition;
+        std::condition_variable idle_condition;
 
-        std::vector<ServerUser> server_users = {};
+        std::deque<Batch*> batches;
+        bool running_batch = false;
+        bool stop = false;
     };
 }
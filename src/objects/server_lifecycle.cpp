@@ -0,0 +1,126 @@
+#include "objects.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace objects;
+
+ServerLifecycle::ServerLifecycle(const uint32_t threads_len) : pool(threads_len) {
+    this->batches_thread = new std::thread([this]() {
+        this->RunBatches();
+    });
+}
+
+ServerLifecycle::~ServerLifecycle() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        this->stop = true;
+    }
+
+    this->batches_condition.notify_one();
+
+    this->batches_thread->join();
+
+    delete this->batches_thread;
+}
+
+void ServerLifecycle::RunBatches() {
+    while (true) {
+        Batch* batch;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            this->batches_condition.wait(lock, [this]() { return this->stop || !this->batches.empty(); });
+
+            // Whatever was submitted still finishes, a half started server can't be left behind
+            if (this->batches.empty()) {
+                return;
+            }
+
+            batch = this->batches.front();
+            this->batches.pop_front();
+
+            this->running_batch = true;
+        }
+
+        const uint32_t total = batch->servers.size();
+
+        std::atomic<uint32_t> done = 0;
+
+        auto change_server = [&](const size_t index) {
+            HostedServer* const server = batch->servers[index];
+
+            bool succeeded = true;
+
+            if (batch->action == START) {
+                succeeded = server->StartServer();
+            } else {
+                server->StopServer();
+            }
+
+            const uint32_t finished = done.fetch_add(1, std::memory_order_relaxed) + 1;
+
+            if (batch->callback != nullptr) {
+                batch->callback(server, succeeded, finished, total, batch->user);
+            }
+        };
+
+        this->pool.ForEach(total, change_server);
+
+        delete batch;
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            this->running_batch = false;
+        }
+
+        this->idle_condition.notify_all();
+    }
+}
+
+uint32_t ServerLifecycle::Submit(const std::vector<HostedServer*>& servers, const Action action, const ProgressCallback callback, void* const user) {
+    Batch* const batch = new Batch{
+        .servers = {},
+        .action = action,
+        .callback = callback,
+        .user = user
+    };
+
+    // Claimed here, so a server submitted twice before its first batch ran is only changed once
+    for (auto server : servers) {
+        if (server->BeginTransition(action == START ? STARTING : STOPPING)) {
+            batch->servers.push_back(server);
+        }
+    }
+
+    const uint32_t servers_len = batch->servers.size();
+
+    if (servers_len == 0) {
+        delete batch;
+
+        return 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        this->batches.push_back(batch);
+    }
+
+    this->batches_condition.notify_one();
+
+    return servers_len;
+}
+
+void ServerLifecycle::Wait() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->idle_condition.wait(lock, [this]() {
+        return this->batches.empty() && !this->running_batch;
+    });
+}
@@ -0,0 +1,145 @@
+#include "objects.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "../transport/transport.hpp"
+
+using namespace objects;
+
+ServerUserHandle ServerUserTable::Add(const Database::HostedServerUserRow& row, const ServerUserStatus status, const transport::ClientAddrData addr_data) {
+    const ServerUserHandle handle = this->rows.size();
+
+    this->statuses.push_back(status);
+    this->last_request_times.push_back(std::chrono::steady_clock::time_point());
+    this->subscriptions.push_back((UserSubscriptions){});
+    this->unacknowledged_updates.push_back(0);
+    this->addr_data.push_back(addr_data);
+    this->subscription_addr_data.push_back((UserSubscriptionAddresses){});
+    this->rows.push_back(row);
+
+    this->handles_by_address[row.ip_address.s_addr] = handle;
+
+    return handle;
+}
+
+ServerUserHandle ServerUserTable::Find(const in_addr ip_address) const {
+    auto handle = this->handles_by_address.find(ip_address.s_addr);
+    if (handle == this->handles_by_address.end()) {
+        return INVALID_SERVER_USER_HANDLE;
+    }
+
+    return handle->second;
+}
+
+size_t ServerUserTable::GetSize() const {
+    return this->rows.size();
+}
+
+void ServerUserTable::Clear() {
+    this->statuses.clear();
+    this->last_request_times.clear();
+    this->subscriptions.clear();
+    this->unacknowledged_updates.clear();
+    this->addr_data.clear();
+    this->subscription_addr_data.clear();
+    this->rows.clear();
+    this->handles_by_address.clear();
+}
+
+void ServerUserTable::MarkOnline(const ServerUserHandle handle) {
+    this->statuses[handle] = ServerUserStatus::ONLINE;
+    this->last_request_times[handle] = std::chrono::steady_clock::now();
+}
+
+void ServerUserTable::MarkOffline(const ServerUserHandle handle) {
+    this->statuses[handle] = ServerUserStatus::OFFLINE;
+    this->subscriptions[handle].len = 0;
+
+    this->ResetUnacknowledgedUpdates(handle);
+
+    memset(&this->addr_data[handle], 0x00, sizeof(this->addr_data[handle]));
+}
+
+void ServerUserTable::Subscribe(const ServerUserHandle handle, const uint32_t channel_id, const transport::ClientAddrData addr_data) {
+    this->Unsubscribe(handle, channel_id);
+
+    UserSubscriptions& user_subscriptions = this->subscriptions[handle];
+    UserSubscriptionAddresses& user_addresses = this->subscription_addr_data[handle];
+
+    // Drop the oldest subscription, the client only keeps this many channels warm
+    if (user_subscriptions.len == MAX_CHANNEL_SUBSCRIPTIONS) {
+        memmove(&user_subscriptions.channel_ids[0], &user_subscriptions.channel_ids[1], sizeof(uint32_t) * (MAX_CHANNEL_SUBSCRIPTIONS - 1));
+        memmove(&user_addresses.addr_data[0], &user_addresses.addr_data[1], sizeof(transport::ClientAddrData) * (MAX_CHANNEL_SUBSCRIPTIONS - 1));
+        user_subscriptions.len--;
+    }
+
+    user_subscriptions.channel_ids[user_subscriptions.len] = channel_id;
+    user_addresses.addr_data[user_subscriptions.len] = addr_data;
+    user_subscriptions.len++;
+}
+
+void ServerUserTable::Unsubscribe(const ServerUserHandle handle, const uint32_t channel_id) {
+    UserSubscriptions& user_subscriptions = this->subscriptions[handle];
+    UserSubscriptionAddresses& user_addresses = this->subscription_addr_data[handle];
+
+    for (uint32_t i = 0; i < user_subscriptions.len; i++) {
+        if (user_subscriptions.channel_ids[i] != channel_id) {
+            continue;
+        }
+
+        const uint32_t following = user_subscriptions.len - i - 1;
+
+        memmove(&user_subscriptions.channel_ids[i], &user_subscriptions.channel_ids[i + 1], sizeof(uint32_t) * following);
+        memmove(&user_addresses.addr_data[i], &user_addresses.addr_data[i + 1], sizeof(transport::ClientAddrData) * following);
+        user_subscriptions.len--;
+
+        return;
+    }
+}
+
+void ServerUserTable::UnsubscribeAll(const ServerUserHandle handle) {
+    this->subscriptions[handle].len = 0;
+}
+
+uint32_t ServerUserTable::GetUnacknowledgedUpdates(const ServerUserHandle handle) {
+    return this->unacknowledged_updates[handle];
+}
+
+void ServerUserTable::AddUnacknowledgedUpdate(const ServerUserHandle handle) {
+    this->unacknowledged_updates[handle]++;
+}
+
+void ServerUserTable::AcknowledgeUpdate(const ServerUserHandle handle) {
+    if (this->unacknowledged_updates[handle] > 0) {
+        this->unacknowledged_updates[handle]--;
+    }
+}
+
+void ServerUserTable::ResetUnacknowledgedUpdates(const ServerUserHandle handle) {
+    this->unacknowledged_updates[handle] = 0;
+}
+
+// Branch free over one byte per member, so the compiler vectorizes it
+uint32_t ServerUserTable::CountOnline() const {
+    const ServerUserStatus* const statuses = this->statuses.data();
+    const size_t users_len = this->statuses.size();
+
+    uint32_t online = 0;
+
+    for (size_t i = 0; i < users_len; i++) {
+        online += statuses[i] == ServerUserStatus::ONLINE;
+    }
+
+    return online;
+}
+
+void ServerUserTable::CollectStale(const std::chrono::steady_clock::time_point cutoff, std::vector<ServerUserHandle>* handles) const {
+    const size_t users_len = this->statuses.size();
+
+    for (size_t i = 0; i < users_len; i++) {
+        if ((this->statuses[i] == ServerUserStatus::ONLINE) & (this->last_request_times[i] < cutoff)) {
+            handles->push_back(static_cast<ServerUserHandle>(i));
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#include "objects.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include "../protocol/protocol.hpp"
+#include "../transport/transport.hpp"
+
+#define USER_DIRECTORY_CHUNK_SIZE 4096
+
+using namespace objects;
+
+UserDirectory::UserDirectory() : text(USER_DIRECTORY_CHUNK_SIZE) {
+
+}
+
+UserDirectory::~UserDirectory() = default;
+
+void UserDirectory::SetUsername(const uint32_t user_id, const std::string_view username) {
+    const std::string_view name = username.substr(0, std::min(username.find('\0'), (size_t)USERNAME_SIZE - 1));
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto existing = this->usernames.find(user_id);
+    if (existing != this->usernames.end() && existing->second == name) {
+        return;
+    }
+
+    this->usernames[user_id] = std::string_view(this->text.CopyString(name.data(), name.size()), name.size());
+}
+
+std::string_view UserDirectory::GetUsername(const uint32_t user_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto username = this->usernames.find(user_id);
+    if (username == this->usernames.end()) {
+        return std::string_view();
+    }
+
+    return username->second;
+}
+
+bool UserDirectory::Contains(const uint32_t user_id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    return this->usernames.find(user_id) != this->usernames.end();
+}
+
+size_t UserDirectory::GetSize() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    return this->usernames.size();
+}
+
+void UserDirectory::Clear() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->usernames.clear();
+    this->text.Reset();
+}
+
+uint32_t UserDirectory::GetSerializedSize() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    return sizeof(responses::LoadUserRosterResponse) + this->usernames.size() * (sizeof(uint32_t) + USERNAME_SIZE);
+}
+
+void UserDirectory::Serialize(transport::PacketBuffer* buffer) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    const responses::LoadUserRosterResponse response = {
+        .users_len = static_cast<uint32_t>(this->usernames.size())
+    };
+
+    buffer->Append(&response, sizeof(response));
+
+    for (auto& [user_id, username] : this->usernames) {
+        char padded_username[USERNAME_SIZE] = {};
+        memcpy(padded_username, username.data(), username.size());
+
+        buffer->Append(&user_id, sizeof(user_id));
+        buffer->Append(padded_username, sizeof(padded_username));
+    }
+}
+
+bool UserDirectory::Deserialize(transport::Packet* packet_data) {
+    const responses::LoadUserRosterResponse* const response = (responses::LoadUserRosterResponse*)packet_data->Read(sizeof(responses::LoadUserRosterResponse));
+    if (response == nullptr) {
+        return false;
+    }
+
+    this->Clear();
+
+    for (uint32_t i = 0; i < response->users_len; i++) {
+        const uint32_t* const user_id = (uint32_t*)packet_data->Read(sizeof(uint32_t));
+        const char* const username = (const char*)packet_data->Read(USERNAME_SIZE);
+        if (user_id == nullptr || username == nullptr) {
+            return false;
+        }
+
+        this->SetUsername(*user_id, std::string_view(username, strnlen(username, USERNAME_SIZE)));
+    }
+
+    return true;
+}
@@ -0,0 +1,51 @@
+#include "objects.hpp"
+#include <cstdint>
+#include <vector>
+
+using namespace objects;
+
+bool UserSendQueue::Push(const uint32_t channel_id, const uint8_t* messages, const uint32_t messages_size, const uint32_t messages_len) {
+    if (this->bytes + messages_size > USER_SEND_QUEUE_MAX_BYTES) {
+        return false;
+    }
+
+    PendingChannel* pending = nullptr;
+
+    for (uint32_t i = 0; i < this->channels_len; i++) {
+        if (this->channels[i].channel_id == channel_id) {
+            pending = &this->channels[i];
+            break;
+        }
+    }
+
+    if (pending == nullptr) {
+        // Only as many channels as a member can subscribe to, more means its subscriptions churned while lagging
+        if (this->channels_len == MAX_CHANNEL_SUBSCRIPTIONS) {
+            return false;
+        }
+
+        pending = &this->channels[this->channels_len++];
+
+        pending->channel_id = channel_id;
+        pending->messages_len = 0;
+        pending->messages.clear();
+    }
+
+    pending->messages.insert(pending->messages.end(), messages, messages + messages_size);
+    pending->messages_len += messages_len;
+
+    this->bytes += messages_size;
+
+    return true;
+}
+
+void UserSendQueue::Clear() {
+    for (uint32_t i = 0; i < this->channels_len; i++) {
+        this->channels[i].messages.clear();
+    }
+
+    this->channels_len = 0;
+    this->bytes = 0;
+    this->lagging_ticks = 0;
+    this->lagging = false;
+}
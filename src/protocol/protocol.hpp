@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+
+#define DEFAULT_TIMEOUT_CLIENT_CREATION 500
+#define DEFAULT_TIMEOUT_REQUEST 200
+#define LOOPBACK false
+#define CHANNEL_PAGE_SIZE 50
+#define MAX_CHANNEL_SUBSCRIPTIONS 4
+
+// Request Types
+
+enum Status {
+    SUCCESS,
+    FAIL,
+    // The server is over its request budget for the sender or under load, the response carries nothing else
+    RATE_LIMITED
+};
+
+enum RequestType {
+    JOIN_SERVER,
+    LOAD_SERVER_INFORMATION,
+    LOAD_CHANNEL_DATA,
+    SEND_MESSAGE,
+    LOAD_JOINED_SERVER_DATA,
+    LOAD_ADMIN_MENU_DATA,
+    CREATE_NEW_CHANNEL,
+    PERIODIC_CHAT_UPDATE,
+    CLIENT_ONLINE_CHECK,
+    LEAVE_CHANNEL,
+    LOAD_SERVER_STATS,
+    LOAD_USER_ROSTER,
+    ACKNOWLEDGE_CHAT_UPDATE
+};
+
+struct RequestInfo {
+    enum RequestType request_type;
+};
+
+struct ResponseInfo {
+    enum RequestType request_type;
+    enum Status request_status;
+};
+
+// Requests
+
+namespace requests {
+    struct LoadChannelDataRequest {
+        uint32_t channel_id;
+        uint32_t after_message_id;
+        uint32_t limit;
+        bool subscribe;
+        // With a limit the page holds the newest messages past after_message_id, has_more then means older ones were left out
+        bool newest;
+    };
+
+    struct LeaveChannelRequest {
+        uint32_t channel_id;
+    };
+
+    struct SendMessageRequest {
+        uint32_t message_len;
+        uint32_t channel_id;
+    };
+
+    struct JoinServerRequest {
+        char username[20];
+    };
+
+    struct LoadJoinedServerDataRequest {
+    };
+
+    struct LoadAdminMenuDataRequest {
+    };
+
+    struct CreateNewChannelRequest {
+        char name[20];
+    };
+
+    struct LoadServerStatsRequest {
+    };
+
+    struct LoadUserRosterRequest {
+    };
+
+    // Sent without waiting for a response once a chat update was handled, the server holds back members that stop
+    struct AcknowledgeChatUpdateRequest {
+        uint32_t channel_id;
+    };
+}
+
+// Responses
+
+namespace responses {
+    struct JoinServerResponse {
+    };
+
+    struct LoadServerInformationResponse {
+        uint32_t server_chat_channels_size;
+    };
+
+    struct LoadChannelDataResponse {
+        uint32_t channel_messages_len;
+        bool has_more;
+    };
+
+    struct LoadJoinedServerDataResponse {
+        bool admin;
+    };
+
+    struct LoadAdminMenuDataResponse {
+        uint32_t channels_size;
+    };
+
+    struct CreateNewChannelResponse {
+
+    };
+
+    // A FAIL status carries no messages, the server stopped sending the channel and the client reloads it
+    struct PeriodicChatUpdateResponse {
+        uint32_t channel_messages_len;
+    };
+
+    // Followed by the text snapshot, terminator included
+    struct LoadServerStatsResponse {
+        uint32_t snapshot_len;
+    };
+
+    // Followed by each member's id and zero padded username
+    struct LoadUserRosterResponse {
+        uint32_t users_len;
+    };
+}
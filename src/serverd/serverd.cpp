@@ -0,0 +1,135 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <vector>
+#include "../objects/objects.hpp"
+#include "../transport/transport.hpp"
+#include "../utils/log/log.hpp"
+#include "../utils/metrics/metrics.hpp"
+#include "../utils/trace/trace.hpp"
+
+// Headless entry point, hosts every stored server without the GUI
+int main(int argc, char** argv) {
+    const char* stats_path = nullptr;
+    uint32_t stats_interval = 10;
+    const char* trace_path = "swiftcom-trace.json";
+    uint32_t slow_query_ms = DATABASE_SLOW_QUERY_MS;
+    const char* slow_query_path = nullptr;
+    uint32_t fanout_threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats-file") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (strcmp(argv[i], "--stats-interval") == 0 && i + 1 < argc) {
+            stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace-file") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--slow-query-ms") == 0 && i + 1 < argc) {
+            slow_query_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--slow-query-log") == 0 && i + 1 < argc) {
+            slow_query_path = argv[++i];
+        } else if (strcmp(argv[i], "--fanout-threads") == 0 && i + 1 < argc) {
+            fanout_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            utils::trace::SetEnabled(true);
+        } else {
+            fprintf(stderr, "Usage: %s [--stats-file PATH] [--stats-interval SECONDS] [--trace] [--trace-file PATH] [--slow-query-ms MS] [--slow-query-log PATH] [--fanout-threads N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Block termination signals before any server thread is spawned so they inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    utils::log::ConfigureFromEnvironment();
+
+    transport::Initialize();
+
+    srand(time(0));
+
+    objects::Database* database = new objects::Database();
+
+    database->SetSlowQueryLog(slow_query_ms, slow_query_path);
+
+    std::vector<objects::HostedServer*> hosted_servers;
+
+    std::vector<objects::Database::HostedServerRow>* hosted_server_rows = database->SelectHostedServers(std::nullopt);
+
+    for (auto &row : *hosted_server_rows) {
+        hosted_servers.push_back(new objects::HostedServer(row.server_id, database));
+    }
+
+    delete hosted_server_rows;
+
+    if (hosted_servers.empty()) {
+        printf("No hosted servers found, create one from the GUI first\n");
+    }
+
+    // Zero keeps the default of one sender per core
+    if (fanout_threads > 0) {
+        objects::HostedServer::SetFanoutThreads(fanout_threads);
+    }
+
+    for (auto server : hosted_servers) {
+        if (!server->StartServer()) {
+            printf("Failed to start server %d\n", server->GetServerId());
+
+            continue;
+        }
+
+        printf("Hosting server %d\n", server->GetServerId());
+    }
+
+    if (stats_path != nullptr) {
+        utils::metrics::StartSnapshotWriter(stats_path, stats_interval > 0 ? stats_interval : 1);
+    }
+
+    int received_signal;
+
+    // SIGUSR1 toggles tracing, turning it off writes what was recorded
+    while (sigwait(&signals, &received_signal) == 0 && received_signal == SIGUSR1) {
+        const bool enable = !utils::trace::IsEnabled();
+
+        utils::trace::SetEnabled(enable);
+
+        if (!enable && utils::trace::DumpChromeTrace(trace_path)) {
+            printf("Wrote trace to %s\n", trace_path);
+        } else if (enable) {
+            printf("Tracing enabled\n");
+        }
+    }
+
+    printf("Received signal %d, stopping servers\n", received_signal);
+
+    for (auto server : hosted_servers) {
+        if (server->GetServerStatus() == objects::HostedServerStatus::RUNNING) {
+            server->StopServer();
+        }
+
+        delete server;
+    }
+
+    // Writes one last snapshot on the way out
+    utils::metrics::StopSnapshotWriter();
+
+    if (utils::trace::IsEnabled()) {
+        utils::trace::DumpChromeTrace(trace_path);
+    }
+
+    delete database;
+
+    transport::Cleanup();
+
+    utils::log::Flush();
+
+    return 0;
+}
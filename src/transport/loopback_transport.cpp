@@ -0,0 +1,460 @@
+#include "transport.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../utils/alloc/alloc.hpp"
+#include "../utils/metrics/metrics.hpp"
+
+using namespace transport;
+
+// Every loopback endpoint in the process, plus the thread that runs client handlers
+struct LoopbackRegistry {
+    std::mutex mutex;
+    std::unordered_map<uint16_t, LoopbackServerTransport*> servers;
+    std::unordered_map<in_addr_t, LoopbackClientTransport*> clients;
+    uint32_t next_client_address = 2;
+
+    std::mutex dispatch_mutex;
+    std::condition_variable dispatch_condition;
+    std::deque<std::pair<in_addr_t, LoopbackPacket*>> dispatch_queue;
+    bool stop_dispatch = false;
+    std::thread* dispatch_thread = nullptr;
+
+    ~LoopbackRegistry() {
+        {
+            std::lock_guard<std::mutex> lock(this->dispatch_mutex);
+            this->stop_dispatch = true;
+        }
+
+        this->dispatch_condition.notify_all();
+
+        if (this->dispatch_thread != nullptr) {
+            this->dispatch_thread->join();
+
+            delete this->dispatch_thread;
+        }
+
+        for (auto& [address, packet] : this->dispatch_queue) {
+            delete packet;
+        }
+    }
+};
+
+static LoopbackRegistry& GetRegistry() {
+    static LoopbackRegistry registry;
+
+    return registry;
+}
+
+static in_addr GetServerAddress() {
+    return (in_addr){.s_addr = htonl(INADDR_LOOPBACK)};
+}
+
+static void DispatchClientPackets() {
+    LoopbackRegistry& registry = GetRegistry();
+
+    while (true) {
+        std::unique_lock<std::mutex> dispatch_lock(registry.dispatch_mutex);
+
+        registry.dispatch_condition.wait(dispatch_lock, [&registry]() { return registry.stop_dispatch || !registry.dispatch_queue.empty(); });
+
+        if (registry.dispatch_queue.empty()) {
+            return;
+        }
+
+        const auto [address, packet] = registry.dispatch_queue.front();
+        registry.dispatch_queue.pop_front();
+
+        dispatch_lock.unlock();
+
+        std::unique_lock<std::mutex> registry_lock(registry.mutex);
+
+        auto it = registry.clients.find(address);
+        if (it == registry.clients.end()) {
+            delete packet;
+            continue;
+        }
+
+        it->second->Dispatch(packet, registry_lock);
+    }
+}
+
+// Client handlers run on one shared thread, the way a single SwiftNet client thread would run them
+static void QueueClientPackets(const std::pair<in_addr_t, LoopbackPacket*>* packets, const size_t packets_len) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    static const utils::metrics::MetricId queue_depth_metric = utils::metrics::RegisterHistogram("transport.loopback.client_queue_depth", utils::metrics::COUNT);
+
+    LoopbackRegistry& registry = GetRegistry();
+
+    size_t queue_depth;
+
+    {
+        std::lock_guard<std::mutex> lock(registry.dispatch_mutex);
+
+        if (registry.dispatch_thread == nullptr) {
+            registry.dispatch_thread = new std::thread(DispatchClientPackets);
+        }
+
+        registry.dispatch_queue.insert(registry.dispatch_queue.end(), packets, packets + packets_len);
+
+        queue_depth = registry.dispatch_queue.size();
+    }
+
+    utils::metrics::RecordValue(queue_depth_metric, queue_depth);
+
+    registry.dispatch_condition.notify_one();
+}
+
+static void QueueClientPacket(const in_addr_t address, LoopbackPacket* const packet) {
+    const std::pair<in_addr_t, LoopbackPacket*> queued(address, packet);
+
+    QueueClientPackets(&queued, 1);
+}
+
+LoopbackPacket::LoopbackPacket(const PacketBuffer* buffer, const in_addr sender_address, const uint64_t request_id) : data(buffer->GetData(), buffer->GetData() + buffer->GetSize()), request_id(request_id) {
+    this->sender.sender_address = sender_address;
+}
+
+void* LoopbackPacket::Read(const uint32_t size) {
+    if (this->read_offset + size > this->data.size()) {
+        return nullptr;
+    }
+
+    void* const result = this->data.data() + this->read_offset;
+
+    this->read_offset += size;
+
+    return result;
+}
+
+uint64_t LoopbackPacket::GetRequestId() {
+    return this->request_id;
+}
+
+LoopbackServerTransport::LoopbackServerTransport(const uint16_t port) : port(port) {
+    LoopbackRegistry& registry = GetRegistry();
+
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        this->bound = registry.servers.emplace(port, this).second;
+    }
+
+    if (!this->bound) {
+        return;
+    }
+
+    this->packets_thread = new std::thread([this]() {
+        this->ProcessPackets();
+    });
+}
+
+LoopbackServerTransport::~LoopbackServerTransport() {
+    if (!this->bound) {
+        return;
+    }
+
+    LoopbackRegistry& registry = GetRegistry();
+
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.servers.erase(this->GetPort());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->packets_mutex);
+        this->stop = true;
+    }
+
+    this->packets_condition.notify_all();
+
+    this->packets_thread->join();
+
+    delete this->packets_thread;
+
+    for (auto packet : this->packets) {
+        delete packet;
+    }
+}
+
+void LoopbackServerTransport::ProcessPackets() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(this->packets_mutex);
+
+        this->packets_condition.wait(lock, [this]() { return this->stop || !this->packets.empty(); });
+
+        if (this->stop) {
+            return;
+        }
+
+        LoopbackPacket* const packet = this->packets.front();
+        this->packets.pop_front();
+
+        const PacketHandler handler = this->handler;
+        void* const handler_user = this->handler_user;
+
+        lock.unlock();
+
+        if (handler == nullptr) {
+            delete packet;
+            continue;
+        }
+
+        handler(packet, handler_user);
+    }
+}
+
+void LoopbackServerTransport::SetMessageHandler(PacketHandler handler, void* const user) {
+    std::lock_guard<std::mutex> lock(this->packets_mutex);
+
+    this->handler = handler;
+    this->handler_user = user;
+}
+
+void LoopbackServerTransport::Deliver(LoopbackPacket* const packet) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    static const utils::metrics::MetricId queue_depth_metric = utils::metrics::RegisterHistogram("transport.loopback.server_queue_depth", utils::metrics::COUNT);
+
+    size_t queue_depth;
+
+    {
+        std::lock_guard<std::mutex> lock(this->packets_mutex);
+
+        this->packets.push_back(packet);
+
+        queue_depth = this->packets.size();
+    }
+
+    utils::metrics::RecordValue(queue_depth_metric, queue_depth);
+
+    this->packets_condition.notify_one();
+}
+
+void LoopbackServerTransport::SendPacket(const PacketBuffer* buffer, const ClientAddrData addr_data) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    QueueClientPacket(addr_data.sender_address.s_addr, new LoopbackPacket(buffer, GetServerAddress(), 0));
+}
+
+// Copies are made before taking the dispatch lock, which is then taken once for the whole batch
+void LoopbackServerTransport::SendPacketBatch(const PacketBuffer* buffer, const ClientAddrData* addr_data, const uint32_t addr_data_len) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    static thread_local std::vector<std::pair<in_addr_t, LoopbackPacket*>> batch;
+
+    batch.clear();
+
+    for (uint32_t i = 0; i < addr_data_len; i++) {
+        batch.emplace_back(addr_data[i].sender_address.s_addr, new LoopbackPacket(buffer, GetServerAddress(), 0));
+    }
+
+    if (!batch.empty()) {
+        QueueClientPackets(batch.data(), batch.size());
+    }
+}
+
+void LoopbackServerTransport::MakeResponse(Packet* const request, const PacketBuffer* buffer) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    const uint64_t request_id = static_cast<LoopbackPacket*>(request)->GetRequestId();
+    if (request_id == 0) {
+        return;
+    }
+
+    LoopbackPacket* const response = new LoopbackPacket(buffer, GetServerAddress(), 0);
+
+    LoopbackRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto it = registry.clients.find(request->GetSender().sender_address.s_addr);
+    if (it == registry.clients.end()) {
+        delete response;
+        return;
+    }
+
+    it->second->CompleteRequest(request_id, response);
+}
+
+// Clients never answer server requests themselves, a connected loopback client acknowledges them right away
+Packet* LoopbackServerTransport::MakeRequest(const PacketBuffer* buffer, const ClientAddrData addr_data, const uint32_t timeout_ms) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    LoopbackRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    if (registry.clients.find(addr_data.sender_address.s_addr) == registry.clients.end()) {
+        return nullptr;
+    }
+
+    const PacketBuffer empty_buffer(0);
+
+    return new LoopbackPacket(&empty_buffer, addr_data.sender_address, 0);
+}
+
+uint32_t LoopbackServerTransport::GetQueuedPackets() {
+    std::lock_guard<std::mutex> lock(this->packets_mutex);
+
+    return this->packets.size();
+}
+
+bool LoopbackServerTransport::IsBound() {
+    return this->bound;
+}
+
+uint16_t LoopbackServerTransport::GetPort() {
+    return this->port;
+}
+
+LoopbackClientTransport::LoopbackClientTransport(const uint16_t port) : port(port) {
+    LoopbackRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    if (registry.servers.find(port) == registry.servers.end()) {
+        return;
+    }
+
+    this->address.s_addr = htonl(0x7F000000 | (registry.next_client_address++ & 0x00FFFFFF));
+    this->connected = true;
+
+    registry.clients[this->address.s_addr] = this;
+}
+
+LoopbackClientTransport::~LoopbackClientTransport() {
+    if (this->connected) {
+        LoopbackRegistry& registry = GetRegistry();
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.clients.erase(this->GetAddress().s_addr);
+    }
+
+    // Wait for a handler the dispatch thread may still be running
+    std::lock_guard<std::mutex> handler_lock(this->handler_mutex);
+
+    std::lock_guard<std::mutex> requests_lock(this->requests_mutex);
+
+    for (auto& [request_id, response] : this->pending_requests) {
+        delete response;
+    }
+}
+
+void LoopbackClientTransport::SetMessageHandler(PacketHandler handler, void* const user) {
+    std::lock_guard<std::mutex> lock(this->handler_mutex);
+
+    this->handler = handler;
+    this->handler_user = user;
+}
+
+void LoopbackClientTransport::SendPacket(const PacketBuffer* buffer) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    LoopbackPacket* const packet = new LoopbackPacket(buffer, this->GetAddress(), 0);
+
+    LoopbackRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto it = registry.servers.find(this->GetPort());
+    if (it == registry.servers.end()) {
+        delete packet;
+        return;
+    }
+
+    it->second->Deliver(packet);
+}
+
+Packet* LoopbackClientTransport::MakeRequest(const PacketBuffer* buffer, const uint32_t timeout_ms) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    uint64_t request_id;
+
+    {
+        std::lock_guard<std::mutex> lock(this->requests_mutex);
+
+        request_id = this->next_request_id++;
+
+        this->pending_requests[request_id] = nullptr;
+    }
+
+    LoopbackPacket* const packet = new LoopbackPacket(buffer, this->GetAddress(), request_id);
+
+    LoopbackRegistry& registry = GetRegistry();
+
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        auto it = registry.servers.find(this->GetPort());
+        if (it == registry.servers.end()) {
+            delete packet;
+        } else {
+            it->second->Deliver(packet);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(this->requests_mutex);
+
+    this->requests_condition.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, request_id]() { return this->pending_requests[request_id] != nullptr; });
+
+    LoopbackPacket* const response = this->pending_requests[request_id];
+
+    this->pending_requests.erase(request_id);
+
+    return response;
+}
+
+// Called with the registry locked, hands the lock over once the handler can no longer be destroyed under us
+void LoopbackClientTransport::Dispatch(LoopbackPacket* const packet, std::unique_lock<std::mutex>& registry_lock) {
+    std::lock_guard<std::mutex> handler_lock(this->handler_mutex);
+
+    registry_lock.unlock();
+
+    if (this->handler == nullptr) {
+        delete packet;
+        return;
+    }
+
+    this->handler(packet, this->handler_user);
+}
+
+void LoopbackClientTransport::CompleteRequest(const uint64_t request_id, LoopbackPacket* const packet) {
+    {
+        std::lock_guard<std::mutex> lock(this->requests_mutex);
+
+        auto it = this->pending_requests.find(request_id);
+
+        // The request already timed out
+        if (it == this->pending_requests.end() || it->second != nullptr) {
+            delete packet;
+            return;
+        }
+
+        it->second = packet;
+    }
+
+    this->requests_condition.notify_all();
+}
+
+bool LoopbackClientTransport::IsConnected() {
+    return this->connected;
+}
+
+in_addr LoopbackClientTransport::GetAddress() {
+    return this->address;
+}
+
+uint16_t LoopbackClientTransport::GetPort() {
+    return this->port;
+}
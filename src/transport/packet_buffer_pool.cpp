@@ -0,0 +1,142 @@
+#include "transport.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../utils/metrics/metrics.hpp"
+
+using namespace transport;
+
+struct PoolMetrics {
+    utils::metrics::MetricId acquired[PACKET_BUFFER_SIZE_CLASSES];
+    utils::metrics::MetricId allocated[PACKET_BUFFER_SIZE_CLASSES];
+    utils::metrics::MetricId in_use[PACKET_BUFFER_SIZE_CLASSES];
+    utils::metrics::MetricId high_water[PACKET_BUFFER_SIZE_CLASSES];
+    utils::metrics::MetricId oversized;
+};
+
+static PoolMetrics CreatePoolMetrics() {
+    PoolMetrics metrics;
+
+    for (uint32_t i = 0; i < PACKET_BUFFER_SIZE_CLASSES; i++) {
+        const std::string prefix = "transport.buffer_pool." + std::to_string(GetPacketBufferClassSize(i));
+
+        metrics.acquired[i] = utils::metrics::RegisterCounter((prefix + ".acquired").c_str());
+        metrics.allocated[i] = utils::metrics::RegisterCounter((prefix + ".allocated").c_str());
+        metrics.in_use[i] = utils::metrics::RegisterGauge((prefix + ".in_use").c_str());
+        metrics.high_water[i] = utils::metrics::RegisterGauge((prefix + ".high_water").c_str());
+    }
+
+    metrics.oversized = utils::metrics::RegisterCounter("transport.buffer_pool.oversized");
+
+    return metrics;
+}
+
+static const PoolMetrics& GetPoolMetrics() {
+    static const PoolMetrics metrics = CreatePoolMetrics();
+
+    return metrics;
+}
+
+// Buffers out of every thread's pool, the high water mark is the most ever out at once
+static std::atomic<int64_t> buffers_in_use[PACKET_BUFFER_SIZE_CLASSES];
+static std::atomic<int64_t> buffers_high_water[PACKET_BUFFER_SIZE_CLASSES];
+
+struct ThreadBufferPool {
+    std::vector<PacketBuffer*> free_buffers[PACKET_BUFFER_SIZE_CLASSES];
+
+    ThreadBufferPool() {
+        for (auto& buffers : this->free_buffers) {
+            buffers.reserve(PACKET_BUFFER_POOL_MAX_FREE);
+        }
+    }
+
+    ~ThreadBufferPool() {
+        for (auto& buffers : this->free_buffers) {
+            for (auto buffer : buffers) {
+                delete buffer;
+            }
+        }
+    }
+};
+
+static thread_local ThreadBufferPool thread_pool;
+
+uint32_t transport::GetPacketBufferSizeClass(const uint32_t size) {
+    uint32_t size_class = 0;
+
+    while (size_class < PACKET_BUFFER_SIZE_CLASSES && GetPacketBufferClassSize(size_class) < size) {
+        size_class++;
+    }
+
+    return size_class;
+}
+
+uint32_t transport::GetPacketBufferClassSize(const uint32_t size_class) {
+    return PACKET_BUFFER_MIN_CLASS_SIZE << size_class;
+}
+
+PooledPacketBuffer::PooledPacketBuffer(const uint32_t size) : size_class(GetPacketBufferSizeClass(size)) {
+    const PoolMetrics& metrics = GetPoolMetrics();
+
+    if (this->size_class == PACKET_BUFFER_SIZE_CLASSES) {
+        utils::metrics::IncrementCounter(metrics.oversized);
+
+        this->buffer = new PacketBuffer(size);
+
+        return;
+    }
+
+    std::vector<PacketBuffer*>& free_buffers = thread_pool.free_buffers[this->size_class];
+
+    utils::metrics::IncrementCounter(metrics.acquired[this->size_class]);
+
+    if (free_buffers.empty()) {
+        utils::metrics::IncrementCounter(metrics.allocated[this->size_class]);
+
+        this->buffer = new PacketBuffer(GetPacketBufferClassSize(this->size_class));
+    } else {
+        this->buffer = free_buffers.back();
+
+        free_buffers.pop_back();
+    }
+
+    const int64_t in_use = buffers_in_use[this->size_class].fetch_add(1, std::memory_order_relaxed) + 1;
+
+    utils::metrics::SetGauge(metrics.in_use[this->size_class], in_use);
+
+    int64_t high_water = buffers_high_water[this->size_class].load(std::memory_order_relaxed);
+
+    while (in_use > high_water) {
+        if (buffers_high_water[this->size_class].compare_exchange_weak(high_water, in_use, std::memory_order_relaxed)) {
+            utils::metrics::SetGauge(metrics.high_water[this->size_class], in_use);
+            break;
+        }
+    }
+}
+
+PooledPacketBuffer::~PooledPacketBuffer() {
+    if (this->size_class == PACKET_BUFFER_SIZE_CLASSES) {
+        delete this->buffer;
+        return;
+    }
+
+    const int64_t in_use = buffers_in_use[this->size_class].fetch_sub(1, std::memory_order_relaxed) - 1;
+
+    utils::metrics::SetGauge(GetPoolMetrics().in_use[this->size_class], in_use);
+
+    std::vector<PacketBuffer*>& free_buffers = thread_pool.free_buffers[this->size_class];
+
+    if (free_buffers.size() == PACKET_BUFFER_POOL_MAX_FREE) {
+        delete this->buffer;
+        return;
+    }
+
+    this->buffer->Clear();
+
+    free_buffers.push_back(this->buffer);
+}
+
+PacketBuffer* PooledPacketBuffer::Get() {
+    return this->buffer;
+}
@@ -0,0 +1,270 @@
+#include "transport.hpp"
+#include <cstdint>
+#include <swift_net.h>
+#include "../utils/alloc/alloc.hpp"
+
+using namespace transport;
+
+// SwiftNet buffers of the calling thread by size class. Sends finish before returning, so a buffer is
+// rewound for the next packet instead of being destroyed and created again.
+struct SwiftNetBufferCache {
+    SwiftNetPacketBuffer server_buffers[PACKET_BUFFER_SIZE_CLASSES] = {};
+    SwiftNetPacketBuffer client_buffers[PACKET_BUFFER_SIZE_CLASSES] = {};
+
+    ~SwiftNetBufferCache() {
+        for (uint32_t i = 0; i < PACKET_BUFFER_SIZE_CLASSES; i++) {
+            if (this->server_buffers[i].packet_buffer_start != nullptr) {
+                swiftnet_server_destroy_packet_buffer(&this->server_buffers[i]);
+            }
+
+            if (this->client_buffers[i].packet_buffer_start != nullptr) {
+                swiftnet_client_destroy_packet_buffer(&this->client_buffers[i]);
+            }
+        }
+    }
+};
+
+static thread_local SwiftNetBufferCache buffer_cache;
+
+// Holds the SwiftNet copy of a PacketBuffer for one send, only sizes past the largest class are created per send
+class SwiftNetSendBuffer {
+public:
+    SwiftNetSendBuffer(const PacketBuffer* buffer, const bool client) : client(client) {
+        const uint32_t size_class = GetPacketBufferSizeClass(buffer->GetSize());
+
+        if (size_class == PACKET_BUFFER_SIZE_CLASSES) {
+            this->uncached = client ? swiftnet_client_create_packet_buffer(buffer->GetSize()) : swiftnet_server_create_packet_buffer(buffer->GetSize());
+            this->swiftnet_buffer = &this->uncached;
+        } else {
+            this->swiftnet_buffer = client ? &buffer_cache.client_buffers[size_class] : &buffer_cache.server_buffers[size_class];
+
+            if (this->swiftnet_buffer->packet_buffer_start == nullptr) {
+                const uint32_t class_size = GetPacketBufferClassSize(size_class);
+
+                *this->swiftnet_buffer = client ? swiftnet_client_create_packet_buffer(class_size) : swiftnet_server_create_packet_buffer(class_size);
+            } else {
+                this->swiftnet_buffer->packet_append_pointer = this->swiftnet_buffer->packet_data_start;
+            }
+        }
+
+        if (client) {
+            swiftnet_client_append_to_packet(buffer->GetData(), buffer->GetSize(), this->swiftnet_buffer);
+        } else {
+            swiftnet_server_append_to_packet(buffer->GetData(), buffer->GetSize(), this->swiftnet_buffer);
+        }
+    }
+
+    ~SwiftNetSendBuffer() {
+        if (this->swiftnet_buffer != &this->uncached) {
+            return;
+        }
+
+        if (this->client) {
+            swiftnet_client_destroy_packet_buffer(&this->uncached);
+        } else {
+            swiftnet_server_destroy_packet_buffer(&this->uncached);
+        }
+    }
+
+    SwiftNetPacketBuffer* Get() {
+        return this->swiftnet_buffer;
+    }
+private:
+    SwiftNetPacketBuffer* swiftnet_buffer;
+    SwiftNetPacketBuffer uncached = {};
+    bool client;
+};
+
+static void ServerPacketCallback(SwiftNetServerPacketData* packet_data, void* const user) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    SwiftNetServerTransport* const transport = static_cast<SwiftNetServerTransport*>(user);
+
+    SwiftNetPacket* const packet = new SwiftNetPacket(packet_data, transport->GetServer());
+
+    if (transport->GetHandler() == nullptr) {
+        delete packet;
+        return;
+    }
+
+    transport->GetHandler()(packet, transport->GetHandlerUser());
+}
+
+static void ClientPacketCallback(SwiftNetClientPacketData* packet_data, void* const user) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    SwiftNetClientTransport* const transport = static_cast<SwiftNetClientTransport*>(user);
+
+    SwiftNetPacket* const packet = new SwiftNetPacket(packet_data, transport->GetClientConnection());
+
+    if (transport->GetHandler() == nullptr) {
+        delete packet;
+        return;
+    }
+
+    transport->GetHandler()(packet, transport->GetHandlerUser());
+}
+
+SwiftNetPacket::SwiftNetPacket(SwiftNetServerPacketData* server_packet_data, SwiftNetServer* server) : server_packet_data(server_packet_data), server(server) {
+    this->sender = server_packet_data->metadata.sender;
+}
+
+SwiftNetPacket::SwiftNetPacket(SwiftNetClientPacketData* client_packet_data, SwiftNetClientConnection* client_connection) : client_packet_data(client_packet_data), client_connection(client_connection) {
+
+}
+
+SwiftNetPacket::~SwiftNetPacket() {
+    if (this->server_packet_data != nullptr) {
+        swiftnet_server_destroy_packet_data(this->server_packet_data, this->server);
+    }
+
+    if (this->client_packet_data != nullptr) {
+        swiftnet_client_destroy_packet_data(this->client_packet_data, this->client_connection);
+    }
+}
+
+void* SwiftNetPacket::Read(const uint32_t size) {
+    if (this->server_packet_data != nullptr) {
+        return swiftnet_server_read_packet(this->server_packet_data, size);
+    }
+
+    return swiftnet_client_read_packet(this->client_packet_data, size);
+}
+
+SwiftNetServerPacketData* SwiftNetPacket::GetServerPacketData() {
+    return this->server_packet_data;
+}
+
+SwiftNetServerTransport::SwiftNetServerTransport(SwiftNetServer* server) : server(server) {
+
+}
+
+SwiftNetServerTransport::~SwiftNetServerTransport() {
+    swiftnet_server_cleanup(this->GetServer());
+}
+
+void SwiftNetServerTransport::SetMessageHandler(PacketHandler handler, void* const user) {
+    this->handler = handler;
+    this->handler_user = user;
+
+    swiftnet_server_set_message_handler(this->GetServer(), ServerPacketCallback, this);
+}
+
+void SwiftNetServerTransport::SendPacket(const PacketBuffer* buffer, const ClientAddrData addr_data) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    SwiftNetSendBuffer swiftnet_buffer(buffer, false);
+
+    swiftnet_server_send_packet(this->GetServer(), swiftnet_buffer.Get(), addr_data);
+}
+
+// SwiftNet writes its headers into the buffer on every send, so the payload is copied in only once per batch
+void SwiftNetServerTransport::SendPacketBatch(const PacketBuffer* buffer, const ClientAddrData* addr_data, const uint32_t addr_data_len) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    if (addr_data_len == 0) {
+        return;
+    }
+
+    SwiftNetSendBuffer swiftnet_buffer(buffer, false);
+
+    for (uint32_t i = 0; i < addr_data_len; i++) {
+        swiftnet_server_send_packet(this->GetServer(), swiftnet_buffer.Get(), addr_data[i]);
+    }
+}
+
+void SwiftNetServerTransport::MakeResponse(Packet* const request, const PacketBuffer* buffer) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    SwiftNetSendBuffer swiftnet_buffer(buffer, false);
+
+    swiftnet_server_make_response(this->GetServer(), static_cast<SwiftNetPacket*>(request)->GetServerPacketData(), swiftnet_buffer.Get());
+}
+
+Packet* SwiftNetServerTransport::MakeRequest(const PacketBuffer* buffer, const ClientAddrData addr_data, const uint32_t timeout_ms) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    SwiftNetServerPacketData* response;
+
+    {
+        SwiftNetSendBuffer swiftnet_buffer(buffer, false);
+
+        response = swiftnet_server_make_request(this->GetServer(), swiftnet_buffer.Get(), addr_data, timeout_ms);
+    }
+
+    if (response == nullptr) {
+        return nullptr;
+    }
+
+    return new SwiftNetPacket(response, this->GetServer());
+}
+
+// SwiftNet hands packets to the callback as they arrive and keeps no queue the server could inspect
+uint32_t SwiftNetServerTransport::GetQueuedPackets() {
+    return 0;
+}
+
+SwiftNetServer* SwiftNetServerTransport::GetServer() {
+    return this->server;
+}
+
+PacketHandler SwiftNetServerTransport::GetHandler() {
+    return this->handler;
+}
+
+void* SwiftNetServerTransport::GetHandlerUser() {
+    return this->handler_user;
+}
+
+SwiftNetClientTransport::SwiftNetClientTransport(SwiftNetClientConnection* client_connection) : client_connection(client_connection) {
+
+}
+
+SwiftNetClientTransport::~SwiftNetClientTransport() {
+    swiftnet_client_cleanup(this->GetClientConnection());
+}
+
+void SwiftNetClientTransport::SetMessageHandler(PacketHandler handler, void* const user) {
+    this->handler = handler;
+    this->handler_user = user;
+
+    swiftnet_client_set_message_handler(this->GetClientConnection(), ClientPacketCallback, this);
+}
+
+void SwiftNetClientTransport::SendPacket(const PacketBuffer* buffer) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    SwiftNetSendBuffer swiftnet_buffer(buffer, true);
+
+    swiftnet_client_send_packet(this->GetClientConnection(), swiftnet_buffer.Get());
+}
+
+Packet* SwiftNetClientTransport::MakeRequest(const PacketBuffer* buffer, const uint32_t timeout_ms) {
+    ALLOC_SCOPE(TRANSPORT);
+
+    SwiftNetClientPacketData* response;
+
+    {
+        SwiftNetSendBuffer swiftnet_buffer(buffer, true);
+
+        response = swiftnet_client_make_request(this->GetClientConnection(), swiftnet_buffer.Get(), timeout_ms);
+    }
+
+    if (response == nullptr) {
+        return nullptr;
+    }
+
+    return new SwiftNetPacket(response, this->GetClientConnection());
+}
+
+SwiftNetClientConnection* SwiftNetClientTransport::GetClientConnection() {
+    return this->client_connection;
+}
+
+PacketHandler SwiftNetClientTransport::GetHandler() {
+    return this->handler;
+}
+
+void* SwiftNetClientTransport::GetHandlerUser() {
+    return this->handler_user;
+}
@@ -0,0 +1,101 @@
+#include "transport.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <swift_net.h>
+#include "../protocol/protocol.hpp"
+
+using namespace transport;
+
+static std::atomic<Backend> default_backend = SWIFTNET_BACKEND;
+
+PacketBuffer::PacketBuffer(const uint32_t size) {
+    this->data.reserve(size);
+}
+
+PacketBuffer::~PacketBuffer() = default;
+
+void PacketBuffer::Append(const void* data, const uint32_t size) {
+    const size_t offset = this->data.size();
+
+    this->data.resize(offset + size);
+
+    memcpy(this->data.data() + offset, data, size);
+}
+
+void PacketBuffer::Clear() {
+    this->data.clear();
+}
+
+const uint8_t* PacketBuffer::GetData() const {
+    return this->data.data();
+}
+
+uint32_t PacketBuffer::GetSize() const {
+    return this->data.size();
+}
+
+ClientAddrData Packet::GetSender() {
+    return this->sender;
+}
+
+void transport::SetDefaultBackend(const Backend backend) {
+    default_backend.store(backend, std::memory_order_release);
+}
+
+Backend transport::GetDefaultBackend() {
+    return default_backend.load(std::memory_order_acquire);
+}
+
+void transport::Initialize() {
+    if (GetDefaultBackend() == SWIFTNET_BACKEND) {
+        swiftnet_initialize();
+    }
+}
+
+void transport::Cleanup() {
+    if (GetDefaultBackend() == SWIFTNET_BACKEND) {
+        swiftnet_cleanup();
+    }
+}
+
+ServerTransport* transport::CreateServer(const uint16_t port) {
+    if (GetDefaultBackend() == LOOPBACK_BACKEND) {
+        LoopbackServerTransport* const server = new LoopbackServerTransport(port);
+
+        if (!server->IsBound()) {
+            delete server;
+            return nullptr;
+        }
+
+        return server;
+    }
+
+    SwiftNetServer* const server = swiftnet_create_server(port, LOOPBACK);
+    if (server == nullptr) {
+        return nullptr;
+    }
+
+    return new SwiftNetServerTransport(server);
+}
+
+ClientTransport* transport::CreateClient(const char* ip_address, const uint16_t port, const uint32_t timeout_ms) {
+    if (GetDefaultBackend() == LOOPBACK_BACKEND) {
+        LoopbackClientTransport* const client = new LoopbackClientTransport(port);
+
+        // Mirrors SwiftNet failing to connect when nothing listens on the port
+        if (!client->IsConnected()) {
+            delete client;
+            return nullptr;
+        }
+
+        return client;
+    }
+
+    SwiftNetClientConnection* const client_connection = swiftnet_create_client(ip_address, port, timeout_ms);
+    if (client_connection == nullptr) {
+        return nullptr;
+    }
+
+    return new SwiftNetClientTransport(client_connection);
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <netinet/in.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <swift_net.h>
+
+// Pooled buffer capacities are 64 << class, from 64 bytes to 16 KB
+#define PACKET_BUFFER_SIZE_CLASSES 5
+#define PACKET_BUFFER_MIN_CLASS_SIZE 64
+#define PACKET_BUFFER_POOL_MAX_FREE 32
+
+namespace transport {
+    // Plain address data, the loopback backend only fills in sender_address
+    typedef SwiftNetClientAddrData ClientAddrData;
+
+    enum Backend {
+        SWIFTNET_BACKEND,
+        LOOPBACK_BACKEND
+    };
+
+    // Outgoing packet, owned by the caller and copied by the backend on send
+    class PacketBuffer {
+    public:
+        PacketBuffer(const uint32_t size);
+        ~PacketBuffer();
+
+        void Append(const void* data, const uint32_t size);
+        void Clear();
+
+        const uint8_t* GetData() const;
+        uint32_t GetSize() const;
+    private:
+        std::vector<uint8_t> data;
+    };
+
+    // Smallest class whose capacity fits the size, PACKET_BUFFER_SIZE_CLASSES when none does
+    uint32_t GetPacketBufferSizeClass(const uint32_t size);
+    uint32_t GetPacketBufferClassSize(const uint32_t size_class);
+
+    // Takes a cleared PacketBuffer from the calling thread's pool and gives it back to the releasing thread's pool.
+    // Sizes past the largest class are allocated and freed as before.
+    class PooledPacketBuffer {
+    public:
+        PooledPacketBuffer(const uint32_t size);
+        ~PooledPacketBuffer();
+
+        PooledPacketBuffer(const PooledPacketBuffer&) = delete;
+        PooledPacketBuffer& operator=(const PooledPacketBuffer&) = delete;
+
+        PacketBuffer* Get();
+
+        PacketBuffer* operator->() {
+            return this->buffer;
+        }
+    private:
+        PacketBuffer* buffer;
+        uint32_t size_class;
+    };
+
+    // Incoming packet, whoever receives it deletes it
+    class Packet {
+    public:
+        virtual ~Packet() = default;
+
+        virtual void* Read(const uint32_t size) = 0;
+
+        ClientAddrData GetSender();
+    protected:
+        ClientAddrData sender = {};
+    };
+
+    typedef void (*PacketHandler)(Packet* const packet, void* const user);
+
+    class ServerTransport {
+    public:
+        virtual ~ServerTransport() = default;
+
+        virtual void SetMessageHandler(PacketHandler handler, void* const user) = 0;
+        virtual void SendPacket(const PacketBuffer* buffer, const ClientAddrData addr_data) = 0;
+
+        // Sends one payload to every address, the backend prepares it once for the whole list
+        virtual void SendPacketBatch(const PacketBuffer* buffer, const ClientAddrData* addr_data, const uint32_t addr_data_len) = 0;
+
+        virtual void MakeResponse(Packet* const request, const PacketBuffer* buffer) = 0;
+        virtual Packet* MakeRequest(const PacketBuffer* buffer, const ClientAddrData addr_data, const uint32_t timeout_ms) = 0;
+
+        // Received packets still waiting for the handler, zero when the backend can't tell
+        virtual uint32_t GetQueuedPackets() = 0;
+    };
+
+    class ClientTransport {
+    public:
+        virtual ~ClientTransport() = default;
+
+        virtual void SetMessageHandler(PacketHandler handler, void* const user) = 0;
+        virtual void SendPacket(const PacketBuffer* buffer) = 0;
+        virtual Packet* MakeRequest(const PacketBuffer* buffer, const uint32_t timeout_ms) = 0;
+    };
+
+    class SwiftNetPacket : public Packet {
+    public:
+        SwiftNetPacket(SwiftNetServerPacketData* server_packet_data, SwiftNetServer* server);
+        SwiftNetPacket(SwiftNetClientPacketData* client_packet_data, SwiftNetClientConnection* client_connection);
+        ~SwiftNetPacket();
+
+        void* Read(const uint32_t size) override;
+
+        SwiftNetServerPacketData* GetServerPacketData();
+    private:
+        SwiftNetServerPacketData* server_packet_data = nullptr;
+        SwiftNetServer* server = nullptr;
+
+        SwiftNetClientPacketData* client_packet_data = nullptr;
+        SwiftNetClientConnection* client_connection = nullptr;
+    };
+
+    class SwiftNetServerTransport : public ServerTransport {
+    public:
+        SwiftNetServerTransport(SwiftNetServer* server);
+        ~SwiftNetServerTransport();
+
+        void SetMessageHandler(PacketHandler handler, void* const user) override;
+        void SendPacket(const PacketBuffer* buffer, const ClientAddrData addr_data) override;
+        void SendPacketBatch(const PacketBuffer* buffer, const ClientAddrData* addr_data, const uint32_t addr_data_len) override;
+        void MakeResponse(Packet* const request, const PacketBuffer* buffer) override;
+        Packet* MakeRequest(const PacketBuffer* buffer, const ClientAddrData addr_data, const uint32_t timeout_ms) override;
+        uint32_t GetQueuedPackets() override;
+
+        SwiftNetServer* GetServer();
+        PacketHandler GetHandler();
+        void* GetHandlerUser();
+    private:
+        SwiftNetServer* server;
+
+        PacketHandler handler = nullptr;
+        void* handler_user = nullptr;
+    };
+
+    class SwiftNetClientTransport : public ClientTransport {
+    public:
+        SwiftNetClientTransport(SwiftNetClientConnection* client_connection);
+        ~SwiftNetClientTransport();
+
+        void SetMessageHandler(PacketHandler handler, void* const user) override;
+        void SendPacket(const PacketBuffer* buffer) override;
+        Packet* MakeRequest(const PacketBuffer* buffer, const uint32_t timeout_ms) override;
+
+        SwiftNetClientConnection* GetClientConnection();
+        PacketHandler GetHandler();
+        void* GetHandlerUser();
+    private:
+        SwiftNetClientConnection* client_connection;
+
+        PacketHandler handler = nullptr;
+        void* handler_user = nullptr;
+    };
+
+    class LoopbackPacket : public Packet {
+    public:
+        LoopbackPacket(const PacketBuffer* buffer, const in_addr sender_address, const uint64_t request_id);
+        ~LoopbackPacket() = default;
+
+        void* Read(const uint32_t size) override;
+
+        uint64_t GetRequestId();
+    private:
+        std::vector<uint8_t> data;
+        uint32_t read_offset = 0;
+
+        // Zero for packets nobody waits a response for
+        uint64_t request_id;
+    };
+
+    // In-process server endpoint, packets are queued and handled on its own thread like a SwiftNet server
+    class LoopbackServerTransport : public ServerTransport {
+    public:
+        LoopbackServerTransport(const uint16_t port);
+        ~LoopbackServerTransport();
+
+        void SetMessageHandler(PacketHandler handler, void* const user) override;
+        void SendPacket(const PacketBuffer* buffer, const ClientAddrData addr_data) override;
+        void SendPacketBatch(const PacketBuffer* buffer, const ClientAddrData* addr_data, const uint32_t addr_data_len) override;
+        void MakeResponse(Packet* const request, const PacketBuffer* buffer) override;
+        Packet* MakeRequest(const PacketBuffer* buffer, const ClientAddrData addr_data, const uint32_t timeout_ms) override;
+        uint32_t GetQueuedPackets() override;
+
+        void Deliver(LoopbackPacket* const packet);
+
+        bool IsBound();
+        uint16_t GetPort();
+    private:
+        void ProcessPackets();
+
+        uint16_t port;
+
+        // False when another endpoint already listens on the port
+        bool bound = false;
+
+        PacketHandler handler = nullptr;
+        void* handler_user = nullptr;
+
+        std::mutex packets_mutex;
+        std::condition_variable packets_condition;
+        std::deque<LoopbackPacket*> packets;
+        bool stop = false;
+
+        std::thread* packets_thread = nullptr;
+    };
+
+    // In-process client endpoint, every connection gets its own 127.x.x.x address so servers see distinct users
+    class LoopbackClientTransport : public ClientTransport {
+    public:
+        LoopbackClientTransport(const uint16_t port);
+        ~LoopbackClientTransport();
+
+        void SetMessageHandler(PacketHandler handler, void* const user) override;
+        void SendPacket(const PacketBuffer* buffer) override;
+        Packet* MakeRequest(const PacketBuffer* buffer, const uint32_t timeout_ms) override;
+
+        void Dispatch(LoopbackPacket* const packet, std::unique_lock<std::mutex>& registry_lock);
+        void CompleteRequest(const uint64_t request_id, LoopbackPacket* const packet);
+
+        bool IsConnected();
+        in_addr GetAddress();
+        uint16_t GetPort();
+    private:
+        in_addr address = {};
+        uint16_t port;
+
+        // False when no server listens on the port
+        bool connected = false;
+
+        // Held while the handler runs, so the destructor waits for an in-flight dispatch
+        std::mutex handler_mutex;
+        PacketHandler handler = nullptr;
+        void* handler_user = nullptr;
+
+        std::mutex requests_mutex;
+        std::condition_variable requests_condition;
+        std::unordered_map<uint64_t, LoopbackPacket*> pending_requests;
+        uint64_t next_request_id = 1;
+    };
+
+    void SetDefaultBackend(const Backend backend);
+    Backend GetDefaultBackend();
+
+    void Initialize();
+    void Cleanup();
+
+    // Both return nullptr when the endpoint can't be created or reached
+    ServerTransport* CreateServer(const uint16_t port);
+    ClientTransport* CreateClient(const char* ip_address, const uint16_t port, const uint32_t timeout_ms);
+}
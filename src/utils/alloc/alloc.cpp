@@ -0,0 +1,203 @@
+#include "alloc.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include <string>
+
+using namespace utils::alloc;
+
+static const char* const subsystem_names[] = {"untagged", "server", "database", "transport", "client"};
+
+// Owned by one thread, except the overflow slot, so the adds never contend
+struct alignas(64) AllocationCounters {
+    std::atomic<uint64_t> allocations[SUBSYSTEMS_LEN];
+    std::atomic<uint64_t> bytes_allocated[SUBSYSTEMS_LEN];
+    std::atomic<uint64_t> frees[SUBSYSTEMS_LEN];
+    std::atomic<uint64_t> bytes_freed[SUBSYSTEMS_LEN];
+};
+
+// Zero initialized statics, usable by allocations made before main and after exit
+static AllocationCounters counters[MAX_ALLOCATION_THREADS + 1];
+static std::atomic<uint32_t> next_counters_slot;
+
+thread_local Subsystem utils::alloc::current_subsystem = UNTAGGED;
+
+static thread_local AllocationCounters* thread_counters = nullptr;
+static thread_local uint64_t thread_allocations = 0;
+
+static AllocationCounters* GetThreadCounters() {
+    if (thread_counters == nullptr) {
+        const uint32_t slot = next_counters_slot.fetch_add(1, std::memory_order_relaxed);
+
+        thread_counters = &counters[slot < MAX_ALLOCATION_THREADS ? slot : MAX_ALLOCATION_THREADS];
+    }
+
+    return thread_counters;
+}
+
+static void* RecordAllocation(void* pointer) {
+    if (pointer == nullptr) {
+        return nullptr;
+    }
+
+    AllocationCounters* const thread = GetThreadCounters();
+    const Subsystem subsystem = current_subsystem;
+
+    thread->allocations[subsystem].fetch_add(1, std::memory_order_relaxed);
+    thread->bytes_allocated[subsystem].fetch_add(malloc_usable_size(pointer), std::memory_order_relaxed);
+
+    thread_allocations++;
+
+    return pointer;
+}
+
+static void RecordFree(void* pointer) {
+    if (pointer == nullptr) {
+        return;
+    }
+
+    AllocationCounters* const thread = GetThreadCounters();
+    const Subsystem subsystem = current_subsystem;
+
+    thread->frees[subsystem].fetch_add(1, std::memory_order_relaxed);
+    thread->bytes_freed[subsystem].fetch_add(malloc_usable_size(pointer), std::memory_order_relaxed);
+
+    free(pointer);
+}
+
+static void* AllocateAligned(const size_t size, const size_t alignment) {
+    void* pointer = nullptr;
+
+    if (posix_memalign(&pointer, alignment < sizeof(void*) ? sizeof(void*) : alignment, size == 0 ? 1 : size) != 0) {
+        return nullptr;
+    }
+
+    return RecordAllocation(pointer);
+}
+
+void* operator new(size_t size) {
+    void* const pointer = RecordAllocation(malloc(size == 0 ? 1 : size));
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return RecordAllocation(malloc(size == 0 ? 1 : size));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return RecordAllocation(malloc(size == 0 ? 1 : size));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* const pointer = AllocateAligned(size, static_cast<size_t>(alignment));
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    RecordFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    RecordFree(pointer);
+}
+
+AllocationStats utils::alloc::GetStats(const Subsystem subsystem) {
+    AllocationStats stats = {};
+
+    for (const auto& thread : counters) {
+        stats.allocations += thread.allocations[subsystem].load(std::memory_order_relaxed);
+        stats.bytes_allocated += thread.bytes_allocated[subsystem].load(std::memory_order_relaxed);
+        stats.frees += thread.frees[subsystem].load(std::memory_order_relaxed);
+        stats.bytes_freed += thread.bytes_freed[subsystem].load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
+uint64_t utils::alloc::GetThreadAllocations() {
+    return thread_allocations;
+}
+
+std::string utils::alloc::FormatStats() {
+    std::string result;
+
+    char line[192];
+
+    for (uint32_t i = 0; i < SUBSYSTEMS_LEN; i++) {
+        const AllocationStats stats = GetStats(static_cast<Subsystem>(i));
+
+        snprintf(line, sizeof(line), "alloc %s allocations=%llu bytes=%llu frees=%llu bytes_freed=%llu\n", subsystem_names[i], (unsigned long long)stats.allocations, (unsigned long long)stats.bytes_allocated, (unsigned long long)stats.frees, (unsigned long long)stats.bytes_freed);
+
+        result += line;
+    }
+
+    return result;
+}
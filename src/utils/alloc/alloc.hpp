@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Threads past the limit share one overflow slot
+#define MAX_ALLOCATION_THREADS 256
+
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+
+// Attributes the calling thread's heap allocations to the subsystem until the scope ends, scopes nest
+#define ALLOC_SCOPE(subsystem) utils::alloc::ScopedSubsystem ALLOC_CONCAT(alloc_scope_, __LINE__)(utils::alloc::subsystem)
+
+namespace utils::alloc {
+    enum Subsystem : uint8_t {
+        UNTAGGED,
+        SERVER,
+        DATABASE,
+        TRANSPORT,
+        CLIENT,
+        SUBSYSTEMS_LEN
+    };
+
+    // Frees count against the subsystem active when the memory is freed, not where it was allocated
+    struct AllocationStats {
+        uint64_t allocations;
+        uint64_t bytes_allocated;
+        uint64_t frees;
+        uint64_t bytes_freed;
+    };
+
+    extern thread_local Subsystem current_subsystem;
+
+    // Sums the counters of every thread, counting covers operator new and delete only, not malloc
+    AllocationStats GetStats(const Subsystem subsystem);
+
+    // Allocations made by the calling thread in any subsystem
+    uint64_t GetThreadAllocations();
+
+    // One line per subsystem, in the same format as the metrics snapshot
+    std::string FormatStats();
+
+    class ScopedSubsystem {
+    public:
+        ScopedSubsystem(const Subsystem subsystem) : previous(current_subsystem) {
+            current_subsystem = subsystem;
+        }
+
+        ~ScopedSubsystem() {
+            current_subsystem = this->previous;
+        }
+    private:
+        Subsystem previous;
+    };
+}
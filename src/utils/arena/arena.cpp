@@ -0,0 +1,111 @@
+#include "arena.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace utils::arena;
+
+Arena::Arena(const size_t chunk_size) : chunk_size(chunk_size) {
+
+}
+
+Arena::~Arena() {
+    this->Release();
+}
+
+Arena::Arena(Arena&& other) : chunk_size(other.chunk_size), chunks(std::move(other.chunks)), chunk_index(other.chunk_index), chunk_offset(other.chunk_offset), bytes_used(other.bytes_used), oversized(std::move(other.oversized)), oversized_bytes(other.oversized_bytes) {
+    other.chunks.clear();
+    other.oversized.clear();
+    other.chunk_index = 0;
+    other.chunk_offset = 0;
+    other.bytes_used = 0;
+    other.oversized_bytes = 0;
+}
+
+Arena& Arena::operator=(Arena&& other) {
+    if (this != &other) {
+        this->Release();
+
+        std::swap(this->chunk_size, other.chunk_size);
+        std::swap(this->chunks, other.chunks);
+        std::swap(this->chunk_index, other.chunk_index);
+        std::swap(this->chunk_offset, other.chunk_offset);
+        std::swap(this->bytes_used, other.bytes_used);
+        std::swap(this->oversized, other.oversized);
+        std::swap(this->oversized_bytes, other.oversized_bytes);
+    }
+
+    return *this;
+}
+
+void* Arena::Allocate(const size_t size, const size_t alignment) {
+    if (size + alignment > this->chunk_size) {
+        uint8_t* const block = static_cast<uint8_t*>(::operator new(size));
+
+        this->oversized.push_back(block);
+        this->oversized_bytes += size;
+        this->bytes_used += size;
+
+        return block;
+    }
+
+    while (true) {
+        if (this->chunk_index == this->chunks.size()) {
+            this->chunks.push_back(static_cast<uint8_t*>(::operator new(this->chunk_size)));
+        }
+
+        const size_t offset = (this->chunk_offset + alignment - 1) & ~(alignment - 1);
+
+        if (offset + size <= this->chunk_size) {
+            this->chunk_offset = offset + size;
+            this->bytes_used += size;
+
+            return this->chunks[this->chunk_index] + offset;
+        }
+
+        this->chunk_index++;
+        this->chunk_offset = 0;
+    }
+}
+
+const char* Arena::CopyString(const char* data, const size_t length) {
+    char* const copy = static_cast<char*>(this->Allocate(length + 1, 1));
+
+    memcpy(copy, data, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+void Arena::Reset() {
+    for (auto block : this->oversized) {
+        ::operator delete(block);
+    }
+
+    this->oversized.clear();
+    this->oversized_bytes = 0;
+
+    this->chunk_index = 0;
+    this->chunk_offset = 0;
+    this->bytes_used = 0;
+}
+
+void Arena::Release() {
+    this->Reset();
+
+    for (auto chunk : this->chunks) {
+        ::operator delete(chunk);
+    }
+
+    this->chunks.clear();
+}
+
+size_t Arena::GetBytesUsed() const {
+    return this->bytes_used;
+}
+
+size_t Arena::GetBytesReserved() const {
+    return this->chunks.size() * this->chunk_size + this->oversized_bytes;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+namespace utils::arena {
+    // Bump allocator over fixed chunks. Pointers stay valid until Reset or Release, since chunks never move.
+    class Arena {
+    public:
+        Arena(const size_t chunk_size = ARENA_DEFAULT_CHUNK_SIZE);
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        Arena(Arena&& other);
+        Arena& operator=(Arena&& other);
+
+        // Alignment must be a power of two no larger than alignof(max_align_t)
+        void* Allocate(const size_t size, const size_t alignment = alignof(max_align_t));
+
+        // Copies length bytes and terminates them
+        const char* CopyString(const char* data, const size_t length);
+
+        // Rewinds to the first chunk and keeps every chunk for reuse, only oversized allocations are freed
+        void Reset();
+
+        // Returns every chunk to the allocator
+        void Release();
+
+        size_t GetBytesUsed() const;
+        size_t GetBytesReserved() const;
+    private:
+        size_t chunk_size;
+
+        std::vector<uint8_t*> chunks;
+        size_t chunk_index = 0;
+        size_t chunk_offset = 0;
+        size_t bytes_used = 0;
+
+        // Allocations bigger than a chunk get their own block
+        std::vector<uint8_t*> oversized;
+        size_t oversized_bytes = 0;
+    };
+}
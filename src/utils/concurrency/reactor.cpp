@@ -0,0 +1,216 @@
+#include "reactor.hpp"
+#include <algorithm>
+
+using namespace utils::concurrency;
+
+Reactor::Reactor(const uint32_t threads_len) {
+    for (uint32_t i = 0; i < threads_len; i++) {
+        this->threads.push_back(new std::thread([this]() {
+            this->WorkerLoop();
+        }));
+    }
+}
+
+Reactor::~Reactor() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        this->stop = true;
+    }
+
+    this->work_condition.notify_all();
+
+    for (auto thread : this->threads) {
+        thread->join();
+
+        delete thread;
+    }
+}
+
+Reactor::TimePoint Reactor::GetAlignedDeadline(const std::chrono::milliseconds interval, const TimePoint now) {
+    const auto since_epoch = now.time_since_epoch();
+
+    return TimePoint((since_epoch / interval + 1) * interval);
+}
+
+bool Reactor::DeadlineAfter(const Deadline& a, const Deadline& b) {
+    return a.at > b.at;
+}
+
+bool Reactor::IsCurrent(const Deadline& deadline) {
+    const TaskState& state = this->tasks[deadline.id];
+
+    return !state.removed && !state.running && state.next_run == deadline.at;
+}
+
+// Called with the mutex held
+void Reactor::Schedule(const ReactorTaskId id, const TimePoint at) {
+    TaskState& state = this->tasks[id];
+
+    if (at >= state.next_run) {
+        return;
+    }
+
+    const bool earliest = this->deadlines.empty() || at < this->deadlines.front().at;
+
+    state.next_run = at;
+
+    this->deadlines.push_back((Deadline){
+        .at = at,
+        .id = id
+    });
+
+    std::push_heap(this->deadlines.begin(), this->deadlines.end(), DeadlineAfter);
+
+    // The timed waiter has to see the earlier deadline too, not only whichever thread a single notify picks
+    if (earliest) {
+        this->work_condition.notify_all();
+    }
+}
+
+void Reactor::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (true) {
+        if (this->stop) {
+            return;
+        }
+
+        while (!this->deadlines.empty() && !this->IsCurrent(this->deadlines.front())) {
+            std::pop_heap(this->deadlines.begin(), this->deadlines.end(), DeadlineAfter);
+            this->deadlines.pop_back();
+        }
+
+        if (this->deadlines.empty()) {
+            this->work_condition.wait(lock);
+            continue;
+        }
+
+        const Deadline next = this->deadlines.front();
+
+        if (next.at > std::chrono::steady_clock::now()) {
+            if (this->timed_waiter) {
+                this->work_condition.wait(lock);
+                continue;
+            }
+
+            this->timed_waiter = true;
+            this->work_condition.wait_until(lock, next.at);
+            this->timed_waiter = false;
+
+            continue;
+        }
+
+        std::pop_heap(this->deadlines.begin(), this->deadlines.end(), DeadlineAfter);
+        this->deadlines.pop_back();
+
+        TaskState& state = this->tasks[next.id];
+
+        state.running = true;
+        state.next_run = TimePoint::max();
+
+        const ReactorTask task = state.task;
+        void* const context = state.context;
+
+        // Someone else takes the next due task or the timed wait
+        if (!this->deadlines.empty()) {
+            this->work_condition.notify_one();
+        }
+
+        lock.unlock();
+
+        task(context);
+
+        lock.lock();
+
+        // Tasks may have grown while running
+        TaskState& finished = this->tasks[next.id];
+
+        finished.running = false;
+
+        if (finished.removed) {
+            this->removed_condition.notify_all();
+            continue;
+        }
+
+        const TimePoint now = std::chrono::steady_clock::now();
+
+        if (finished.rerun) {
+            finished.rerun = false;
+
+            this->Schedule(next.id, now);
+        } else if (finished.interval.count() > 0) {
+            this->Schedule(next.id, GetAlignedDeadline(finished.interval, now));
+        }
+    }
+}
+
+ReactorTaskId Reactor::AddTask(const ReactorTask task, void* const context, const std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    ReactorTaskId id;
+
+    if (!this->free_tasks.empty()) {
+        id = this->free_tasks.back();
+        this->free_tasks.pop_back();
+    } else {
+        id = this->tasks.size();
+        this->tasks.emplace_back();
+    }
+
+    this->tasks[id] = (TaskState){
+        .task = task,
+        .context = context,
+        .interval = interval,
+        .next_run = TimePoint::max(),
+        .running = false,
+        .rerun = false,
+        .removed = false
+    };
+
+    if (interval.count() > 0) {
+        this->Schedule(id, GetAlignedDeadline(interval, std::chrono::steady_clock::now()));
+    }
+
+    return id;
+}
+
+void Reactor::RemoveTask(const ReactorTaskId id) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->tasks[id].removed = true;
+    this->tasks[id].next_run = TimePoint::max();
+
+    this->removed_condition.wait(lock, [this, id]() {
+        return !this->tasks[id].running;
+    });
+
+    this->free_tasks.push_back(id);
+}
+
+void Reactor::Wake(const ReactorTaskId id) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    TaskState& state = this->tasks[id];
+
+    if (state.removed) {
+        return;
+    }
+
+    if (state.running) {
+        state.rerun = true;
+        return;
+    }
+
+    this->Schedule(id, std::chrono::steady_clock::now());
+}
+
+uint32_t Reactor::GetThreadsLen() {
+    return this->threads.size();
+}
+
+Reactor& utils::concurrency::GetReactor() {
+    static Reactor reactor(std::max(std::thread::hardware_concurrency(), 2u));
+
+    return reactor;
+}
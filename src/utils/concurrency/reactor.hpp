@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils::concurrency {
+    typedef void (*ReactorTask)(void* context);
+    typedef uint32_t ReactorTaskId;
+
+    // Process wide timers and event loop on a fixed set of threads, so the thread count doesn't grow with what is registered.
+    // A task never runs on two threads at once, whatever one task touches needs no lock against itself.
+    class Reactor {
+    public:
+        typedef std::chrono::steady_clock::time_point TimePoint;
+
+        Reactor(uint32_t threads_len);
+        ~Reactor();
+
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        // A zero interval only runs the task when woken. Repeating deadlines fall on multiples of the interval,
+        // so every task sharing an interval comes due on the same wake-up.
+        ReactorTaskId AddTask(ReactorTask task, void* context, std::chrono::milliseconds interval);
+        // Returns once a run in progress finished, the task never runs again. Never called from the task itself.
+        void RemoveTask(ReactorTaskId id);
+        // Runs the task as soon as a thread is free, or once more right after the run in progress
+        void Wake(ReactorTaskId id);
+
+        uint32_t GetThreadsLen();
+
+        // The next multiple of the interval since the clock's epoch, when a repeating task comes due after now
+        static TimePoint GetAlignedDeadline(std::chrono::milliseconds interval, TimePoint now);
+    private:
+        struct TaskState {
+            ReactorTask task;
+            void* context;
+            std::chrono::milliseconds interval;
+
+            // The deadline the task is queued for, TimePoint::max() while it is not
+            TimePoint next_run;
+
+            bool running;
+            bool rerun;
+            bool removed;
+        };
+
+        // Deadlines are never taken out of the heap early, one that no longer matches its task is skipped
+        struct Deadline {
+            TimePoint at;
+            ReactorTaskId id;
+        };
+
+        static bool DeadlineAfter(const Deadline& a, const Deadline& b);
+
+        void WorkerLoop();
+        void Schedule(ReactorTaskId id, TimePoint at);
+        bool IsCurrent(const Deadline& deadline);
+
+        std::vector<std::thread*> threads;
+
+        std::mutex mutex;
+        std::condition_variable work_condition;
+        std::condition_variable removed_condition;
+
+        std::vector<TaskState> tasks;
+        std::vector<ReactorTaskId> free_tasks;
+
+        // Min heap on the deadline
+        std::vector<Deadline> deadlines;
+
+        // Only one idle thread sleeps until the earliest deadline, the others wait to be woken
+        bool timed_waiter = false;
+        bool stop = false;
+    };
+
+    // Created on first use with one thread per core, at least two
+    Reactor& GetReactor();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace utils::concurrency {
+    // Bounded lock-free queue for exactly one producer thread and one consumer thread.
+    // Items are moved in and out, capacity must be a power of two.
+    template <typename T, size_t Capacity>
+    class SpscQueue {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+    public:
+        SpscQueue() = default;
+        ~SpscQueue() = default;
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        bool TryPush(T&& item) {
+            const size_t tail = this->tail.load(std::memory_order_relaxed);
+
+            if (tail - this->cached_head == Capacity) {
+                this->cached_head = this->head.load(std::memory_order_acquire);
+
+                if (tail - this->cached_head == Capacity) {
+                    return false;
+                }
+            }
+
+            this->items[tail & (Capacity - 1)] = std::move(item);
+
+            this->tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool TryPop(T& item) {
+            const size_t head = this->head.load(std::memory_order_relaxed);
+
+            if (head == this->cached_tail) {
+                this->cached_tail = this->tail.load(std::memory_order_acquire);
+
+                if (head == this->cached_tail) {
+                    return false;
+                }
+            }
+
+            item = std::move(this->items[head & (Capacity - 1)]);
+
+            this->head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool Empty() const {
+            return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+        }
+    private:
+        static constexpr size_t cache_line_size = 64;
+
+        // Producer and consumer indices live on separate cache lines so the two threads don't false share
+        alignas(cache_line_size) std::atomic<size_t> head = 0;
+        size_t cached_tail = 0;
+
+        alignas(cache_line_size) std::atomic<size_t> tail = 0;
+        size_t cached_head = 0;
+
+        alignas(cache_line_size) T items[Capacity];
+    };
+}
@@ -0,0 +1,112 @@
+#include "worker_pool.hpp"
+
+using namespace utils::concurrency;
+
+WorkerPool::WorkerPool(const uint32_t threads_len) {
+    // The caller is one of the threads
+    for (uint32_t i = 1; i < threads_len; i++) {
+        this->threads.push_back(new std::thread([this]() {
+            this->WorkerLoop();
+        }));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        this->stop = true;
+    }
+
+    this->start_condition.notify_all();
+
+    for (auto thread : this->threads) {
+        thread->join();
+
+        delete thread;
+    }
+}
+
+void WorkerPool::RunTasks() {
+    while (true) {
+        const size_t index = this->next_task.fetch_add(1, std::memory_order_relaxed);
+        if (index >= this->tasks_len) {
+            return;
+        }
+
+        this->task(this->context, index);
+    }
+}
+
+void WorkerPool::WorkerLoop() {
+    uint64_t seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            this->start_condition.wait(lock, [this, seen_generation]() {
+                return this->stop || this->generation != seen_generation;
+            });
+
+            if (this->stop) {
+                return;
+            }
+
+            seen_generation = this->generation;
+        }
+
+        this->RunTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            this->busy_workers--;
+        }
+
+        this->done_condition.notify_one();
+    }
+}
+
+void WorkerPool::Run(const size_t tasks_len, const WorkerTask task, void* const context) {
+    if (tasks_len == 0) {
+        return;
+    }
+
+    // Not worth waking anyone for a single task
+    if (this->threads.empty() || tasks_len == 1) {
+        for (size_t i = 0; i < tasks_len; i++) {
+            task(context, i);
+        }
+
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(this->run_mutex);
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        this->task = task;
+        this->context = context;
+        this->tasks_len = tasks_len;
+        this->next_task.store(0, std::memory_order_relaxed);
+        this->busy_workers = this->threads.size();
+        this->generation++;
+    }
+
+    this->start_condition.notify_all();
+
+    this->RunTasks();
+
+    // Workers still read the task fields until they check out, so those stay valid until then
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->done_condition.wait(lock, [this]() {
+        return this->busy_workers == 0;
+    });
+}
+
+uint32_t WorkerPool::GetThreadsLen() {
+    return this->threads.size() + 1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils::concurrency {
+    typedef void (*WorkerTask)(void* context, size_t index);
+
+    // Fixed set of threads that run one parallel loop at a time, the calling thread takes tasks too.
+    // Tasks are claimed one index at a time, so uneven tasks still spread over every thread. Callers on
+    // different threads take turns.
+    class WorkerPool {
+    public:
+        // A pool of one thread spawns nothing and runs every task on the caller
+        WorkerPool(uint32_t threads_len);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // Calls task(context, i) for every i below tasks_len and returns once all of them finished
+        void Run(size_t tasks_len, WorkerTask task, void* context);
+
+        // Same as Run without the type erasure, the callable is borrowed so nothing is allocated
+        template <typename F>
+        void ForEach(size_t tasks_len, F& function) {
+            this->Run(tasks_len, [](void* context, size_t index) {
+                (*static_cast<F*>(context))(index);
+            }, &function);
+        }
+
+        uint32_t GetThreadsLen();
+    private:
+        void WorkerLoop();
+        void RunTasks();
+
+        std::vector<std::thread*> threads;
+
+        // Held for a whole Run, the task fields below belong to one caller at a time
+        std::mutex run_mutex;
+
+        std::mutex mutex;
+        std::condition_variable start_condition;
+        std::condition_variable done_condition;
+
+        // Bumped for every Run, workers wait for a generation they have not seen yet
+        uint64_t generation = 0;
+        uint32_t busy_workers = 0;
+        bool stop = false;
+
+        WorkerTask task = nullptr;
+        void* context = nullptr;
+        size_t tasks_len = 0;
+
+        std::atomic<size_t> next_task = 0;
+    };
+}
@@ -0,0 +1,244 @@
+#include "log.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define LOG_RING_CAPACITY 4096
+#define LOG_MESSAGE_SIZE 240
+#define LOG_IDLE_SLEEP_MS 5
+
+using namespace utils::log;
+
+std::atomic<Level> utils::log::levels[SUBSYSTEMS_LEN] = {LEVEL_INFO, LEVEL_INFO, LEVEL_INFO, LEVEL_INFO};
+
+static const char* const level_names[] = {"trace", "debug", "info", "warn", "error", "off"};
+static const char* const subsystem_names[] = {"server", "database", "transport", "client"};
+
+// The sequence tells producers and the consumer whose turn a slot is, so the ring needs no lock
+struct LogSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t timestamp_ns;
+    Level level;
+    Subsystem subsystem;
+    char message[LOG_MESSAGE_SIZE];
+};
+
+struct LogState {
+    LogSlot slots[LOG_RING_CAPACITY];
+
+    std::atomic<uint64_t> tail = 0;
+    std::atomic<uint64_t> head = 0;
+    std::atomic<uint64_t> dropped = 0;
+
+    std::once_flag start_flag;
+    std::atomic<bool> stop = false;
+    std::thread* flush_thread = nullptr;
+
+    LogState() {
+        for (uint64_t i = 0; i < LOG_RING_CAPACITY; i++) {
+            this->slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~LogState();
+};
+
+static LogState& GetState() {
+    static LogState state;
+
+    return state;
+}
+
+// Only the flush thread consumes, returns false when the ring is empty
+static bool WriteNextSlot(LogState& state) {
+    const uint64_t head = state.head.load(std::memory_order_relaxed);
+
+    LogSlot& slot = state.slots[head % LOG_RING_CAPACITY];
+
+    if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+        return false;
+    }
+
+    const time_t seconds = slot.timestamp_ns / 1000000000;
+    const uint32_t milliseconds = (slot.timestamp_ns / 1000000) % 1000;
+
+    struct tm local_time;
+    localtime_r(&seconds, &local_time);
+
+    char time_text[16];
+    strftime(time_text, sizeof(time_text), "%H:%M:%S", &local_time);
+
+    fprintf(stderr, "%s.%03u %-5s %s: %s\n", time_text, milliseconds, level_names[slot.level], subsystem_names[slot.subsystem], slot.message);
+
+    slot.sequence.store(head + LOG_RING_CAPACITY, std::memory_order_release);
+
+    state.head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+static void FlushLoop(LogState& state) {
+    uint64_t reported_dropped = 0;
+
+    while (true) {
+        bool wrote = false;
+
+        while (WriteNextSlot(state)) {
+            wrote = true;
+        }
+
+        const uint64_t dropped = state.dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped) {
+            fprintf(stderr, "log ring full, dropped %llu messages\n", (unsigned long long)(dropped - reported_dropped));
+
+            reported_dropped = dropped;
+            wrote = true;
+        }
+
+        if (wrote) {
+            fflush(stderr);
+            continue;
+        }
+
+        if (state.stop.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        // Producers never wake the thread, polling keeps Write free of any lock or syscall
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_SLEEP_MS));
+    }
+}
+
+LogState::~LogState() {
+    this->stop.store(true, std::memory_order_release);
+
+    if (this->flush_thread != nullptr) {
+        this->flush_thread->join();
+
+        delete this->flush_thread;
+    }
+}
+
+void utils::log::SetLevel(const Subsystem subsystem, const Level level) {
+    levels[subsystem].store(level, std::memory_order_relaxed);
+}
+
+void utils::log::SetAllLevels(const Level level) {
+    for (auto& subsystem_level : levels) {
+        subsystem_level.store(level, std::memory_order_relaxed);
+    }
+}
+
+static bool ParseLevel(const std::string& text, Level* level) {
+    for (uint32_t i = 0; i <= LEVEL_OFF; i++) {
+        if (text == level_names[i]) {
+            *level = static_cast<Level>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void utils::log::ConfigureFromEnvironment() {
+    const char* value = getenv("SWIFTCOM_LOG");
+    if (value == nullptr) {
+        return;
+    }
+
+    const std::string config = value;
+
+    size_t start = 0;
+
+    while (start <= config.size()) {
+        size_t end = config.find(',', start);
+        if (end == std::string::npos) {
+            end = config.size();
+        }
+
+        const std::string entry = config.substr(start, end - start);
+        const size_t separator = entry.find('=');
+
+        Level level;
+
+        if (separator == std::string::npos) {
+            if (ParseLevel(entry, &level)) {
+                SetAllLevels(level);
+            }
+        } else if (ParseLevel(entry.substr(separator + 1), &level)) {
+            const std::string subsystem = entry.substr(0, separator);
+
+            for (uint32_t i = 0; i < SUBSYSTEMS_LEN; i++) {
+                if (subsystem == subsystem_names[i]) {
+                    SetLevel(static_cast<Subsystem>(i), level);
+                }
+            }
+        }
+
+        start = end + 1;
+    }
+}
+
+void utils::log::Write(const Subsystem subsystem, const Level level, const char* format, ...) {
+    LogState& state = GetState();
+
+    std::call_once(state.start_flag, [&state]() {
+        state.flush_thread = new std::thread(FlushLoop, std::ref(state));
+    });
+
+    uint64_t position = state.tail.load(std::memory_order_relaxed);
+
+    LogSlot* slot;
+
+    while (true) {
+        slot = &state.slots[position % LOG_RING_CAPACITY];
+
+        const int64_t difference = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(position);
+
+        if (difference == 0) {
+            if (state.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Full, the flush thread is behind
+            state.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = state.tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    slot->level = level;
+    slot->subsystem = subsystem;
+
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(slot->message, sizeof(slot->message), format, arguments);
+    va_end(arguments);
+
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void utils::log::Flush() {
+    LogState& state = GetState();
+
+    // Waits for what was queued before the call, returns right away when nothing ever was
+    const uint64_t target = state.tail.load(std::memory_order_acquire);
+
+    while (state.head.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+uint64_t utils::log::GetDroppedCount() {
+    return GetState().dropped.load(std::memory_order_relaxed);
+}
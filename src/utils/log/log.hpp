@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+
+// Calls below this level are removed by the preprocessor, release builds drop trace logging entirely
+#ifndef LOG_COMPILED_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILED_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_COMPILED_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+#define LOG_AT(level, subsystem, ...) do { if (utils::log::IsEnabled(utils::log::subsystem, level)) { utils::log::Write(utils::log::subsystem, level, __VA_ARGS__); } } while (0)
+
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(subsystem, ...) LOG_AT(utils::log::LEVEL_TRACE, subsystem, __VA_ARGS__)
+#else
+#define LOG_TRACE(subsystem, ...) ((void)0)
+#endif
+
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(subsystem, ...) LOG_AT(utils::log::LEVEL_DEBUG, subsystem, __VA_ARGS__)
+#else
+#define LOG_DEBUG(subsystem, ...) ((void)0)
+#endif
+
+#define LOG_INFO(subsystem, ...) LOG_AT(utils::log::LEVEL_INFO, subsystem, __VA_ARGS__)
+#define LOG_WARN(subsystem, ...) LOG_AT(utils::log::LEVEL_WARN, subsystem, __VA_ARGS__)
+#define LOG_ERROR(subsystem, ...) LOG_AT(utils::log::LEVEL_ERROR, subsystem, __VA_ARGS__)
+
+namespace utils::log {
+    enum Level : uint8_t {
+        LEVEL_TRACE = LOG_LEVEL_TRACE,
+        LEVEL_DEBUG = LOG_LEVEL_DEBUG,
+        LEVEL_INFO = LOG_LEVEL_INFO,
+        LEVEL_WARN = LOG_LEVEL_WARN,
+        LEVEL_ERROR = LOG_LEVEL_ERROR,
+        LEVEL_OFF
+    };
+
+    enum Subsystem : uint8_t {
+        SERVER,
+        DATABASE,
+        TRANSPORT,
+        CLIENT,
+        SUBSYSTEMS_LEN
+    };
+
+    extern std::atomic<Level> levels[SUBSYSTEMS_LEN];
+
+    inline bool IsEnabled(const Subsystem subsystem, const Level level) {
+        return level >= levels[subsystem].load(std::memory_order_relaxed);
+    }
+
+    void SetLevel(const Subsystem subsystem, const Level level);
+    void SetAllLevels(const Level level);
+
+    // Reads SWIFTCOM_LOG, either one level for everything ("debug") or per subsystem ("server=trace,database=warn")
+    void ConfigureFromEnvironment();
+
+    // Formats into a slot of the bounded ring and returns, the message is dropped when the ring is full
+    void Write(const Subsystem subsystem, const Level level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    // Waits until the background thread wrote everything queued so far, only for shutdown paths
+    void Flush();
+
+    uint64_t GetDroppedCount();
+}
@@ -0,0 +1,448 @@
+#include "metrics.hpp"
+#include "../alloc/alloc.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Log-linear buckets: every power of two is split into 16 sub buckets, so any value is within ~6% of its bucket
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_EXPONENT 48
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS + (HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+using namespace utils::metrics;
+
+struct HistogramShard {
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+    std::atomic<uint64_t> sum = 0;
+    std::atomic<uint64_t> max = 0;
+};
+
+// Only the owning thread writes a shard, readers merge them under the registry lock
+struct MetricsShard {
+    std::atomic<uint64_t> counters[MAX_METRIC_COUNTERS] = {};
+    std::atomic<HistogramShard*> histograms[MAX_METRIC_HISTOGRAMS] = {};
+
+    ~MetricsShard() {
+        for (auto& histogram : this->histograms) {
+            delete histogram.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+struct MetricsRegistry {
+    std::mutex mutex;
+
+    std::unordered_map<std::string, MetricId> counter_ids;
+    std::unordered_map<std::string, MetricId> histogram_ids;
+    std::unordered_map<std::string, MetricId> gauge_ids;
+
+    std::vector<std::string> counter_names;
+    std::vector<std::string> histogram_names;
+    std::vector<HistogramUnit> histogram_units;
+    std::vector<std::string> gauge_names;
+
+    std::vector<MetricsShard*> shards;
+
+    // Values of threads that already exited
+    MetricsShard retired;
+
+    std::atomic<int64_t> gauges[MAX_METRIC_GAUGES] = {};
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::mutex writer_mutex;
+    std::condition_variable writer_condition;
+    std::thread* writer_thread = nullptr;
+    bool stop_writer = false;
+};
+
+static MetricsRegistry& GetRegistry() {
+    static MetricsRegistry registry;
+
+    return registry;
+}
+
+// Single writer, so a relaxed load and store is enough and avoids a locked instruction
+static inline void AddRelaxed(std::atomic<uint64_t>& target, const uint64_t value) {
+    target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static HistogramShard* GetHistogramShard(MetricsShard* shard, const MetricId histogram) {
+    HistogramShard* histogram_shard = shard->histograms[histogram].load(std::memory_order_relaxed);
+
+    if (histogram_shard == nullptr) {
+        // Once per thread and histogram, reactor tasks move between threads so this can come long after warm-up.
+        // It is the metrics' own storage, not the subsystem that happened to record first.
+        ALLOC_SCOPE(UNTAGGED);
+
+        histogram_shard = new HistogramShard();
+
+        shard->histograms[histogram].store(histogram_shard, std::memory_order_release);
+    }
+
+    return histogram_shard;
+}
+
+static void FoldShard(MetricsShard* from, MetricsShard* into) {
+    for (uint32_t i = 0; i < MAX_METRIC_COUNTERS; i++) {
+        AddRelaxed(into->counters[i], from->counters[i].load(std::memory_order_relaxed));
+    }
+
+    for (uint32_t i = 0; i < MAX_METRIC_HISTOGRAMS; i++) {
+        HistogramShard* const source = from->histograms[i].load(std::memory_order_acquire);
+        if (source == nullptr) {
+            continue;
+        }
+
+        HistogramShard* const target = GetHistogramShard(into, i);
+
+        for (uint32_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+            AddRelaxed(target->buckets[bucket], source->buckets[bucket].load(std::memory_order_relaxed));
+        }
+
+        AddRelaxed(target->sum, source->sum.load(std::memory_order_relaxed));
+
+        target->max.store(std::max(target->max.load(std::memory_order_relaxed), source->max.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    }
+}
+
+struct ThreadShard {
+    MetricsShard* shard = nullptr;
+
+    ~ThreadShard() {
+        if (this->shard == nullptr) {
+            return;
+        }
+
+        MetricsRegistry& registry = GetRegistry();
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        FoldShard(this->shard, &registry.retired);
+
+        registry.shards.erase(std::find(registry.shards.begin(), registry.shards.end(), this->shard));
+
+        delete this->shard;
+    }
+};
+
+static thread_local ThreadShard thread_shard;
+
+static MetricsShard* GetThreadShard() {
+    if (thread_shard.shard == nullptr) {
+        ALLOC_SCOPE(UNTAGGED);
+
+        MetricsShard* const shard = new MetricsShard();
+
+        MetricsRegistry& registry = GetRegistry();
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.shards.push_back(shard);
+
+        thread_shard.shard = shard;
+    }
+
+    return thread_shard.shard;
+}
+
+static uint32_t GetBucketIndex(const uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+
+    const uint32_t exponent = 63 - __builtin_clzll(value);
+    if (exponent > HISTOGRAM_MAX_EXPONENT) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+
+    const uint32_t sub_bucket = (value >> (exponent - HISTOGRAM_SUB_BUCKET_BITS)) - HISTOGRAM_SUB_BUCKETS;
+
+    return HISTOGRAM_SUB_BUCKETS + (exponent - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+// Middle of the value range a bucket covers
+static uint64_t GetBucketValue(const uint32_t index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+
+    const uint32_t exponent = (index - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKET_BITS;
+    const uint64_t sub_bucket = (index - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS;
+    const uint64_t width = 1ULL << (exponent - HISTOGRAM_SUB_BUCKET_BITS);
+
+    return (HISTOGRAM_SUB_BUCKETS + sub_bucket) * width + width / 2;
+}
+
+static MetricId Register(std::unordered_map<std::string, MetricId>& ids, std::vector<std::string>& names, const char* name, const uint32_t limit) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    if (names.size() >= limit) {
+        fprintf(stderr, "Too many metrics, ignoring %s\n", name);
+        return limit;
+    }
+
+    const MetricId id = names.size();
+
+    names.emplace_back(name);
+    ids.emplace(name, id);
+
+    return id;
+}
+
+MetricId utils::metrics::RegisterCounter(const char* name) {
+    MetricsRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    return Register(registry.counter_ids, registry.counter_names, name, MAX_METRIC_COUNTERS);
+}
+
+MetricId utils::metrics::RegisterHistogram(const char* name, const HistogramUnit unit) {
+    MetricsRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    const MetricId id = Register(registry.histogram_ids, registry.histogram_names, name, MAX_METRIC_HISTOGRAMS);
+
+    if (id < MAX_METRIC_HISTOGRAMS && id == registry.histogram_units.size()) {
+        registry.histogram_units.push_back(unit);
+    }
+
+    return id;
+}
+
+MetricId utils::metrics::RegisterGauge(const char* name) {
+    MetricsRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    return Register(registry.gauge_ids, registry.gauge_names, name, MAX_METRIC_GAUGES);
+}
+
+void utils::metrics::IncrementCounter(const MetricId counter, const uint64_t value) {
+    if (counter >= MAX_METRIC_COUNTERS) {
+        return;
+    }
+
+    AddRelaxed(GetThreadShard()->counters[counter], value);
+}
+
+void utils::metrics::RecordValue(const MetricId histogram, const uint64_t value) {
+    if (histogram >= MAX_METRIC_HISTOGRAMS) {
+        return;
+    }
+
+    HistogramShard* const histogram_shard = GetHistogramShard(GetThreadShard(), histogram);
+
+    AddRelaxed(histogram_shard->buckets[GetBucketIndex(value)], 1);
+    AddRelaxed(histogram_shard->sum, value);
+
+    if (value > histogram_shard->max.load(std::memory_order_relaxed)) {
+        histogram_shard->max.store(value, std::memory_order_relaxed);
+    }
+}
+
+void utils::metrics::SetGauge(const MetricId gauge, const int64_t value) {
+    if (gauge >= MAX_METRIC_GAUGES) {
+        return;
+    }
+
+    GetRegistry().gauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+static void FormatHistogramValue(std::string& output, const char* label, const uint64_t value, const HistogramUnit unit) {
+    char formatted[64];
+
+    if (unit == NANOSECONDS) {
+        snprintf(formatted, sizeof(formatted), " %s=%.1fus", label, value / 1000.0);
+    } else {
+        snprintf(formatted, sizeof(formatted), " %s=%llu", label, (unsigned long long)value);
+    }
+
+    output += formatted;
+}
+
+static uint64_t GetPercentile(const std::vector<uint64_t>& buckets, const uint64_t count, const uint64_t max, const double percentile) {
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile * count + 0.5));
+
+    uint64_t seen = 0;
+
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+
+        if (seen >= rank) {
+            return std::min(GetBucketValue(i), max);
+        }
+    }
+
+    return max;
+}
+
+std::string utils::metrics::FormatSnapshot() {
+    MetricsRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::string output;
+    char line[256];
+
+    snprintf(line, sizeof(line), "uptime %.1f s\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - registry.start).count());
+    output += line;
+
+    for (MetricId id = 0; id < registry.counter_names.size(); id++) {
+        uint64_t value = registry.retired.counters[id].load(std::memory_order_relaxed);
+
+        for (auto shard : registry.shards) {
+            value += shard->counters[id].load(std::memory_order_relaxed);
+        }
+
+        snprintf(line, sizeof(line), "counter %s %llu\n", registry.counter_names[id].c_str(), (unsigned long long)value);
+        output += line;
+    }
+
+    for (MetricId id = 0; id < registry.gauge_names.size(); id++) {
+        snprintf(line, sizeof(line), "gauge %s %lld\n", registry.gauge_names[id].c_str(), (long long)registry.gauges[id].load(std::memory_order_relaxed));
+        output += line;
+    }
+
+    std::vector<uint64_t> buckets(HISTOGRAM_BUCKETS);
+
+    for (MetricId id = 0; id < registry.histogram_names.size(); id++) {
+        std::fill(buckets.begin(), buckets.end(), 0);
+
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        auto merge = [&](MetricsShard* shard) {
+            HistogramShard* const histogram_shard = shard->histograms[id].load(std::memory_order_acquire);
+            if (histogram_shard == nullptr) {
+                return;
+            }
+
+            for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                const uint64_t bucket = histogram_shard->buckets[i].load(std::memory_order_relaxed);
+
+                buckets[i] += bucket;
+                count += bucket;
+            }
+
+            sum += histogram_shard->sum.load(std::memory_order_relaxed);
+            max = std::max(max, histogram_shard->max.load(std::memory_order_relaxed));
+        };
+
+        merge(&registry.retired);
+
+        for (auto shard : registry.shards) {
+            merge(shard);
+        }
+
+        const HistogramUnit unit = registry.histogram_units[id];
+
+        output += "histogram " + registry.histogram_names[id];
+
+        snprintf(line, sizeof(line), " count=%llu", (unsigned long long)count);
+        output += line;
+
+        if (count > 0) {
+            FormatHistogramValue(output, "mean", sum / count, unit);
+            FormatHistogramValue(output, "p50", GetPercentile(buckets, count, max, 0.50), unit);
+            FormatHistogramValue(output, "p90", GetPercentile(buckets, count, max, 0.90), unit);
+            FormatHistogramValue(output, "p99", GetPercentile(buckets, count, max, 0.99), unit);
+            FormatHistogramValue(output, "p999", GetPercentile(buckets, count, max, 0.999), unit);
+            FormatHistogramValue(output, "max", max, unit);
+        }
+
+        output += "\n";
+    }
+
+    return output;
+}
+
+static void WriteSnapshot(const std::string& path) {
+    const std::string temporary_path = path + ".tmp";
+
+    FILE* file = fopen(temporary_path.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open %s\n", temporary_path.c_str());
+        return;
+    }
+
+    const std::string snapshot = FormatSnapshot();
+
+    fwrite(snapshot.data(), 1, snapshot.size(), file);
+    fclose(file);
+
+    // Readers never see a half written snapshot
+    rename(temporary_path.c_str(), path.c_str());
+}
+
+void utils::metrics::StartSnapshotWriter(const char* path, const uint32_t interval_seconds) {
+    MetricsRegistry& registry = GetRegistry();
+
+    std::lock_guard<std::mutex> lock(registry.writer_mutex);
+
+    if (registry.writer_thread != nullptr) {
+        return;
+    }
+
+    registry.stop_writer = false;
+
+    registry.writer_thread = new std::thread([&registry, path = std::string(path), interval_seconds]() {
+        std::unique_lock<std::mutex> writer_lock(registry.writer_mutex);
+
+        while (!registry.stop_writer) {
+            registry.writer_condition.wait_for(writer_lock, std::chrono::seconds(interval_seconds), [&registry]() { return registry.stop_writer; });
+
+            writer_lock.unlock();
+
+            WriteSnapshot(path);
+
+            writer_lock.lock();
+        }
+    });
+}
+
+void utils::metrics::StopSnapshotWriter() {
+    MetricsRegistry& registry = GetRegistry();
+
+    std::thread* writer_thread;
+
+    {
+        std::lock_guard<std::mutex> lock(registry.writer_mutex);
+
+        registry.stop_writer = true;
+
+        writer_thread = registry.writer_thread;
+        registry.writer_thread = nullptr;
+    }
+
+    registry.writer_condition.notify_all();
+
+    if (writer_thread != nullptr) {
+        writer_thread->join();
+
+        delete writer_thread;
+    }
+}
+
+ScopedTimer::ScopedTimer(const MetricId histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {
+
+}
+
+ScopedTimer::~ScopedTimer() {
+    RecordValue(this->histogram, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count());
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#define MAX_METRIC_COUNTERS 256
+#define MAX_METRIC_HISTOGRAMS 128
+#define MAX_METRIC_GAUGES 128
+
+namespace utils::metrics {
+    // Dense index returned by registration, ids past the limits are ignored when recording
+    typedef uint32_t MetricId;
+
+    enum HistogramUnit {
+        NANOSECONDS,
+        COUNT
+    };
+
+    // Registering an existing name returns its id, so callers can register lazily from any thread
+    MetricId RegisterCounter(const char* name);
+    MetricId RegisterHistogram(const char* name, const HistogramUnit unit);
+    MetricId RegisterGauge(const char* name);
+
+    // Counters and histograms write to a shard owned by the calling thread, no locks or shared cache lines
+    void IncrementCounter(const MetricId counter, const uint64_t value = 1);
+    void RecordValue(const MetricId histogram, const uint64_t value);
+    void SetGauge(const MetricId gauge, const int64_t value);
+
+    // Merges every thread's shard into a text report, one metric per line
+    std::string FormatSnapshot();
+
+    // Rewrites the file with a fresh snapshot every interval until stopped
+    void StartSnapshotWriter(const char* path, const uint32_t interval_seconds);
+    void StopSnapshotWriter();
+
+    // Records the lifetime of the scope into a nanosecond histogram
+    class ScopedTimer {
+    public:
+        ScopedTimer(const MetricId histogram);
+        ~ScopedTimer();
+    private:
+        MetricId histogram;
+        std::chrono::steady_clock::time_point start;
+    };
+}
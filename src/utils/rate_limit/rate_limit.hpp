@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+
+namespace utils::rate_limit {
+    // Refills continuously at rate tokens per second up to burst tokens, and starts full.
+    // Not thread safe, a bucket belongs to whichever thread admits the requests it limits.
+    class TokenBucket {
+    public:
+        TokenBucket(const double rate = 0, const double burst = 0);
+
+        // Takes one token, false when the bucket is empty
+        bool TryTake(const std::chrono::steady_clock::time_point now);
+
+        double GetTokens() const;
+    private:
+        double rate;
+        double burst;
+        double tokens;
+
+        std::chrono::steady_clock::time_point last_refill;
+    };
+}
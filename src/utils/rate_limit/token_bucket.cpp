@@ -0,0 +1,30 @@
+#include "rate_limit.hpp"
+#include <algorithm>
+#include <chrono>
+
+using namespace utils::rate_limit;
+
+TokenBucket::TokenBucket(const double rate, const double burst) : rate(rate), burst(burst), tokens(burst), last_refill(std::chrono::steady_clock::now()) {
+
+}
+
+bool TokenBucket::TryTake(const std::chrono::steady_clock::time_point now) {
+    if (now > this->last_refill) {
+        const double elapsed = std::chrono::duration<double>(now - this->last_refill).count();
+
+        this->tokens = std::min(this->burst, this->tokens + elapsed * this->rate);
+        this->last_refill = now;
+    }
+
+    if (this->tokens < 1) {
+        return false;
+    }
+
+    this->tokens -= 1;
+
+    return true;
+}
+
+double TokenBucket::GetTokens() const {
+    return this->tokens;
+}
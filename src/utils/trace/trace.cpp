@@ -0,0 +1,197 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+#define TRACE_RING_CAPACITY (1 << 14)
+#define MAX_RETIRED_TRACE_RINGS 64
+
+std::atomic<bool> utils::trace::enabled = false;
+
+// Fields are relaxed atomics so a dump can read a ring while its thread keeps writing
+struct TraceEvent {
+    std::atomic<const char*> category;
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint64_t> end_ns;
+};
+
+struct TraceRing {
+    uint32_t thread_id;
+    TraceEvent events[TRACE_RING_CAPACITY];
+
+    // Total spans ever written, the slot is the position modulo the capacity
+    std::atomic<uint64_t> head = 0;
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<TraceRing*> rings;
+
+    // Rings of exited threads stay dumpable, the oldest are dropped past the limit
+    std::deque<TraceRing*> retired_rings;
+
+    uint32_t next_thread_id = 1;
+};
+
+static TraceRegistry& GetRegistry() {
+    static TraceRegistry registry;
+
+    return registry;
+}
+
+struct ThreadRing {
+    TraceRing* ring = nullptr;
+
+    ~ThreadRing() {
+        if (this->ring == nullptr) {
+            return;
+        }
+
+        TraceRegistry& registry = GetRegistry();
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.rings.erase(std::find(registry.rings.begin(), registry.rings.end(), this->ring));
+        registry.retired_rings.push_back(this->ring);
+
+        if (registry.retired_rings.size() > MAX_RETIRED_TRACE_RINGS) {
+            delete registry.retired_rings.front();
+            registry.retired_rings.pop_front();
+        }
+    }
+};
+
+static thread_local ThreadRing thread_ring;
+
+// Rings are only allocated by threads that record while tracing is on
+static TraceRing* GetThreadRing() {
+    if (thread_ring.ring == nullptr) {
+        TraceRing* const ring = new TraceRing();
+
+        TraceRegistry& registry = GetRegistry();
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        ring->thread_id = registry.next_thread_id++;
+
+        registry.rings.push_back(ring);
+
+        thread_ring.ring = ring;
+    }
+
+    return thread_ring.ring;
+}
+
+void utils::trace::SetEnabled(const bool value) {
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+uint64_t utils::trace::GetTimestampNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void utils::trace::RecordSpan(const char* category, const char* name, const uint64_t start_ns, const uint64_t end_ns) {
+    TraceRing* const ring = GetThreadRing();
+
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    TraceEvent& event = ring->events[head % TRACE_RING_CAPACITY];
+
+    event.category.store(category, std::memory_order_relaxed);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start_ns.store(start_ns, std::memory_order_relaxed);
+    event.end_ns.store(end_ns, std::memory_order_relaxed);
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+struct DumpedEvent {
+    const char* category;
+    const char* name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+// Copies the ring and drops the slots its thread may have overwritten during the copy
+static std::vector<DumpedEvent> CopyRing(TraceRing* ring) {
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    const uint64_t first = head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+
+    std::vector<DumpedEvent> events;
+    events.reserve(head - first);
+
+    for (uint64_t i = first; i < head; i++) {
+        const TraceEvent& event = ring->events[i % TRACE_RING_CAPACITY];
+
+        events.push_back((DumpedEvent){
+            .category = event.category.load(std::memory_order_relaxed),
+            .name = event.name.load(std::memory_order_relaxed),
+            .start_ns = event.start_ns.load(std::memory_order_relaxed),
+            .end_ns = event.end_ns.load(std::memory_order_relaxed)
+        });
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // Counts the slot the thread may be halfway through writing as overwritten too
+    const uint64_t head_after = ring->head.load(std::memory_order_relaxed) + 1;
+
+    if (head_after > first + TRACE_RING_CAPACITY) {
+        const uint64_t overwritten = std::min<uint64_t>(head_after - TRACE_RING_CAPACITY - first, events.size());
+
+        events.erase(events.begin(), events.begin() + overwritten);
+    }
+
+    return events;
+}
+
+bool utils::trace::DumpChromeTrace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    std::vector<std::pair<uint32_t, std::vector<DumpedEvent>>> threads;
+
+    {
+        TraceRegistry& registry = GetRegistry();
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        for (auto ring : registry.retired_rings) {
+            threads.emplace_back(ring->thread_id, CopyRing(ring));
+        }
+
+        for (auto ring : registry.rings) {
+            threads.emplace_back(ring->thread_id, CopyRing(ring));
+        }
+    }
+
+    const int process_id = getpid();
+
+    bool first_event = true;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    for (auto& [thread_id, events] : threads) {
+        for (auto& event : events) {
+            fprintf(file, "%s\n{\"cat\":\"%s\",\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}", first_event ? "" : ",", event.category, event.name, event.start_ns / 1000.0, (event.end_ns - event.start_ns) / 1000.0, process_id, thread_id);
+
+            first_event = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    fclose(file);
+
+    return true;
+}
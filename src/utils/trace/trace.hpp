@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Category and name must be string literals, the ring keeps only the pointers
+#define TRACE_SCOPE(category, name) utils::trace::ScopedSpan TRACE_CONCAT(trace_span_, __LINE__)(category, name)
+
+namespace utils::trace {
+    extern std::atomic<bool> enabled;
+
+    inline bool IsEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(const bool value);
+
+    uint64_t GetTimestampNs();
+
+    // Appends to the calling thread's ring, the oldest spans are overwritten once it is full
+    void RecordSpan(const char* category, const char* name, const uint64_t start_ns, const uint64_t end_ns);
+
+    // Writes every ring as Chrome trace-event JSON, loadable in chrome://tracing or Perfetto
+    bool DumpChromeTrace(const char* path);
+
+    // When tracing is off the only cost is the enabled check in the constructor
+    class ScopedSpan {
+    public:
+        ScopedSpan(const char* category, const char* name) : category(category), name(name), start_ns(IsEnabled() ? GetTimestampNs() : 0) {
+
+        }
+
+        ~ScopedSpan() {
+            this->End();
+        }
+
+        // Ends the span before the scope does, for sequential phases of one function
+        void End() {
+            if (this->start_ns != 0) {
+                RecordSpan(this->category, this->name, this->start_ns, GetTimestampNs());
+
+                this->start_ns = 0;
+            }
+        }
+    private:
+        const char* category;
+        const char* name;
+        uint64_t start_ns;
+    };
+}
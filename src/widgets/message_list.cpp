@@ -0,0 +1,227 @@
+#include "widgets.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <wx/dcbuffer.h>
+#include <wx/wx.h>
+
+using namespace widgets;
+
+#define MESSAGE_LIST_ROW_BORDER 6
+#define MESSAGE_LIST_USERNAME_BORDER 8
+#define MESSAGE_LIST_MAX_MESSAGE_WIDTH 600
+#define MESSAGE_LIST_MIN_MESSAGE_WIDTH 100
+
+MessageList::MessageList(wxWindow* parent, std::function<void(const size_t row, wxString& username, wxString& message)> row_provider) : wxVScrolledWindow(parent, wxID_ANY), row_provider(row_provider) {
+    SetBackgroundStyle(wxBG_STYLE_PAINT);
+
+    username_font = GetFont().Scale(1.1f).Bold();
+    message_font = GetFont().Scale(1.6f);
+
+    GetTextExtent("Ag", nullptr, &message_line_height, nullptr, nullptr, &message_font);
+
+    layout_width = GetClientSize().GetWidth();
+
+    Bind(wxEVT_PAINT, &MessageList::OnPaint, this);
+    Bind(wxEVT_SIZE, &MessageList::OnSize, this);
+}
+
+MessageList::~MessageList() = default;
+
+void MessageList::SetMessagesCount(const size_t messages_count) {
+    const size_t old_messages_count = row_layouts.size();
+
+    // Rows only ever get appended, fewer rows means the history was replaced so nothing cached is valid anymore
+    if (messages_count < old_messages_count) {
+        row_layouts.clear();
+    }
+
+    row_layouts.resize(messages_count);
+
+    // Setting the count scrolls back to the first row, appended rows leave the view where it was
+    const size_t first_row = GetVisibleRowsBegin();
+
+    SetRowCount(messages_count);
+
+    if (messages_count < old_messages_count) {
+        RefreshAll();
+        return;
+    }
+
+    ScrollToRow(first_row);
+
+    if (messages_count > old_messages_count) {
+        RefreshRows(old_messages_count, messages_count - 1);
+    }
+}
+
+void MessageList::InvalidateMessagesFrom(const size_t first_row) {
+    for (size_t row = first_row; row < row_layouts.size(); row++) {
+        row_layouts[row] = RowLayout();
+    }
+
+    if (first_row < GetRowCount()) {
+        RefreshRows(first_row, GetRowCount() - 1);
+    }
+}
+
+void MessageList::ScrollToBottom() {
+    const size_t rows_count = GetRowCount();
+    if (rows_count == 0) {
+        return;
+    }
+
+    // Walk up from the last row until the client area is full, only the rows that end up visible get measured
+    const wxCoord client_height = GetClientSize().GetHeight();
+
+    size_t first_row = rows_count - 1;
+    wxCoord rows_height = OnGetRowHeight(first_row);
+
+    while (first_row > 0) {
+        const wxCoord row_height = OnGetRowHeight(first_row - 1);
+        if (rows_height + row_height > client_height) {
+            break;
+        }
+
+        rows_height += row_height;
+        first_row--;
+    }
+
+    ScrollToRow(first_row);
+}
+
+bool MessageList::IsScrolledToBottom() {
+    return GetVisibleRowsEnd() >= GetRowCount();
+}
+
+wxCoord MessageList::OnGetRowHeight(size_t row) const {
+    return GetRowLayout(row).height;
+}
+
+const MessageList::RowLayout& MessageList::GetRowLayout(const size_t row) const {
+    RowLayout& layout = row_layouts[row];
+    if (layout.layout_generation == layout_generation) {
+        return layout;
+    }
+
+    if (layout.layout_generation == 0) {
+        row_provider(row, layout.username, layout.message);
+    }
+
+    wxCoord username_height;
+    GetTextExtent(layout.username, &layout.username_width, &username_height, nullptr, nullptr, &username_font);
+
+    const wxCoord available_width = layout_width - layout.username_width - MESSAGE_LIST_USERNAME_BORDER;
+    const wxCoord message_width = std::clamp(available_width, (wxCoord)MESSAGE_LIST_MIN_MESSAGE_WIDTH, (wxCoord)MESSAGE_LIST_MAX_MESSAGE_WIDTH);
+
+    WrapMessage(layout.message, message_width, layout.message_lines);
+
+    const wxCoord message_height = message_line_height * (wxCoord)layout.message_lines.size();
+
+    layout.height = std::max(username_height, message_height) + MESSAGE_LIST_ROW_BORDER * 2;
+    layout.layout_generation = layout_generation;
+
+    return layout;
+}
+
+void MessageList::WrapMessage(const wxString& message, const wxCoord max_width, std::vector<wxString>& lines) const {
+    lines.clear();
+
+    wxString line;
+    wxString word;
+    wxCoord line_width = 0;
+
+    auto flush_word = [&]() {
+        if (word.empty()) {
+            return;
+        }
+
+        wxCoord word_width;
+        GetTextExtent(word, &word_width, nullptr, nullptr, nullptr, &message_font);
+
+        if (!line.empty() && line_width + word_width > max_width) {
+            lines.push_back(line);
+            line.clear();
+            line_width = 0;
+        }
+
+        line += word;
+        line_width += word_width;
+        word.clear();
+    };
+
+    for (const auto character : message) {
+        if (character == '\n') {
+            flush_word();
+            lines.push_back(line);
+            line.clear();
+            line_width = 0;
+            continue;
+        }
+
+        word += character;
+
+        if (character == ' ') {
+            flush_word();
+        }
+    }
+
+    flush_word();
+
+    lines.push_back(line);
+}
+
+void MessageList::OnSize(wxSizeEvent& event) {
+    const wxCoord new_width = GetClientSize().GetWidth();
+
+    if (new_width != layout_width) {
+        layout_width = new_width;
+        layout_generation++;
+
+        // wx keeps its own measure of the rows' heights, setting the count again drops it so rows wrapped to the new width are measured again
+        const size_t first_row = GetVisibleRowsBegin();
+
+        SetRowCount(GetRowCount());
+        ScrollToRow(first_row);
+
+        RefreshAll();
+    }
+
+    event.Skip();
+}
+
+void MessageList::OnPaint(wxPaintEvent&) {
+    wxAutoBufferedPaintDC dc(this);
+
+    dc.SetBackground(wxBrush(GetBackgroundColour()));
+    dc.Clear();
+
+    const wxCoord client_height = GetClientSize().GetHeight();
+
+    wxCoord y = 0;
+
+    for (size_t row = GetVisibleRowsBegin(); row < GetRowCount() && y < client_height; row++) {
+        const RowLayout& layout = GetRowLayout(row);
+
+        const wxCoord content_top = y + MESSAGE_LIST_ROW_BORDER;
+        const wxCoord content_height = layout.height - MESSAGE_LIST_ROW_BORDER * 2;
+
+        dc.SetFont(username_font);
+        dc.SetTextForeground(wxColour(180, 180, 255));
+        dc.DrawText(layout.username, 0, content_top + (content_height - dc.GetCharHeight()) / 2);
+
+        dc.SetFont(message_font);
+        dc.SetTextForeground(*wxWHITE);
+
+        const wxCoord message_x = layout.username_width + MESSAGE_LIST_USERNAME_BORDER;
+        const wxCoord message_height = message_line_height * (wxCoord)layout.message_lines.size();
+
+        wxCoord line_y = content_top + (content_height - message_height) / 2;
+
+        for (const auto& line : layout.message_lines) {
+            dc.DrawText(line, message_x, line_y);
+            line_y += message_line_height;
+        }
+
+        y += layout.height;
+    }
+}
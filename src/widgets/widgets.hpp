@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <vector>
 #include <wx/event.h>
 #include <wx/osx/core/colour.h>
 #include <wx/panel.h>
+#include <wx/vscroll.h>
 #include <wx/wx.h>
 
 namespace widgets {
@@ -73,4 +76,47 @@ namespace widgets {
         void OnPaint(wxPaintEvent&);
     private:
     };
+
+    // Chat history list that only measures and paints the rows that are visible.
+    // Row text is pulled from row_provider the first time a row is measured and the wrapped layout is cached.
+    class MessageList : public wxVScrolledWindow {
+    public:
+        MessageList(wxWindow* parent, std::function<void(const size_t row, wxString& username, wxString& message)> row_provider);
+        ~MessageList();
+
+        void SetMessagesCount(const size_t messages_count);
+        // Rows from first_row on moved, a message was inserted before them, so they are laid out again
+        void InvalidateMessagesFrom(const size_t first_row);
+        void ScrollToBottom();
+        bool IsScrolledToBottom();
+
+        void OnPaint(wxPaintEvent&);
+        void OnSize(wxSizeEvent&);
+    private:
+        struct RowLayout {
+            uint32_t layout_generation = 0;
+            wxCoord height = 0;
+            wxCoord username_width = 0;
+            wxString username;
+            wxString message;
+            std::vector<wxString> message_lines;
+        };
+
+        virtual wxCoord OnGetRowHeight(size_t row) const override;
+
+        const RowLayout& GetRowLayout(const size_t row) const;
+        void WrapMessage(const wxString& message, const wxCoord max_width, std::vector<wxString>& lines) const;
+
+        std::function<void(const size_t row, wxString& username, wxString& message)> row_provider;
+
+        mutable std::vector<RowLayout> row_layouts;
+
+        // Bumped whenever the width changes, rows measured for an older generation are laid out again lazily
+        uint32_t layout_generation = 1;
+        wxCoord layout_width = 0;
+
+        wxFont username_font;
+        wxFont message_font;
+        wxCoord message_line_height;
+    };
 }